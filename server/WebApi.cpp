@@ -38,10 +38,15 @@
 #endif //ENABLE_MYSQL
 #include "Common/config.h"
 #include "Common/MediaSource.h"
+#include "Common/MemoryCounter.h"
+#include "Common/ReaderWatermark.h"
 #include "Http/HttpRequester.h"
 #include "Http/HttpSession.h"
+#include "Http/EventJournal.h"
 #include "Network/TcpServer.h"
 #include "Player/PlayerProxy.h"
+#include "Rtsp/RtspSession.h"
+#include "Rtsp/RtpBroadCaster.h"
 #include "Util/MD5.h"
 #include "WebApi.h"
 #include "WebHook.h"
@@ -254,6 +259,57 @@ static unordered_map<string ,FFmpegSource::Ptr> s_ffmpegMap;
 static recursive_mutex s_ffmpegMapMtx;
 #endif//#if !defined(_WIN32)
 
+//把流的实时统计转换成json
+static Value makeMediaStats(const MediaStats::Ptr &stats){
+    Value ret(objectValue);
+    static const pair<TrackType,const char *> s_tracks[] = {{TrackVideo,"video"},{TrackAudio,"audio"}};
+    for(auto &pr : s_tracks){
+        if(!stats->haveTrack(pr.first)){
+            continue;
+        }
+        auto track = stats->getTrackStats(pr.first);
+        Value obj;
+        obj["frames"] = (Json::UInt64)track.frames;
+        obj["bytes"] = (Json::UInt64)track.bytes;
+        obj["bitrate"] = (Json::UInt64)track.bitrate;
+        obj["fps"] = track.fps;
+        obj["stampJumps"] = (Json::UInt64)track.stampJumps;
+        obj["rtpLost"] = (Json::UInt64)track.rtpLost;
+        obj["jitterSize"] = track.jitterSize;
+        obj["jitterMax"] = track.jitterMax;
+        obj["idleMS"] = (Json::UInt64)track.idleMS;
+        if(pr.first == TrackVideo){
+            obj["gopFrames"] = track.gopFrames;
+            obj["keyInterval"] = track.keyInterval;
+        }
+        ret[pr.second] = obj;
+    }
+    return ret;
+}
+
+//把rtsp会话根据RR统计的网络质量转换成json
+static Value makeRtcpStats(const RtcpStats::Ptr &stats){
+    Value ret(objectValue);
+    static const pair<TrackType,const char *> s_tracks[] = {{TrackVideo,"video"},{TrackAudio,"audio"}};
+    for(auto &pr : s_tracks){
+        if(!stats->haveTrack(pr.first)){
+            continue;
+        }
+        auto track = stats->getTrackStats(pr.first);
+        Value obj;
+        obj["fractionLost"] = track.fractionLost;
+        obj["totalLost"] = track.totalLost;
+        obj["jitterMS"] = track.jitterMS;
+        obj["rttMS"] = track.rttMS;
+        obj["reports"] = (Json::UInt64)track.reports;
+        obj["idleMS"] = (Json::UInt64)track.idleMS;
+        ret[pr.second] = obj;
+    }
+    ret["nackRetransmitted"] = (Json::UInt64)stats->getNackRetransmitted();
+    ret["nackMissed"] = (Json::UInt64)stats->getNackMissed();
+    return ret;
+}
+
 /**
  * 安装api接口
  * 所有api都支持GET和POST两种方式
@@ -261,6 +317,8 @@ static recursive_mutex s_ffmpegMapMtx;
  */
 void installWebApi() {
     addHttpListener();
+    //尽早开始记录事件，以便事件流订阅者可以从启动时开始恢复
+    EventJournal::Instance();
 
     GET_CONFIG(string,api_secret,API::kSecret);
 
@@ -378,10 +436,65 @@ void installWebApi() {
             item["vhost"] = vhost;
             item["app"] = app;
             item["stream"] = stream;
+            item["readerCount"] = media->readerCount();
+            //观看者分布的线程数，每个rtp/rtmp包引起的跨线程任务个数
+            item["readerThreads"] = media->readerPollerCount();
+            //本协议的观看者个数，不包含转换成其他协议后的观看者
+            item["protocolReaderCount"] = media->protocolReaderCount();
+            auto stats = media->getStats();
+            if(stats){
+                item["stats"] = makeMediaStats(stats);
+            }
             val["data"].append(item);
         });
     });
 
+    //获取各个流缓存的媒体数据内存占用以及全局内存预算
+    //测试url http://127.0.0.1/index/api/getMediaMemory
+    API_REGIST(api,getMediaMemory,{
+        CHECK_SECRET();
+        GET_CONFIG(uint32_t,maxMB,General::kMediaMemoryMaxMB);
+        val["code"] = API::Success;
+        val["msg"] = "success";
+        val["totalBytes"] = (Json::Int64)MemoryCounter::getTotalBytes();
+        //0代表不限制
+        val["budgetBytes"] = (Json::Int64)maxMB * 1024 * 1024;
+        val["overBudget"] = MemoryCounter::isOverBudget();
+        MediaSource::for_each_media([&](const string &schema,
+                                        const string &vhost,
+                                        const string &app,
+                                        const string &stream,
+                                        const MediaSource::Ptr &media){
+            Value item;
+            item["schema"] = schema;
+            item["vhost"] = vhost;
+            item["app"] = app;
+            item["stream"] = stream;
+            item["bytes"] = (Json::Int64)media->getMemoryBytes();
+            item["gopCacheBytes"] = (Json::UInt64)media->getGopCacheBytes();
+            val["data"].append(item);
+        });
+    });
+
+    //订阅流注册注销、观看者个数变化、流量汇报等事件(Server-Sent Events格式)，替代轮询getMediaList
+    //断线重连时通过Last-Event-ID头或lastEventId参数从上次收到的事件处恢复
+    //测试url http://127.0.0.1/index/api/events?lastEventId=0
+    API_REGIST_INVOKER(api,events,{
+        CHECK_SECRET();
+        auto session = dynamic_cast<HttpSession *>(&sender);
+        if(!session){
+            throw ApiRetException("not http session",API::OtherFailed);
+        }
+        uint64_t lastSeq = 0;
+        if(!allArgs["lastEventId"].empty()){
+            lastSeq = allArgs["lastEventId"].as<uint64_t>();
+        }else if(!headerIn["Last-Event-ID"].empty()){
+            lastSeq = atoll(headerIn["Last-Event-ID"].data());
+        }
+        //本连接切换为事件流，不再调用invoker回复
+        session->startEventStream(lastSeq);
+    });
+
     //主动关断流，包括关断拉流、推流
     //测试url http://127.0.0.1/index/api/close_stream?schema=rtsp&vhost=__defaultVhost__&app=live&stream=obs&force=1
     API_REGIST(api,close_stream,{
@@ -407,7 +520,6 @@ void installWebApi() {
     //测试url(筛选某端口下的tcp会话) http://127.0.0.1/index/api/getAllSession?local_port=1935
     API_REGIST(api,getAllSession,{
         CHECK_SECRET();
-        Value jsession;
         uint16_t local_port = allArgs["local_port"].as<uint16_t>();
         string &peer_ip = allArgs["peer_ip"];
 
@@ -418,14 +530,42 @@ void installWebApi() {
             if(!peer_ip.empty() && peer_ip != session->get_peer_ip()){
                 return;
             }
+            Value jsession;
             jsession["peer_ip"] = session->get_peer_ip();
             jsession["peer_port"] = session->get_peer_port();
             jsession["local_ip"] = session->get_local_ip();
             jsession["local_port"] = session->get_local_port();
             jsession["id"] = id;
             jsession["typeid"] = typeid(*session).name();
+            auto watermark = dynamic_pointer_cast<ReaderWatermark>(session);
+            if(watermark){
+                //rtsp/rtmp播放器因为网络太慢而丢弃的数据统计
+                jsession["dropTimes"] = (Json::UInt64)watermark->getDropTimes();
+                jsession["dropPackets"] = (Json::UInt64)watermark->getDropPackets();
+                jsession["dropBytes"] = (Json::UInt64)watermark->getDropBytes();
+            }
+            auto rtsp = dynamic_pointer_cast<RtspSession>(session);
+            if(rtsp){
+                //rtsp播放器RR统计的丢包、抖动与往返时延
+                jsession["rtcp"] = makeRtcpStats(rtsp->getRtcpStats());
+            }
             val["data"].append(jsession);
         });
+
+        if(local_port == API::Success && peer_ip.empty()){
+            //rtsp拉流代理发送给服务器的RR统计
+            lock_guard<recursive_mutex> lck(s_proxyMapMtx);
+            for(auto &pr : s_proxyMap){
+                auto stats = pr.second->getRtcpStats();
+                if(!stats){
+                    continue;
+                }
+                Value jpull;
+                jpull["key"] = pr.first;
+                jpull["rtcp"] = makeRtcpStats(stats);
+                val["pulls"].append(jpull);
+            }
+        }
     });
 
     //断开tcp连接，比如说可以断开rtsp、rtmp播放器等
@@ -515,6 +655,36 @@ void installWebApi() {
         val["data"]["flag"] = s_proxyMap.erase(allArgs["key"]) == 1;
     });
 
+    //开启常驻组播，没有rtsp会话时也持续输出，媒体源未注册时等其注册后开始
+    //测试url http://127.0.0.1/index/api/startMulticast?vhost=__defaultVhost__&app=live&stream=obs&local_ip=192.168.1.2
+    API_REGIST(api,startMulticast,{
+        CHECK_SECRET();
+        CHECK_ARGS("vhost","app","stream");
+        string local_ip = allArgs["local_ip"];
+        if(local_ip.empty()){
+            local_ip = SockUtil::get_local_ip();
+        }
+        auto caster = RtpBroadCaster::startAlwaysOn(local_ip,allArgs["vhost"],allArgs["app"],allArgs["stream"]);
+        val["data"]["started"] = (bool)caster;
+        if(caster){
+            val["data"]["ip"] = caster->getIP();
+            val["data"]["video_port"] = caster->getPort(TrackVideo);
+            val["data"]["audio_port"] = caster->getPort(TrackAudio);
+        }
+    });
+
+    //关闭常驻组播
+    //测试url http://127.0.0.1/index/api/stopMulticast?vhost=__defaultVhost__&app=live&stream=obs&local_ip=192.168.1.2
+    API_REGIST(api,stopMulticast,{
+        CHECK_SECRET();
+        CHECK_ARGS("vhost","app","stream");
+        string local_ip = allArgs["local_ip"];
+        if(local_ip.empty()){
+            local_ip = SockUtil::get_local_ip();
+        }
+        val["data"]["flag"] = RtpBroadCaster::stopAlwaysOn(local_ip,allArgs["vhost"],allArgs["app"],allArgs["stream"]);
+    });
+
 #if !defined(_WIN32)
     static auto addFFmepgSource = [](const string &src_url,
                                      const string &dst_url,
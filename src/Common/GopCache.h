@@ -0,0 +1,166 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_GOPCACHE_H
+#define ZLMEDIAKIT_GOPCACHE_H
+
+#include <vector>
+#include <unordered_set>
+#include "Common/config.h"
+#include "Common/MemoryCounter.h"
+#include "Util/TimeTicker.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * gop缓存，保存从最近一个关键帧开始的所有数据包
+ * 新的播放器先收到gop缓存，从而可以立即开始解码播放，而不必等待下一个关键帧
+ * T为数据包智能指针类型，比如RtpPacket::Ptr、RtmpPacket::Ptr
+ */
+template <typename T>
+class GopCache {
+public:
+    GopCache() {}
+    ~GopCache() {}
+
+    /**
+     * 是否开启gop缓存
+     */
+    static bool enabled(){
+        GET_CONFIG(uint32_t,maxMS,General::kGopCacheMaxMS);
+        GET_CONFIG(uint32_t,maxKB,General::kGopCacheMaxKB);
+        return maxMS && maxKB;
+    }
+
+    /**
+     * 输入数据包，非线程安全，由媒体源加锁
+     * @param pkt 数据包
+     * @param key_pos 是否为关键帧的第一个包
+     */
+    void input(const T &pkt, bool key_pos){
+        GET_CONFIG(uint32_t,maxMS,General::kGopCacheMaxMS);
+        GET_CONFIG(uint32_t,maxKB,General::kGopCacheMaxKB);
+        if(!maxMS || !maxKB){
+            //gop缓存已关闭
+            clear();
+            return;
+        }
+
+        if(key_pos){
+            //新的gop开始，丢弃上一个gop
+            clear();
+            _have_key = true;
+            _wait_key = false;
+        }
+
+        if(_wait_key){
+            //上一个gop过大已经被丢弃，等待下一个关键帧
+            return;
+        }
+
+        if(_cache.empty()){
+            _ticker.resetTime();
+        }
+        _cache.emplace_back(pkt);
+        _bytes += pkt->size();
+
+        if(_bytes > maxKB * 1024 || _ticker.elapsedTime() > maxMS || MemoryCounter::isOverBudget()){
+            //gop过大或者全局内存超过预算，丢弃之；纯音频流没有关键帧，此时从下一个包开始重新缓存
+            clear();
+            _wait_key = _have_key;
+        }
+    }
+
+    /**
+     * 获取gop缓存的拷贝
+     */
+    void getCache(vector<T> &out) const{
+        out = _cache;
+    }
+
+    /**
+     * 获取gop缓存占用的字节数
+     */
+    uint64_t getBytes() const{
+        return _bytes;
+    }
+
+    void clear(){
+        _cache.clear();
+        _bytes = 0;
+    }
+private:
+    vector<T> _cache;
+    uint64_t _bytes = 0;
+    bool _have_key = false;
+    bool _wait_key = false;
+    Ticker _ticker;
+};
+
+/**
+ * 播放器收到gop缓存后，环形缓存可能还会再次派发其中的部分数据包，该类用于过滤这些重复的数据包
+ * 环形缓存派发顺序与gop缓存顺序一致，所以收到第一个不在gop缓存中的数据包后即可停止过滤
+ */
+template <typename T>
+class GopCacheFilter {
+public:
+    GopCacheFilter() {}
+    ~GopCacheFilter() {}
+
+    /**
+     * 设置已经发送的gop缓存
+     * 持有数据包的强引用，防止对象池回收后复用导致误判
+     */
+    void reset(const vector<T> &gop){
+        _sent.clear();
+        _sent.insert(gop.begin(),gop.end());
+    }
+
+    /**
+     * 判断是否为已经通过gop缓存发送过的数据包
+     * @return true代表需要丢弃该包
+     */
+    bool filter(const T &pkt){
+        if(_sent.empty()){
+            return false;
+        }
+        if(_sent.find(pkt) != _sent.end()){
+            return true;
+        }
+        //后续的数据包都是新数据
+        _sent.clear();
+        return false;
+    }
+private:
+    unordered_set<T> _sent;
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_GOPCACHE_H
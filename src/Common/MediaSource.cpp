@@ -25,6 +25,8 @@
  */
 
 
+#include <map>
+#include <atomic>
 #include "MediaSource.h"
 #include "MediaFile/MediaReader.h"
 #include "Util/util.h"
@@ -35,8 +37,56 @@ using namespace toolkit;
 
 namespace mediakit {
 
-recursive_mutex MediaSource::g_mtxMediaSrc;
-MediaSource::SchemaVhostAppStreamMap MediaSource::g_mapMediaSrc;
+//媒体源注册表分片个数，必须为2的n次方
+#define MEDIA_SOURCE_SHARD_COUNT 64
+
+/**
+ * 等待某个媒体源注册的播放器
+ */
+class MediaSourceWaiter {
+public:
+    MediaInfo _info;
+    weak_ptr<TcpSession> _session;
+    function<void(const MediaSource::Ptr &src)> _cb;
+    DelayTask::Ptr _timer;
+};
+
+/**
+ * 媒体源注册表分片
+ * 注册表按照schema/vhost/app/stream拼接的扁平key哈希后分散到各个分片，
+ * 每个分片有独立的锁，这样不同流的查找、注册、反注册不会竞争同一把锁
+ */
+class MediaSourceShard {
+public:
+    mutex _mtx;
+    unordered_map<string, weak_ptr<MediaSource> > _mapMediaSrc;
+    //等待流注册的播放器，与注册表使用同一个key，注册时只唤醒等待该key的播放器
+    //按等待id排序，保证先来的播放器先被唤醒
+    unordered_map<string, map<uint64_t, MediaSourceWaiter> > _mapWaiter;
+};
+
+static MediaSourceShard s_shards[MEDIA_SOURCE_SHARD_COUNT];
+static atomic<uint64_t> s_waiterId(0);
+
+//app与vhost中不可能包含'/'，只有stream可能包含，所以拼接后的key不会冲突
+static string getMediaKey(const string &schema,const string &vhost,const string &app,const string &id){
+    string key;
+    key.reserve(schema.size() + vhost.size() + app.size() + id.size() + 3);
+    key.append(schema).append(1,'/').append(vhost).append(1,'/').append(app).append(1,'/').append(id);
+    return key;
+}
+
+static MediaSourceShard &getShard(const string &key){
+    return s_shards[std::hash<string>()(key) & (MEDIA_SOURCE_SHARD_COUNT - 1)];
+}
+
+static string getMediaVhost(const string &vhost){
+    GET_CONFIG(bool,enableVhost,General::kEnableVhost);
+    if(vhost.empty() || !enableVhost){
+        return DEFAULT_VHOST;
+    }
+    return vhost;
+}
 
 
 void MediaSource::findAsync(const MediaInfo &info,
@@ -54,89 +104,84 @@ void MediaSource::findAsync(const MediaInfo &info,
         return;
     }
 
-    void *listener_tag = session.get();
-    weak_ptr<TcpSession> weakSession = session;
     //广播未找到流,此时可以立即去拉流，这样还来得及
     NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastNotFoundStream,info,*session);
 
     //最多等待一定时间，如果这个时间内，流未注册上，那么返回未找到流
     GET_CONFIG(int,maxWaitMS,General::kMaxStreamWaitTimeMS);
 
-    //若干秒后执行等待媒体注册超时回调
-    auto onRegistTimeout = session->getPoller()->doDelayTask(maxWaitMS,[cb,listener_tag](){
-        //取消监听该事件
-        NoticeCenter::Instance().delListener(listener_tag,Broadcast::kBroadcastMediaChanged);
+    auto key = getMediaKey(info._schema, getMediaVhost(info._vhost), info._app, info._streamid);
+    auto &shard = getShard(key);
+    auto waiter_id = ++s_waiterId;
+
+    //若干秒后执行等待媒体注册超时回调，定时器在会话所在的线程上触发
+    auto onRegistTimeout = session->getPoller()->doDelayTask(maxWaitMS,[key,waiter_id](){
+        auto &shard = getShard(key);
+        function<void(const MediaSource::Ptr &src)> cb;
+        {
+            lock_guard<mutex> lock(shard._mtx);
+            auto it = shard._mapWaiter.find(key);
+            if(it == shard._mapWaiter.end()){
+                return 0;
+            }
+            auto it_waiter = it->second.find(waiter_id);
+            if(it_waiter == it->second.end()){
+                //已经被注册事件唤醒
+                return 0;
+            }
+            cb = std::move(it_waiter->second._cb);
+            it->second.erase(it_waiter);
+            if(it->second.empty()){
+                shard._mapWaiter.erase(it);
+            }
+        }
         cb(nullptr);
         return 0;
     });
 
-    auto onRegist = [listener_tag,weakSession,info,cb,onRegistTimeout](BroadcastMediaChangedArgs) {
-        auto strongSession = weakSession.lock();
-        if(!strongSession) {
-            //自己已经销毁
-            //取消延时任务，防止多次回调
-            onRegistTimeout->cancel();
-            //取消事件监听
-            NoticeCenter::Instance().delListener(listener_tag,Broadcast::kBroadcastMediaChanged);
-            return;
-        }
-
-        if(!bRegist || schema != info._schema || vhost != info._vhost || app != info._app ||stream != info._streamid){
-            //不是自己感兴趣的事件，忽略之
-            return;
+    bool registed = false;
+    {
+        lock_guard<mutex> lock(shard._mtx);
+        //在同一把锁内再确认一次注册表，防止在广播未找到流期间流已经注册上导致错过唤醒
+        auto it = shard._mapMediaSrc.find(key);
+        if(it != shard._mapMediaSrc.end() && !it->second.expired()){
+            registed = true;
+        } else {
+            auto &waiter = shard._mapWaiter[key][waiter_id];
+            waiter._info = info;
+            waiter._session = session;
+            waiter._cb = cb;
+            waiter._timer = onRegistTimeout;
         }
+    }
 
-        //取消延时任务，防止多次回调
+    if(registed){
         onRegistTimeout->cancel();
-        //取消事件监听
-        NoticeCenter::Instance().delListener(listener_tag,Broadcast::kBroadcastMediaChanged);
-
-        //播发器请求的流终于注册上了，切换到自己的线程再回复
-        strongSession->async([weakSession,info,cb](){
-            auto strongSession = weakSession.lock();
-            if(!strongSession) {
-                return;
-            }
-            DebugL << "收到媒体注册事件,回复播放器:" << info._schema << "/" << info._vhost << "/" << info._app << "/" << info._streamid;
-            //再找一遍媒体源，一般能找到
-            findAsync(info,strongSession,false,cb);
-        }, false);
-    };
-    //监听媒体注册事件
-    NoticeCenter::Instance().addListener(listener_tag, Broadcast::kBroadcastMediaChanged, onRegist);
+        findAsync(info,session,false,cb);
+    }
 }
+
 MediaSource::Ptr MediaSource::find(
         const string &schema,
         const string &vhost_tmp,
         const string &app,
         const string &id,
         bool bMake) {
-    string vhost = vhost_tmp;
-    if(vhost.empty()){
-        vhost = DEFAULT_VHOST;
-    }
-
-    GET_CONFIG(bool,enableVhost,General::kEnableVhost);
-    if(!enableVhost){
-        vhost = DEFAULT_VHOST;
-    }
-
-    lock_guard<recursive_mutex> lock(g_mtxMediaSrc);
+    auto vhost = getMediaVhost(vhost_tmp);
+    auto key = getMediaKey(schema, vhost, app, id);
+    auto &shard = getShard(key);
     MediaSource::Ptr ret;
-    searchMedia(schema, vhost, app, id,
-                [&](SchemaVhostAppStreamMap::iterator &it0 ,
-                    VhostAppStreamMap::iterator &it1,
-                    AppStreamMap::iterator &it2,
-                    StreamMap::iterator &it3){
-                    ret = it3->second.lock();
-                    if(!ret){
-                        //该对象已经销毁
-                        it2->second.erase(it3);
-                        eraseIfEmpty(it0,it1,it2);
-                        return false;
-                    }
-                    return true;
-                });
+    {
+        lock_guard<mutex> lock(shard._mtx);
+        auto it = shard._mapMediaSrc.find(key);
+        if (it != shard._mapMediaSrc.end()) {
+            ret = it->second.lock();
+            if (!ret) {
+                //该对象已经销毁
+                shard._mapMediaSrc.erase(it);
+            }
+        }
+    }
     if(!ret && bMake){
         //查找某一媒体源，找到后返回
         ret = MediaReader::onMakeMediaSource(schema, vhost,app,id);
@@ -148,12 +193,44 @@ void MediaSource::regist() {
     if(!enableVhost){
         _strVhost = DEFAULT_VHOST;
     }
+    map<uint64_t, MediaSourceWaiter> waiters;
     //注册该源，注册后服务器才能找到该源
     {
-        lock_guard<recursive_mutex> lock(g_mtxMediaSrc);
-        g_mapMediaSrc[_strSchema][_strVhost][_strApp][_strId] =  shared_from_this();
+        auto key = getMediaKey(_strSchema, _strVhost, _strApp, _strId);
+        auto &shard = getShard(key);
+        lock_guard<mutex> lock(shard._mtx);
+        shard._mapMediaSrc[key] = shared_from_this();
+        //取出等待该流的播放器
+        auto it = shard._mapWaiter.find(key);
+        if(it != shard._mapWaiter.end()){
+            waiters.swap(it->second);
+            shard._mapWaiter.erase(it);
+        }
     }
     InfoL << _strSchema << " " << _strVhost << " " << _strApp << " " << _strId;
+    for(auto &pr : waiters){
+        auto &waiter = pr.second;
+        //取消延时任务，防止多次回调
+        waiter._timer->cancel();
+        auto strongSession = waiter._session.lock();
+        if(!strongSession){
+            //播放器已经销毁
+            continue;
+        }
+        weak_ptr<TcpSession> weakSession = strongSession;
+        auto info = waiter._info;
+        auto cb = waiter._cb;
+        //播发器请求的流终于注册上了，切换到自己的线程再回复
+        strongSession->async([weakSession,info,cb](){
+            auto strongSession = weakSession.lock();
+            if(!strongSession) {
+                return;
+            }
+            DebugL << "收到媒体注册事件,回复播放器:" << info._schema << "/" << info._vhost << "/" << info._app << "/" << info._streamid;
+            //再找一遍媒体源，一般能找到
+            findAsync(info,strongSession,false,cb);
+        }, false);
+    }
     NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastMediaChanged,
                                        true,
                                        _strSchema,
@@ -164,22 +241,76 @@ void MediaSource::regist() {
 }
 bool MediaSource::unregist() {
     //反注册该源
-    lock_guard<recursive_mutex> lock(g_mtxMediaSrc);
-    return searchMedia(_strSchema, _strVhost, _strApp, _strId, [&](SchemaVhostAppStreamMap::iterator &it0 ,
-                                                                       VhostAppStreamMap::iterator &it1,
-                                                                       AppStreamMap::iterator &it2,
-                                                                       StreamMap::iterator &it3){
-        auto strongMedia = it3->second.lock();
-        if(strongMedia && this != strongMedia.get()){
+    auto key = getMediaKey(_strSchema, _strVhost, _strApp, _strId);
+    auto &shard = getShard(key);
+    {
+        lock_guard<mutex> lock(shard._mtx);
+        auto it = shard._mapMediaSrc.find(key);
+        if (it == shard._mapMediaSrc.end()) {
+            return false;
+        }
+        auto strongMedia = it->second.lock();
+        if (strongMedia && this != strongMedia.get()) {
             //不是自己,不允许反注册
             return false;
         }
-        it2->second.erase(it3);
-        eraseIfEmpty(it0,it1,it2);
-        unregisted();
-        return true;
-    });
+        shard._mapMediaSrc.erase(it);
+    }
+    //在锁外广播，防止监听者在回调中查找媒体源导致死锁
+    unregisted();
+    return true;
 }
+
+vector<MediaSource::Ptr> MediaSource::getMediaList() {
+    vector<MediaSource::Ptr> ret;
+    for (auto &shard : s_shards) {
+        //每个分片只锁住拷贝的时间，遍历时不持有任何锁
+        lock_guard<mutex> lock(shard._mtx);
+        for (auto it = shard._mapMediaSrc.begin(); it != shard._mapMediaSrc.end();) {
+            auto media = it->second.lock();
+            if (!media) {
+                //该对象已经销毁
+                it = shard._mapMediaSrc.erase(it);
+                continue;
+            }
+            ret.emplace_back(std::move(media));
+            ++it;
+        }
+    }
+    return ret;
+}
+
+int MediaSource::readerPollerCount() {
+    lock_guard<mutex> lock(_mtxPollerReader);
+    return _mapPollerReader.size();
+}
+
+int MediaSource::protocolReaderCount() {
+    lock_guard<mutex> lock(_mtxPollerReader);
+    int ret = 0;
+    for (auto &pr : _mapPollerReader) {
+        ret += pr.second;
+    }
+    return ret;
+}
+
+void MediaSource::onPollerReaderChanged(const EventPoller::Ptr &poller, int size) {
+    int readerCount = 0;
+    {
+        lock_guard<mutex> lock(_mtxPollerReader);
+        if(size > 0){
+            _mapPollerReader[poller.get()] = size;
+        }else{
+            //该线程上已经没有观看者了，环形缓存也会移除该线程的分发器
+            _mapPollerReader.erase(poller.get());
+        }
+        for (auto &pr : _mapPollerReader) {
+            readerCount += pr.second;
+        }
+    }
+    NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastReaderChanged,*this,readerCount);
+}
+
 void MediaSource::unregisted(){
     InfoL <<  "" <<  _strSchema << " " << _strVhost << " " << _strApp << " " << _strId;
     NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastMediaChanged,
@@ -31,13 +31,17 @@
 #include <mutex>
 #include <string>
 #include <memory>
+#include <vector>
 #include <functional>
 #include <unordered_map>
 #include "Common/config.h"
 #include "Common/Parser.h"
+#include "Common/MemoryCounter.h"
+#include "Common/MediaStats.h"
 #include "Util/logger.h"
 #include "Util/TimeTicker.h"
 #include "Util/NoticeCenter.h"
+#include "Poller/EventPoller.h"
 #include "Extension/Track.h"
 
 using namespace std;
@@ -95,10 +99,6 @@ public:
 class MediaSource: public enable_shared_from_this<MediaSource> {
 public:
     typedef std::shared_ptr<MediaSource> Ptr;
-    typedef unordered_map<string, weak_ptr<MediaSource> > StreamMap;
-    typedef unordered_map<string, StreamMap > AppStreamMap;
-    typedef unordered_map<string, AppStreamMap > VhostAppStreamMap;
-    typedef unordered_map<string, VhostAppStreamMap > SchemaVhostAppStreamMap;
 
     MediaSource(const string &strSchema,
                 const string &strVhost,
@@ -171,76 +171,89 @@ public:
         _listener = listener;
     }
 
+    /**
+     * 遍历所有媒体源，遍历时不持有注册表的锁，回调中可以安全的查找或注册媒体源
+     * @param fun 回调函数，参数分别为schema、vhost、app、stream、媒体源
+     */
     template <typename FUN>
     static void for_each_media(FUN && fun){
-        lock_guard<recursive_mutex> lock(g_mtxMediaSrc);
-        for (auto &pr0 : g_mapMediaSrc){
-            for(auto &pr1 : pr0.second){
-                for(auto &pr2 : pr1.second){
-                    for(auto &pr3 : pr2.second){
-                        fun(pr0.first,pr1.first,pr2.first,pr3.first,pr3.second.lock());
-                    }
-                }
-            }
+        for (auto &media : getMediaList()){
+            fun(media->getSchema(),media->getVhost(),media->getApp(),media->getId(),media);
         }
     }
 
+    /**
+     * 获取所有媒体源的快照
+     * @return 当前注册的所有媒体源
+     */
+    static vector<Ptr> getMediaList();
+
     virtual int readerCount() = 0;
+
+    /**
+     * 获取观看者分布在多少个线程上
+     * 环形缓存每写入一个包，每个有观看者的线程只被唤醒一次，再由该线程依次回调本线程上的观看者，
+     * 所以该值即为每个包引起的跨线程任务个数
+     */
+    int readerPollerCount();
+
+    /**
+     * 获取本协议的观看者个数，不包含转换成其他协议后的观看者
+     */
+    int protocolReaderCount();
+
+    /**
+     * 获取该流的实时统计，没有统计时返回空
+     */
+    MediaStats::Ptr getStats() const {
+        return _stats;
+    }
+
+    /**
+     * 设置该流的实时统计，同一个流的各协议媒体源共用一个统计对象
+     */
+    void setStats(const MediaStats::Ptr &stats) {
+        _stats = stats;
+    }
+
+    /**
+     * 获取该源缓存中(环形缓存、gop缓存、正在派发)的媒体数据字节数
+     */
+    int64_t getMemoryBytes() const {
+        return _memoryCounter->getBytes();
+    }
+
+    /**
+     * 获取gop缓存字节数，gop缓存中的数据也包含在getMemoryBytes中
+     */
+    virtual uint64_t getGopCacheBytes() {
+        return 0;
+    }
 protected:
     void regist() ;
     bool unregist() ;
-private:
-        template <typename FUN>
-        static bool searchMedia(const string &schema,
-                                const string &vhost,
-                                const string &app,
-                                const string &id,
-                                FUN &&fun){
-        auto it0 = g_mapMediaSrc.find(schema);
-        if (it0 == g_mapMediaSrc.end()) {
-            //未找到协议
-            return false;
-        }
-        auto it1 = it0->second.find(vhost);
-        if(it1 == it0->second.end()){
-            //未找到vhost
-            return false;
-        }
-        auto it2 = it1->second.find(app);
-        if(it2 == it1->second.end()){
-            //未找到app
-            return false;
-        }
-        auto it3 = it2->second.find(id);
-        if(it3 == it2->second.end()){
-            //未找到streamId
-            return false;
-        }
-        return fun(it0,it1,it2,it3);
-    }
-    template <typename IT0,typename IT1,typename IT2>
-    static void eraseIfEmpty(IT0 it0,IT1 it1,IT2 it2){
-        if(it2->second.empty()){
-            it1->second.erase(it2);
-            if(it1->second.empty()){
-                it0->second.erase(it1);
-                if(it0->second.empty()){
-                    g_mapMediaSrc.erase(it0);
-                }
-            }
-        }
-    };
 
+    /**
+     * 环形缓存某线程上的观看者个数发生变化，在该线程上回调
+     * @param poller 观看者所在线程
+     * @param size 该线程上剩余的观看者个数
+     */
+    void onPollerReaderChanged(const EventPoller::Ptr &poller,int size);
+private:
     void unregisted();
 protected:
     std::weak_ptr<MediaSourceEvent> _listener;
+    //媒体数据内存统计
+    MemoryCounter::Ptr _memoryCounter = std::make_shared<MemoryCounter>();
+    //实时统计
+    MediaStats::Ptr _stats;
 private:
+    mutex _mtxPollerReader;
+    unordered_map<EventPoller *,int> _mapPollerReader;
     string _strSchema;//协议类型
     string _strVhost; //vhost
     string _strApp; //媒体app
     string _strId; //媒体id
-    static SchemaVhostAppStreamMap g_mapMediaSrc; //静态的媒体源表
-    static recursive_mutex g_mtxMediaSrc; //访问静态的媒体源表的互斥锁
 };
 
 } /* namespace mediakit */
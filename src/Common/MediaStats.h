@@ -0,0 +1,235 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_MEDIASTATS_H
+#define ZLMEDIAKIT_MEDIASTATS_H
+
+#include <atomic>
+#include <memory>
+#include <cstdlib>
+#include "Util/util.h"
+#include "Extension/Frame.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 某个track的统计快照
+ */
+class MediaTrackStats {
+public:
+    //累计帧数
+    uint64_t frames = 0;
+    //累计字节数
+    uint64_t bytes = 0;
+    //最近一个统计窗口的码率，单位bit/s
+    uint64_t bitrate = 0;
+    //最近一个统计窗口的帧率
+    float fps = 0;
+    //最近一个gop的帧数，仅视频有效
+    uint32_t gopFrames = 0;
+    //最近两个关键帧的时间戳间隔，单位毫秒，仅视频有效
+    uint32_t keyInterval = 0;
+    //时间戳回退或跳跃的次数
+    uint64_t stampJumps = 0;
+    //rtp丢包个数，仅rtsp推流或拉流有效
+    uint64_t rtpLost = 0;
+    //rtp当前排序缓存深度
+    uint32_t jitterSize = 0;
+    //rtp最大排序缓存深度
+    uint32_t jitterMax = 0;
+    //距离最后一帧的时间，单位毫秒
+    uint64_t idleMS = 0;
+};
+
+/**
+ * 媒体流实时统计
+ * 在输入线程中随着每一帧增量更新，统计值都是原子变量，其他线程可以无锁读取；
+ * 码率和帧率按固定时间窗口计算
+ */
+class MediaStats : public FrameWriterInterface {
+public:
+    typedef std::shared_ptr<MediaStats> Ptr;
+    MediaStats() {}
+    ~MediaStats() override {}
+
+    /**
+     * 输入帧，同一个对象只能在一个线程中调用
+     */
+    void inputFrame(const Frame::Ptr &frame) override {
+        auto type = frame->getTrackType();
+        if (type != TrackVideo && type != TrackAudio) {
+            return;
+        }
+        auto &track = _tracks[type];
+        auto now = getCurrentMillisecond();
+        auto dts = frame->dts();
+        auto bytes = frame->size() - frame->prefixSize();
+
+        track.frames.fetch_add(1, memory_order_relaxed);
+        track.bytes.fetch_add(bytes, memory_order_relaxed);
+
+        if (track.haveStamp && abs((int64_t) dts - (int64_t) track.lastStamp) > kStampJumpMS) {
+            //时间戳回退或者跳跃
+            track.stampJumps.fetch_add(1, memory_order_relaxed);
+        }
+        track.haveStamp = true;
+        track.lastStamp = dts;
+
+        if (type == TrackVideo) {
+            //同一个关键帧可能被拆分成多个slice，时间戳相同
+            if (frame->keyFrame() && (!track.haveKey || dts != track.lastKeyStamp)) {
+                if (track.haveKey) {
+                    track.gopFrames.store(track.framesSinceKey, memory_order_relaxed);
+                    track.keyInterval.store(dts - track.lastKeyStamp, memory_order_relaxed);
+                }
+                track.haveKey = true;
+                track.lastKeyStamp = dts;
+                track.framesSinceKey = 0;
+            }
+            ++track.framesSinceKey;
+        }
+
+        //滑动窗口统计码率、帧率
+        if (!track.windowStart) {
+            track.windowStart = now;
+        }
+        track.windowBytes += bytes;
+        ++track.windowFrames;
+        auto elapsed = now - track.windowStart;
+        if (elapsed >= kWindowMS) {
+            track.bitrate.store(track.windowBytes * 8 * 1000 / elapsed, memory_order_relaxed);
+            track.fps.store(track.windowFrames * 1000.0f / elapsed, memory_order_relaxed);
+            track.windowStart = now;
+            track.windowBytes = 0;
+            track.windowFrames = 0;
+        }
+        track.lastInput.store(now, memory_order_relaxed);
+    }
+
+    /**
+     * 增加rtp丢包个数，乱序到达的包会减少丢包计数
+     * @param type track类型
+     * @param count 丢包个数，负数代表之前统计为丢包的包乱序到达了
+     */
+    void addRtpLost(TrackType type, int64_t count) {
+        if (type == TrackVideo || type == TrackAudio) {
+            _tracks[type].rtpLost.fetch_add(count, memory_order_relaxed);
+        }
+    }
+
+    /**
+     * 设置rtp排序缓存深度
+     */
+    void setJitterSize(TrackType type, uint32_t size) {
+        if (type != TrackVideo && type != TrackAudio) {
+            return;
+        }
+        auto &track = _tracks[type];
+        track.jitterSize.store(size, memory_order_relaxed);
+        if (size > track.jitterMax.load(memory_order_relaxed)) {
+            track.jitterMax.store(size, memory_order_relaxed);
+        }
+    }
+
+    /**
+     * 是否有该track的数据
+     */
+    bool haveTrack(TrackType type) const {
+        if (type != TrackVideo && type != TrackAudio) {
+            return false;
+        }
+        return _tracks[type].frames.load(memory_order_relaxed) != 0;
+    }
+
+    /**
+     * 获取某个track的统计快照，可以在任意线程调用
+     */
+    MediaTrackStats getTrackStats(TrackType type) const {
+        MediaTrackStats ret;
+        if (type != TrackVideo && type != TrackAudio) {
+            return ret;
+        }
+        auto &track = _tracks[type];
+        ret.frames = track.frames.load(memory_order_relaxed);
+        ret.bytes = track.bytes.load(memory_order_relaxed);
+        ret.gopFrames = track.gopFrames.load(memory_order_relaxed);
+        ret.keyInterval = track.keyInterval.load(memory_order_relaxed);
+        ret.stampJumps = track.stampJumps.load(memory_order_relaxed);
+        auto lost = track.rtpLost.load(memory_order_relaxed);
+        ret.rtpLost = lost > 0 ? lost : 0;
+        ret.jitterSize = track.jitterSize.load(memory_order_relaxed);
+        ret.jitterMax = track.jitterMax.load(memory_order_relaxed);
+        auto lastInput = track.lastInput.load(memory_order_relaxed);
+        auto now = getCurrentMillisecond();
+        ret.idleMS = lastInput && now > lastInput ? now - lastInput : 0;
+        if (ret.idleMS < 2 * kWindowMS) {
+            //长时间无数据时码率和帧率为0
+            ret.bitrate = track.bitrate.load(memory_order_relaxed);
+            ret.fps = track.fps.load(memory_order_relaxed);
+        }
+        return ret;
+    }
+private:
+    //统计窗口时长，单位毫秒
+    static const uint64_t kWindowMS = 1000;
+    //相邻两帧时间戳差值超过该值视为时间戳跳跃，单位毫秒
+    static const int64_t kStampJumpMS = 3000;
+
+    class TrackCounter {
+    public:
+        //以下变量可以跨线程读取
+        atomic<uint64_t> frames{0};
+        atomic<uint64_t> bytes{0};
+        atomic<uint64_t> bitrate{0};
+        atomic<float> fps{0};
+        atomic<uint32_t> gopFrames{0};
+        atomic<uint32_t> keyInterval{0};
+        atomic<uint64_t> stampJumps{0};
+        atomic<int64_t> rtpLost{0};
+        atomic<uint32_t> jitterSize{0};
+        atomic<uint32_t> jitterMax{0};
+        atomic<uint64_t> lastInput{0};
+
+        //以下变量只在输入线程访问
+        bool haveStamp = false;
+        uint32_t lastStamp = 0;
+        bool haveKey = false;
+        uint32_t lastKeyStamp = 0;
+        uint32_t framesSinceKey = 0;
+        uint64_t windowStart = 0;
+        uint64_t windowBytes = 0;
+        uint32_t windowFrames = 0;
+    };
+    //按TrackVideo、TrackAudio下标索引
+    TrackCounter _tracks[2];
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_MEDIASTATS_H
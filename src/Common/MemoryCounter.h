@@ -0,0 +1,91 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_MEMORYCOUNTER_H
+#define ZLMEDIAKIT_MEMORYCOUNTER_H
+
+#include <atomic>
+#include <memory>
+#include "Common/config.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 媒体数据内存统计
+ * 每个媒体源一个计数器，统计该源写入环形缓存的媒体数据中仍然存活的字节数，
+ * 这些数据可能被环形缓存、gop缓存、正在派发的任务或者播放器引用，由数据对象在构造(或写入媒体源)与析构时增减；
+ * 所有计数器同时汇总到全局，用于内存预算控制
+ */
+class MemoryCounter {
+public:
+    typedef std::shared_ptr<MemoryCounter> Ptr;
+    MemoryCounter() {}
+    ~MemoryCounter() {}
+
+    /**
+     * 增加或减少统计的字节数
+     */
+    void add(int64_t bytes) {
+        _bytes += bytes;
+        totalBytes() += bytes;
+    }
+
+    /**
+     * 该计数器统计的字节数
+     */
+    int64_t getBytes() const {
+        return _bytes;
+    }
+
+    /**
+     * 全部媒体源统计的字节数
+     */
+    static int64_t getTotalBytes() {
+        return totalBytes();
+    }
+
+    /**
+     * 全部媒体源的内存占用是否超过预算
+     */
+    static bool isOverBudget() {
+        GET_CONFIG(uint32_t, maxMB, General::kMediaMemoryMaxMB);
+        return maxMB && totalBytes() > (int64_t) maxMB * 1024 * 1024;
+    }
+private:
+    static atomic<int64_t> &totalBytes() {
+        static atomic<int64_t> s_totalBytes(0);
+        return s_totalBytes;
+    }
+private:
+    atomic<int64_t> _bytes{0};
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_MEMORYCOUNTER_H
@@ -30,6 +30,145 @@
 #include "Rtsp/RtspMediaSourceMuxer.h"
 #include "Rtmp/RtmpMediaSourceMuxer.h"
 #include "MediaFile/MediaRecorder.h"
+#include "Extension/H264.h"
+#include "Extension/H265.h"
+
+/**
+ * 协议复用器按需打包控制
+ * 某协议无人观看一段时间后，该协议的复用器进入休眠，不再打包；
+ * 有播放器后从下一个关键帧开始恢复打包，关键帧前的sps/pps等配置帧在休眠期间缓存，恢复时先输出
+ */
+class MuxerDemandGate {
+public:
+    typedef function<void(const Frame::Ptr &frame)> onFrame;
+
+    /**
+     * @param onDormant 进入休眠时触发
+     * @param onDrop 休眠期间丢弃帧时触发，用于更新媒体源的时间戳等状态
+     */
+    MuxerDemandGate(const function<void()> &onDormant, const onFrame &onDrop = nullptr) : _onDormant(onDormant), _onDrop(onDrop){}
+    ~MuxerDemandGate(){}
+
+    /**
+     * 输入帧，需要打包时通过output输出，休眠恢复时先输出缓存的配置帧
+     * @param started 媒体源是否已经开始写入，开始写入后才会注册，注册前必须打包，否则播放器找不到该流
+     * @param readerCount 该协议的观看者个数
+     * @param frame 帧
+     * @param output 打包回调
+     */
+    void input(bool started, int readerCount, const Frame::Ptr &frame, const onFrame &output){
+        if(check(started, readerCount, frame)){
+            for(auto &config : _configFrames){
+                //配置帧可能来自更早的gop，时间戳与关键帧对齐，避免时间戳回退
+                output(copyConfigFrame(config, frame->dts()));
+            }
+            _configFrames.clear();
+            output(frame);
+            return;
+        }
+        auto config = _dormant ? copyConfigFrame(frame, frame->dts()) : nullptr;
+        if(config){
+            //关键帧前的配置帧，新的一组配置帧到来时清空之前的
+            if(!_lastIsConfig){
+                _configFrames.clear();
+            }
+            _configFrames.emplace_back(config);
+        }
+        _lastIsConfig = (bool)config;
+        if(_onDrop){
+            _onDrop(frame);
+        }
+    }
+
+    bool isDormant() const{
+        return _dormant;
+    }
+private:
+    /**
+     * 判断是否需要打包该帧
+     */
+    bool check(bool started, int readerCount, const Frame::Ptr &frame){
+        if(frame->getTrackType() == TrackVideo){
+            _haveVideo = true;
+        }
+        if(!started || readerCount > 0){
+            _ticker.resetTime();
+        }
+
+        if(!_dormant){
+            GET_CONFIG(int,delayMS,General::kStreamNoneReaderDelayMS);
+            //媒体源在无人观看kStreamNoneReaderDelayMS后写入数据时才会触发无人观看事件，
+            //所以多等待一倍的时间，确保休眠前该事件已经触发(否则拉流代理等不会被关闭)
+            if(_ticker.elapsedTime() <= 2 * delayMS){
+                return true;
+            }
+            //无人观看超过一定时间，进入休眠
+            _dormant = true;
+            _onDormant();
+            return false;
+        }
+
+        if(readerCount <= 0){
+            //休眠中
+            return false;
+        }
+        if(_haveVideo && (frame->getTrackType() != TrackVideo || !frame->keyFrame())){
+            //有播放器了，等待关键帧再恢复打包
+            return false;
+        }
+        _dormant = false;
+        return true;
+    }
+
+    /**
+     * 拷贝sps/pps/vps等配置帧，输入的帧可能引用临时内存，缓存前必须拷贝
+     * @param stamp 拷贝后的时间戳
+     * @return 不是配置帧时返回空
+     */
+    static Frame::Ptr copyConfigFrame(const Frame::Ptr &frame, uint32_t stamp){
+        if(frame->getTrackType() != TrackVideo || frame->size() <= frame->prefixSize()){
+            return nullptr;
+        }
+        auto nal = (uint8_t)frame->data()[frame->prefixSize()];
+        switch (frame->getCodecId()){
+            case CodecH264:{
+                auto type = H264_TYPE(nal);
+                if(type != H264Frame::NAL_SPS && type != H264Frame::NAL_PPS){
+                    return nullptr;
+                }
+                return copyFrame<H264Frame>(frame, type, stamp);
+            }
+            case CodecH265:{
+                auto type = H265_TYPE(nal);
+                if(type != H265Frame::NAL_VPS && type != H265Frame::NAL_SPS && type != H265Frame::NAL_PPS){
+                    return nullptr;
+                }
+                return copyFrame<H265Frame>(frame, type, stamp);
+            }
+            default:
+                return nullptr;
+        }
+    }
+
+    template<typename FrameType>
+    static Frame::Ptr copyFrame(const Frame::Ptr &frame, int type, uint32_t stamp){
+        auto ret = std::make_shared<FrameType>();
+        ret->type = type;
+        ret->iPrefixSize = frame->prefixSize();
+        ret->buffer.assign(frame->data(), frame->size());
+        ret->timeStamp = stamp;
+        return ret;
+    }
+private:
+    function<void()> _onDormant;
+    onFrame _onDrop;
+    Ticker _ticker;
+    bool _dormant = false;
+    bool _haveVideo = false;
+    //休眠期间最近的一组配置帧
+    vector<Frame::Ptr> _configFrames;
+    bool _lastIsConfig = false;
+};
 
 class MultiMediaSourceMuxer : public FrameWriterInterface{
 public:
@@ -40,10 +179,16 @@ public:
                           const string &strId,
                           float dur_sec = 0.0,
                           bool bEanbleHls = true,
-                          bool bEnableMp4 = false){
+                          bool bEnableMp4 = false) :
+            _rtmpGate([this](){ _rtmp->clearCache(); }),
+            _rtspGate([this](){ _rtsp->clearCache(); },
+                      [this](const Frame::Ptr &frame){ _rtsp->updateStamp(frame); }){
         _rtmp = std::make_shared<RtmpMediaSourceMuxer>(vhost,strApp,strId,std::make_shared<TitleMete>(dur_sec));
         _rtsp = std::make_shared<RtspMediaSourceMuxer>(vhost,strApp,strId,std::make_shared<TitleSdp>(dur_sec));
         _record = std::make_shared<MediaRecorder>(vhost,strApp,strId,bEanbleHls,bEnableMp4);
+        _stats = std::make_shared<MediaStats>();
+        _rtmp->setStats(_stats);
+        _rtsp->setStats(_stats);
 
     }
     virtual ~MultiMediaSourceMuxer(){}
@@ -64,8 +209,14 @@ public:
      * @param frame 帧数据
      */
     void inputFrame(const Frame::Ptr &frame) override {
-        _rtmp->inputFrame(frame);
-        _rtsp->inputFrame(frame);
+        _stats->inputFrame(frame);
+        //无人观看的协议不打包
+        _rtmpGate.input(_rtmp->isStarted(), _rtmp->readerCount(), frame, [this](const Frame::Ptr &frame){
+            _rtmp->inputFrame(frame);
+        });
+        _rtspGate.input(_rtsp->isStarted(), _rtsp->readerCount(), frame, [this](const Frame::Ptr &frame){
+            _rtsp->inputFrame(frame);
+        });
         _record->inputFrame(frame);
     }
 
@@ -89,10 +240,20 @@ public:
     void setTimeStamp(uint32_t stamp){
         _rtsp->setTimeStamp(stamp);
     }
+
+    /**
+     * 获取实时统计
+     */
+    const MediaStats::Ptr &getStats() const{
+        return _stats;
+    }
 private:
     RtmpMediaSourceMuxer::Ptr _rtmp;
     RtspMediaSourceMuxer::Ptr _rtsp;
     MediaRecorder::Ptr _record;
+    MediaStats::Ptr _stats;
+    MuxerDemandGate _rtmpGate;
+    MuxerDemandGate _rtspGate;
 };
 
 
@@ -0,0 +1,159 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_READERWATERMARK_H
+#define ZLMEDIAKIT_READERWATERMARK_H
+
+#include <cstdint>
+#include <atomic>
+#include "Common/config.h"
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 慢速播放器处理策略
+ * 播放器网络太慢时套接字会持续忙，发送缓存不断增长，占用内存且延时越来越大；
+ * 套接字忙期间积压的字节数或时长超过上限后，丢弃后续的媒体数据，
+ * 等待发送缓存清空后再从gop缓存(或下一个关键帧)恢复播放
+ */
+class ReaderWatermark {
+public:
+    ReaderWatermark() {}
+    virtual ~ReaderWatermark() {}
+
+    /**
+     * 发送媒体数据前调用
+     * @param bytes 该媒体数据字节数
+     * @param socketBusy 套接字是否忙
+     * @param keyPos 是否为关键帧的开始
+     * @return 是否可以发送，返回false时须丢弃该数据
+     */
+    bool checkSend(uint32_t bytes, bool socketBusy, bool keyPos) {
+        if (_status == status_wait_key) {
+            if (!keyPos) {
+                onDrop(bytes);
+                return false;
+            }
+            //从关键帧开始恢复
+            _status = status_normal;
+        }
+
+        if (_status == status_dropping) {
+            onDrop(bytes);
+            return false;
+        }
+
+        if (!socketBusy) {
+            //数据可以立即写入套接字
+            _busy = false;
+            _backlogBytes = 0;
+            return true;
+        }
+
+        if (!_busy) {
+            _busy = true;
+            _busyTicker.resetTime();
+        }
+        _backlogBytes += bytes;
+
+        GET_CONFIG(uint32_t, maxKB, General::kReaderMaxBacklogKB);
+        GET_CONFIG(uint32_t, maxMS, General::kReaderMaxBacklogMS);
+        if ((maxKB && _backlogBytes > maxKB * 1024) || (maxMS && _busyTicker.elapsedTime() > maxMS)) {
+            WarnL << "播放器发送积压过多(" << _backlogBytes << "字节," << _busyTicker.elapsedTime() << "毫秒),开始丢弃媒体数据";
+            _status = status_dropping;
+            _dropTimes.fetch_add(1, memory_order_relaxed);
+            onDrop(bytes);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * 套接字发送缓存已经清空
+     * @return 是否需要恢复播放，返回true时调用者应发送gop缓存然后调用resumeSend
+     */
+    bool onSendFlushed() {
+        _busy = false;
+        _backlogBytes = 0;
+        return _status == status_dropping;
+    }
+
+    /**
+     * 恢复播放
+     * @param waitKey 是否需要等待下一个关键帧(gop缓存为空并且有视频时)
+     */
+    void resumeSend(bool waitKey) {
+        _status = waitKey ? status_wait_key : status_normal;
+    }
+
+    /**
+     * 进入丢包状态的次数
+     */
+    uint64_t getDropTimes() const {
+        return _dropTimes.load(memory_order_relaxed);
+    }
+
+    /**
+     * 丢弃的媒体数据个数(rtp帧或rtmp包)
+     */
+    uint64_t getDropPackets() const {
+        return _dropPackets.load(memory_order_relaxed);
+    }
+
+    /**
+     * 丢弃的字节数
+     */
+    uint64_t getDropBytes() const {
+        return _dropBytes.load(memory_order_relaxed);
+    }
+private:
+    void onDrop(uint32_t bytes) {
+        _dropPackets.fetch_add(1, memory_order_relaxed);
+        _dropBytes.fetch_add(bytes, memory_order_relaxed);
+    }
+private:
+    enum {
+        status_normal = 0,
+        status_dropping,
+        status_wait_key
+    } _status = status_normal;
+    bool _busy = false;
+    uint64_t _backlogBytes = 0;
+    Ticker _busyTicker;
+    //统计计数器由其他线程(统计接口)读取
+    atomic<uint64_t> _dropTimes{0};
+    atomic<uint64_t> _dropPackets{0};
+    atomic<uint64_t> _dropBytes{0};
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_READERWATERMARK_H
@@ -0,0 +1,108 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "TcpGatherSender.h"
+#include "Util/util.h"
+
+#if !defined(_WIN32)
+#include <string.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#endif //!defined(_WIN32)
+
+//单次sendmsg最多的iovec个数(IOV_MAX)
+#define GATHER_MAX_IOV 1024
+
+namespace mediakit {
+
+//引用缓存中未发送的剩余数据
+class BufferOffset : public Buffer {
+public:
+    BufferOffset(const Buffer::Ptr &buffer, uint32_t offset) : _buffer(buffer), _offset(offset) {}
+    ~BufferOffset() override {}
+
+    char *data() const override {
+        return _buffer->data() + _offset;
+    }
+    uint32_t size() const override {
+        return _buffer->size() - _offset;
+    }
+private:
+    Buffer::Ptr _buffer;
+    uint32_t _offset;
+};
+
+size_t TcpGatherSender::send(int fd, int flags, vector<Buffer::Ptr> &buffers) {
+#if !defined(_WIN32)
+    size_t total = 0;
+    //已经完整发送的缓存个数
+    size_t index = 0;
+    //buffers[index]已发送的字节数
+    size_t offset = 0;
+    struct iovec iovs[GATHER_MAX_IOV];
+    while (index < buffers.size()) {
+        size_t count = 0;
+        size_t expected = 0;
+        for (; count < GATHER_MAX_IOV && index + count < buffers.size(); ++count) {
+            auto &buf = buffers[index + count];
+            auto skip = count ? 0 : offset;
+            iovs[count].iov_base = buf->data() + skip;
+            iovs[count].iov_len = buf->size() - skip;
+            expected += iovs[count].iov_len;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iovs;
+        msg.msg_iovlen = count;
+        auto sent = sendmsg(fd, &msg, flags);
+        if (sent <= 0) {
+            break;
+        }
+        total += sent;
+        //跳过已经发送的数据
+        auto left = (size_t) sent + offset;
+        while (left && left >= buffers[index]->size()) {
+            left -= buffers[index]->size();
+            ++index;
+        }
+        offset = left;
+        if ((size_t) sent < expected) {
+            //内核发送缓存已满
+            break;
+        }
+    }
+    if (offset) {
+        buffers[index] = std::make_shared<BufferOffset>(buffers[index], offset);
+    }
+    buffers.erase(buffers.begin(), buffers.begin() + index);
+    return total;
+#else
+    return 0;
+#endif //!defined(_WIN32)
+}
+
+}//namespace mediakit
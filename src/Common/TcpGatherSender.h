@@ -0,0 +1,57 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ZLMEDIAKIT_TCPGATHERSENDER_H
+#define ZLMEDIAKIT_TCPGATHERSENDER_H
+
+#include <vector>
+#include "Network/Buffer.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * tcp聚集写
+ * 多个共享的缓存(rtp包、rtmp块、flv tag等)通过sendmsg一次写出，不拷贝数据；
+ * 内核发送缓存满时，未发送的部分仍然以引用方式交给调用者放入socket发送队列
+ */
+class TcpGatherSender {
+public:
+    /**
+     * 尽可能多地发送缓存
+     * @param fd tcp套接字
+     * @param flags sendmsg标志，应与套接字的SocketFlags一致
+     * @param buffers 待发送的缓存，返回时只保留未发送的部分，只发送了一部分的缓存替换为剩余数据的引用
+     * @return 已发送的字节数，非linux/unix平台或发送失败时为0
+     */
+    static size_t send(int fd, int flags, vector<Buffer::Ptr> &buffers);
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_TCPGATHERSENDER_H
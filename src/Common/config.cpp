@@ -67,6 +67,7 @@ const string kBroadcastReloadConfig = "kBroadcastReloadConfig";
 const string kBroadcastShellLogin = "kBroadcastShellLogin";
 const string kBroadcastNotFoundStream = "kBroadcastNotFoundStream";
 const string kBroadcastStreamNoneReader = "kBroadcastStreamNoneReader";
+const string kBroadcastReaderChanged = "kBroadcastReaderChanged";
 } //namespace Broadcast
 
 //通用配置项目
@@ -76,11 +77,21 @@ const string kFlowThreshold = GENERAL_FIELD"flowThreshold";
 const string kStreamNoneReaderDelayMS = GENERAL_FIELD"streamNoneReaderDelayMS";
 const string kMaxStreamWaitTimeMS = GENERAL_FIELD"maxStreamWaitMS";
 const string kEnableVhost = GENERAL_FIELD"enableVhost";
+const string kGopCacheMaxMS = GENERAL_FIELD"gopCacheMaxMS";
+const string kGopCacheMaxKB = GENERAL_FIELD"gopCacheMaxKB";
+const string kReaderMaxBacklogKB = GENERAL_FIELD"readerMaxBacklogKB";
+const string kReaderMaxBacklogMS = GENERAL_FIELD"readerMaxBacklogMS";
+const string kMediaMemoryMaxMB = GENERAL_FIELD"mediaMemoryMaxMB";
 onceToken token([](){
     mINI::Instance()[kFlowThreshold] = 1024;
     mINI::Instance()[kStreamNoneReaderDelayMS] = 5 * 1000;
     mINI::Instance()[kMaxStreamWaitTimeMS] = 5 * 1000;
     mINI::Instance()[kEnableVhost] = 1;
+    mINI::Instance()[kGopCacheMaxMS] = 10 * 1000;
+    mINI::Instance()[kGopCacheMaxKB] = 4 * 1024;
+    mINI::Instance()[kReaderMaxBacklogKB] = 4 * 1024;
+    mINI::Instance()[kReaderMaxBacklogMS] = 5 * 1000;
+    mINI::Instance()[kMediaMemoryMaxMB] = 0;
 },nullptr);
 
 }//namespace General
@@ -130,6 +141,9 @@ const string kRootPath = HTTP_FIELD"rootPath";
 		"</html>"
 const string kNotFound = HTTP_FIELD"notFound";
 
+//事件流api保留的最近事件个数
+const string kEventJournalSize = HTTP_FIELD"eventJournalSize";
+
 
 onceToken token([](){
 	mINI::Instance()[kSendBufSize] = HTTP_SEND_BUF_SIZE;
@@ -138,6 +152,7 @@ onceToken token([](){
 	mINI::Instance()[kMaxReqCount] = HTTP_MAX_REQ_CNT;
 	mINI::Instance()[kCharSet] = HTTP_CHAR_SET;
 	mINI::Instance()[kRootPath] = HTTP_ROOT_PATH;
+	mINI::Instance()[kEventJournalSize] = 4096;
 	mINI::Instance()[kNotFound] = HTTP_NOT_FOUND;
 },nullptr);
 
@@ -161,11 +176,14 @@ namespace Rtsp {
 const string kAuthBasic = RTSP_FIELD"authBasic";
 const string kHandshakeSecond = RTSP_FIELD"handshakeSecond";
 const string kKeepAliveSecond = RTSP_FIELD"keepAliveSecond";
+//udp方式时所有会话复用的rtp端口，0代表不复用
+const string kUdpMuxPort = RTSP_FIELD"udpMuxPort";
 onceToken token([](){
 	//默认Md5方式认证
 	mINI::Instance()[kAuthBasic] = 0;
     mINI::Instance()[kHandshakeSecond] = 15;
     mINI::Instance()[kKeepAliveSecond] = 15;
+    mINI::Instance()[kUdpMuxPort] = 0;
 },nullptr);
 
 } //namespace Rtsp
@@ -176,11 +194,13 @@ namespace Rtmp {
 const string kModifyStamp = RTMP_FIELD"modifyStamp";
 const string kHandshakeSecond = RTMP_FIELD"handshakeSecond";
 const string kKeepAliveSecond = RTMP_FIELD"keepAliveSecond";
+const string kAggregate = RTMP_FIELD"aggregate";
 
 onceToken token([](){
 	mINI::Instance()[kModifyStamp] = true;
     mINI::Instance()[kHandshakeSecond] = 15;
     mINI::Instance()[kKeepAliveSecond] = 15;
+    mINI::Instance()[kAggregate] = false;
 },nullptr);
 
 } //namespace RTMP
@@ -201,21 +221,31 @@ const string kAudioMtuSize = RTP_FIELD"audioMtuSize";
 #define RTP_MAX_RTP_COUNT 50
 const string kMaxRtpCount = RTP_FIELD"maxRtpCount";
 
-//如果RTP序列正确次数累计达到该数字就启动清空排序缓存
-#define RTP_CLEAR_COUNT 10
-const string kClearCount = RTP_FIELD"clearCount";
+//RTP排序缓存最大时长，单位毫秒，0代表不限制
+//不限制时单个丢包要等缓存满maxRtpCount个包才会被跳过，低码率流(比如音频)会因此卡顿1秒左右
+#define RTP_MAX_JITTER_MS 200
+const string kMaxJitterMS = RTP_FIELD"maxJitterMS";
 
-//最大RTP时间为13个小时，每13小时回环一次
+//已废弃，保留该配置项只为兼容旧的配置文件；rtp时间戳由毫秒换算后按32位自然回环
 #define RTP_CYCLE_MS (13*60*60*1000)
 const string kCycleMS = RTP_FIELD"cycleMS";
 
+//udp方式发送rtp时是否批量发送(sendmmsg/GSO)，仅linux下有效
+#define RTP_UDP_BATCH_SEND 1
+const string kUdpBatchSend = RTP_FIELD"udpBatchSend";
+
+//NACK重传缓存时长，单位毫秒，0代表不支持重传
+#define RTP_NACK_CACHE_MS 1000
+const string kNackCacheMS = RTP_FIELD"nackCacheMS";
 
 onceToken token([](){
 	mINI::Instance()[kVideoMtuSize] = RTP_VIDOE_MTU_SIZE;
 	mINI::Instance()[kAudioMtuSize] = RTP_Audio_MTU_SIZE;
 	mINI::Instance()[kMaxRtpCount] = RTP_MAX_RTP_COUNT;
-	mINI::Instance()[kClearCount] = RTP_CLEAR_COUNT;
+	mINI::Instance()[kMaxJitterMS] = RTP_MAX_JITTER_MS;
 	mINI::Instance()[kCycleMS] = RTP_CYCLE_MS;
+	mINI::Instance()[kUdpBatchSend] = RTP_UDP_BATCH_SEND;
+	mINI::Instance()[kNackCacheMS] = RTP_NACK_CACHE_MS;
 },nullptr);
 } //namespace Rtsp
 
@@ -120,6 +120,10 @@ extern const string kBroadcastNotFoundStream;
 extern const string kBroadcastStreamNoneReader;
 #define BroadcastStreamNoneReaderArgs MediaSource &sender
 
+//某个媒体源本协议的观看者个数发生变化时广播，在观看者所在线程触发
+extern const string kBroadcastReaderChanged;
+#define BroadcastReaderChangedArgs MediaSource &sender,const int &readerCount
+
 //更新配置文件事件广播,执行loadIniConfig函数加载配置文件成功后会触发该广播
 extern const string kBroadcastReloadConfig;
 #define BroadcastReloadConfigArgs void
@@ -168,6 +172,17 @@ extern const string kStreamNoneReaderDelayMS;
 extern const string kMaxStreamWaitTimeMS;
 //是否启动虚拟主机
 extern const string kEnableVhost;
+//gop缓存最大时长，单位毫秒，新的播放器可以立即从最近的关键帧开始播放
+//gop时长超过该值时丢弃该gop，直到下一个关键帧，设置为0关闭gop缓存
+extern const string kGopCacheMaxMS;
+//每个媒体源gop缓存最大字节数，单位KB，超过该值时丢弃该gop，设置为0关闭gop缓存
+extern const string kGopCacheMaxKB;
+//播放器发送积压数据上限，单位KB，超过后丢弃媒体数据，直到发送缓存清空后从gop缓存恢复，设置为0不限制
+extern const string kReaderMaxBacklogKB;
+//播放器发送积压时长上限，单位毫秒，套接字持续忙超过该时间后丢弃媒体数据，设置为0不限制
+extern const string kReaderMaxBacklogMS;
+//全部媒体源缓存的媒体数据内存预算，单位MB，超过后丢弃gop缓存并拒绝新的推流，设置为0不限制
+extern const string kMediaMemoryMaxMB;
 }//namespace General
 
 
@@ -187,6 +202,8 @@ extern const string kCharSet;
 extern const string kRootPath;
 //http 404错误提示内容
 extern const string kNotFound;
+//事件流api保留的最近事件个数，断线重连时可以从这些事件中恢复
+extern const string kEventJournalSize;
 }//namespace Http
 
 ////////////SHELL配置///////////
@@ -202,6 +219,8 @@ extern const string kAuthBasic;
 extern const string kHandshakeSecond;
 //维持链接超时时间，默认15秒
 extern const string kKeepAliveSecond;
+//udp方式时所有会话复用的rtp端口，rtcp端口为该端口+1，0代表每个会话单独分配端口
+extern const string kUdpMuxPort;
 } //namespace Rtsp
 
 ////////////RTMP服务器配置///////////
@@ -211,6 +230,10 @@ extern const string kModifyStamp;
 extern const string kHandshakeSecond;
 //维持链接超时时间，默认15秒
 extern const string kKeepAliveSecond;
+//是否开启聚合消息输出，默认关闭
+//开启后同一线程周期内发给播放器的多个音视频消息合并为一个聚合消息(MSG_AGGREGATE)发送
+//开启虚拟主机时可以在与vhost同名的配置段中单独设置，例如[__defaultVhost__]段下的rtmp.aggregate=1
+extern const string kAggregate;
 } //namespace RTMP
 
 
@@ -222,10 +245,14 @@ extern const string kVideoMtuSize;
 extern const string kAudioMtuSize;
 //RTP排序缓存最大个数
 extern const string kMaxRtpCount;
-//如果RTP序列正确次数累计达到该数字就启动清空排序缓存
-extern const string kClearCount;
-//最大RTP时间为13个小时，每13小时回环一次
+//RTP排序缓存最大时长，最早的缓存包比最新包早于该时长时不再等待丢失的包，单位毫秒，0代表不限制
+extern const string kMaxJitterMS;
+//已废弃，rtp时间戳按32位自然回环
 extern const string kCycleMS;
+//udp方式发送rtp时是否批量发送(sendmmsg/GSO)，仅linux下有效
+extern const string kUdpBatchSend;
+//NACK重传缓存时长，单位毫秒，0代表不支持重传
+extern const string kNackCacheMS;
 } //namespace Rtsp
 
 ////////////组播配置///////////
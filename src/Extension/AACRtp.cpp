@@ -42,12 +42,11 @@ AACRtpEncoder::AACRtpEncoder(uint32_t ui32Ssrc,
 void AACRtpEncoder::inputFrame(const Frame::Ptr &frame) {
     RtpCodec::inputFrame(frame);
 
-    GET_CONFIG(uint32_t, cycleMS, Rtp::kCycleMS);
     auto uiStamp = frame->stamp();
     auto pcData = frame->data() + frame->prefixSize();
     auto iLen = frame->size() - frame->prefixSize();
 
-    uiStamp %= cycleMS;
+    //毫秒时间戳转换成rtp时间戳时按32位自然回环，不能再按毫秒取模，否则回环时rtp时间戳会跳变
     char *ptr = (char *) pcData;
     int iSize = iLen;
     while (iSize > 0) {
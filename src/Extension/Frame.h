@@ -74,6 +74,61 @@ public:
     virtual CodecId getCodecId() const = 0;
 };
 
+/**
+ * 采样率时间戳与毫秒的换算比例
+ * 采样率与1000约分后缓存，换算只需一次64位乘除；
+ * 不能像(采样率 / 1000) * 毫秒那样先除，否则44100等采样率每秒会少算100个单位，长时间运行后音视频逐渐不同步
+ */
+class StampScale {
+public:
+    StampScale(uint32_t sample_rate = 1000){
+        setSampleRate(sample_rate);
+    }
+
+    /**
+     * 设置采样率，与之前相同时直接返回
+     */
+    void setSampleRate(uint32_t sample_rate){
+        if(!sample_rate){
+            sample_rate = 1000;
+        }
+        if(sample_rate == _sample_rate){
+            return;
+        }
+        _sample_rate = sample_rate;
+        uint32_t a = sample_rate, b = 1000;
+        while(b){
+            auto t = a % b;
+            a = b;
+            b = t;
+        }
+        _num = sample_rate / a;
+        _den = 1000 / a;
+    }
+
+    uint32_t getSampleRate() const {
+        return _sample_rate;
+    }
+
+    /**
+     * 采样率时间戳转毫秒
+     */
+    uint32_t toMS(uint32_t stamp) const {
+        return (uint64_t)stamp * _den / _num;
+    }
+
+    /**
+     * 毫秒转采样率时间戳，超过32位时回环，与rtp时间戳一致
+     */
+    uint32_t fromMS(uint32_t ms) const {
+        return (uint32_t)((uint64_t)ms * _num / _den);
+    }
+private:
+    uint32_t _sample_rate = 0;
+    uint32_t _num = 1;
+    uint32_t _den = 1;
+};
+
 /**
  * 帧类型的抽象接口
  */
@@ -219,13 +219,12 @@ H264RtpEncoder::H264RtpEncoder(uint32_t ui32Ssrc,
 void H264RtpEncoder::inputFrame(const Frame::Ptr &frame) {
     RtpCodec::inputFrame(frame);
 
-    GET_CONFIG(uint32_t,cycleMS,Rtp::kCycleMS);
     auto pcData = frame->data() + frame->prefixSize();
     auto uiStamp = frame->stamp();
     auto iLen = frame->size() - frame->prefixSize();
     unsigned char naluType =  H264_TYPE(pcData[0]); //获取NALU的5bit 帧类型
 
-    uiStamp %= cycleMS;
+    //毫秒时间戳转换成rtp时间戳时按32位自然回环，不能再按毫秒取模，否则回环时rtp时间戳会跳变
     int iSize = _ui32MtuSize - 2;
     if (iLen > iSize) { //超过MTU
         const unsigned char s_e_r_Start = 0x80;
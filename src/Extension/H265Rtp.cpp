@@ -169,12 +169,11 @@ H265RtpEncoder::H265RtpEncoder(uint32_t ui32Ssrc,
 void H265RtpEncoder::inputFrame(const Frame::Ptr &frame) {
     RtpCodec::inputFrame(frame);
 
-    GET_CONFIG(uint32_t,cycleMS,Rtp::kCycleMS);
     uint8_t *pcData = (uint8_t*)frame->data() + frame->prefixSize();
     auto uiStamp = frame->stamp();
     auto iLen = frame->size() - frame->prefixSize();
     unsigned char naluType = H265_TYPE(pcData[0]); //获取NALU的5bit 帧类型
-    uiStamp %= cycleMS;
+    //毫秒时间戳转换成rtp时间戳时按32位自然回环，不能再按毫秒取模，否则回环时rtp时间戳会跳变
 
     int maxSize = _ui32MtuSize - 3;
     if (iLen > maxSize) { //超过MTU
@@ -0,0 +1,148 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "EventJournal.h"
+#include "Common/config.h"
+#include "Common/MediaSource.h"
+#include "Util/util.h"
+#include "Util/NoticeCenter.h"
+#include "Network/TcpSession.h"
+
+using namespace toolkit;
+
+namespace mediakit {
+
+string EventJournal::Event::toEventStream() const {
+    _StrPrinter printer;
+    printer << "id: " << seq << "\n"
+            << "event: " << type << "\n"
+            << "data: " << data << "\n\n";
+    return printer;
+}
+
+INSTANCE_IMP(EventJournal);
+
+EventJournal::EventJournal() {
+    NoticeCenter::Instance().addListener(this, Broadcast::kBroadcastMediaChanged, [this](BroadcastMediaChangedArgs) {
+        append(bRegist ? "mediaRegist" : "mediaUnregist",
+               StrPrinter << "{\"schema\":\"" << escape(schema)
+                          << "\",\"vhost\":\"" << escape(vhost)
+                          << "\",\"app\":\"" << escape(app)
+                          << "\",\"stream\":\"" << escape(stream) << "\"}" << endl);
+    });
+
+    NoticeCenter::Instance().addListener(this, Broadcast::kBroadcastReaderChanged, [this](BroadcastReaderChangedArgs) {
+        append("readerChanged",
+               StrPrinter << "{\"schema\":\"" << escape(sender.getSchema())
+                          << "\",\"vhost\":\"" << escape(sender.getVhost())
+                          << "\",\"app\":\"" << escape(sender.getApp())
+                          << "\",\"stream\":\"" << escape(sender.getId())
+                          << "\",\"readerCount\":" << readerCount << "}" << endl);
+    });
+
+    NoticeCenter::Instance().addListener(this, Broadcast::kBroadcastFlowReport, [this](BroadcastFlowReportArgs) {
+        append("flowReport",
+               StrPrinter << "{\"schema\":\"" << escape(args._schema)
+                          << "\",\"vhost\":\"" << escape(args._vhost)
+                          << "\",\"app\":\"" << escape(args._app)
+                          << "\",\"stream\":\"" << escape(args._streamid)
+                          << "\",\"totalBytes\":" << totalBytes
+                          << ",\"duration\":" << totalDuration
+                          << ",\"player\":" << (isPlayer ? "true" : "false")
+                          << ",\"ip\":\"" << escape(sender.get_peer_ip()) << "\"}" << endl);
+    });
+}
+
+EventJournal::~EventJournal() {
+    NoticeCenter::Instance().delListener(this, Broadcast::kBroadcastMediaChanged);
+    NoticeCenter::Instance().delListener(this, Broadcast::kBroadcastReaderChanged);
+    NoticeCenter::Instance().delListener(this, Broadcast::kBroadcastFlowReport);
+}
+
+void EventJournal::append(const string &type, const string &data) {
+    GET_CONFIG(uint32_t, maxSize, Http::kEventJournalSize);
+    auto event = std::make_shared<Event>();
+    event->type = type;
+    event->data = data;
+
+    lock_guard<mutex> lck(_mtx);
+    event->seq = ++_seq;
+    _events.emplace_back(event);
+    while (_events.size() > maxSize) {
+        _events.pop_front();
+    }
+    //在锁内通知，保证订阅者按序号顺序收到事件
+    for (auto &pr : _listeners) {
+        pr.second(event);
+    }
+}
+
+bool EventJournal::subscribe(void *tag, uint64_t lastSeq, const onEvent &cb, vector<Event::Ptr> &replay, uint64_t &curSeq) {
+    lock_guard<mutex> lck(_mtx);
+    _listeners[tag] = cb;
+    curSeq = _seq;
+    if (!lastSeq || lastSeq >= _seq) {
+        //只订阅新事件或者没有遗漏事件
+        return lastSeq <= _seq;
+    }
+    //事件序号连续，根据序号直接定位
+    auto firstSeq = _events.empty() ? _seq + 1 : _events.front()->seq;
+    auto it = _events.begin();
+    if (lastSeq + 1 > firstSeq) {
+        it += (lastSeq + 1 - firstSeq);
+    }
+    replay.assign(it, _events.end());
+    return lastSeq + 1 >= firstSeq;
+}
+
+void EventJournal::unsubscribe(void *tag) {
+    lock_guard<mutex> lck(_mtx);
+    _listeners.erase(tag);
+}
+
+string EventJournal::escape(const string &str) {
+    string ret;
+    ret.reserve(str.size());
+    for (auto ch : str) {
+        switch (ch) {
+            case '"' : ret.append("\\\""); break;
+            case '\\' : ret.append("\\\\"); break;
+            case '\n' : ret.append("\\n"); break;
+            case '\r' : ret.append("\\r"); break;
+            case '\t' : ret.append("\\t"); break;
+            default:
+                if ((unsigned char) ch < 0x20) {
+                    //其他控制字符直接忽略
+                    break;
+                }
+                ret.push_back(ch);
+                break;
+        }
+    }
+    return ret;
+}
+
+} /* namespace mediakit */
@@ -0,0 +1,116 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_EVENTJOURNAL_H
+#define ZLMEDIAKIT_EVENTJOURNAL_H
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+using namespace std;
+
+namespace mediakit {
+
+/**
+ * 服务器事件日志
+ * 记录流注册注销、观看者个数变化、流量汇报等事件，每个事件分配一个递增序号，
+ * 保留最近若干个事件，订阅者断线重连后可以从上次收到的序号处继续接收
+ */
+class EventJournal : public std::enable_shared_from_this<EventJournal> {
+public:
+    typedef std::shared_ptr<EventJournal> Ptr;
+
+    class Event {
+    public:
+        typedef std::shared_ptr<const Event> Ptr;
+        //事件序号
+        uint64_t seq;
+        //事件类型
+        string type;
+        //事件内容，json格式
+        string data;
+
+        /**
+         * 转换成Server-Sent Events格式
+         */
+        string toEventStream() const;
+    };
+
+    typedef function<void(const Event::Ptr &event)> onEvent;
+
+    ~EventJournal();
+
+    /**
+     *  获取单例
+     */
+    static EventJournal &Instance();
+
+    /**
+     * 记录事件并通知所有订阅者
+     * @param type 事件类型
+     * @param data 事件内容，json格式
+     */
+    void append(const string &type, const string &data);
+
+    /**
+     * 订阅事件
+     * @param tag 订阅者标记，用于取消订阅
+     * @param lastSeq 订阅者最后收到的事件序号，0代表只订阅新事件
+     * @param cb 新事件回调，在产生事件的线程中并且在锁内触发，请勿在回调中订阅或取消订阅，
+     *           也不要在回调中获取订阅者的强引用(订阅者析构时会取消订阅)，应该只把事件转发到订阅者线程
+     * @param replay lastSeq之后保留的事件
+     * @param curSeq 当前最新的事件序号
+     * @return lastSeq之后的事件是否完整，false代表部分事件已经丢弃，订阅者需要重新获取全量数据
+     */
+    bool subscribe(void *tag, uint64_t lastSeq, const onEvent &cb, vector<Event::Ptr> &replay, uint64_t &curSeq);
+
+    /**
+     * 取消订阅
+     * @param tag 订阅者标记
+     */
+    void unsubscribe(void *tag);
+
+    /**
+     * json字符串转义
+     */
+    static string escape(const string &str);
+private:
+    EventJournal();
+private:
+    mutex _mtx;
+    uint64_t _seq = 0;
+    deque<Event::Ptr> _events;
+    unordered_map<void *, onEvent> _listeners;
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_EVENTJOURNAL_H
@@ -33,8 +33,10 @@
 #include <iomanip>
 
 #include "Common/config.h"
+#include "Common/TcpGatherSender.h"
 #include "strCoding.h"
 #include "HttpSession.h"
+#include "EventJournal.h"
 #include "Util/File.h"
 #include "Util/util.h"
 #include "Util/TimeTicker.h"
@@ -114,6 +116,9 @@ HttpSession::HttpSession(const Socket::Ptr &pSock) : TcpSession(pSock) {
 
 HttpSession::~HttpSession() {
     TraceP(this);
+    if(_eventStream){
+        EventJournal::Instance().unsubscribe(this);
+    }
 }
 
 int64_t HttpSession::onRecvHeader(const char *header,uint64_t len) {
@@ -185,6 +190,14 @@ void HttpSession::onError(const SockException& err) {
 }
 
 void HttpSession::onManager() {
+    if(_eventStream){
+        //事件流长连接不超时，空闲时发送注释行作为心跳，对端断开后发送失败会关闭连接
+        if(_ticker.elapsedTime() > 5 * 1000){
+            send(string(": heartbeat\n\n"));
+            _ticker.resetTime();
+        }
+        return;
+    }
     GET_CONFIG(uint32_t,keepAliveSec,Http::kKeepAliveSecond);
 
     if(_ticker.elapsedTime() > keepAliveSec * 1000){
@@ -927,12 +940,73 @@ inline void HttpSession::sendNotFound(bool bClose) {
 }
 
 
+void HttpSession::startEventStream(uint64_t lastSeq) {
+	auto headerOut = makeHttpHeader(false,-1,"text/event-stream");
+	headerOut["Cache-Control"] = "no-cache";
+	auto Origin = _parser["Origin"];
+	if(!Origin.empty()){
+		headerOut["Access-Control-Allow-Origin"] = Origin;
+		headerOut["Access-Control-Allow-Credentials"] = "true";
+	}
+	sendResponse("200 OK",headerOut,"");
+	_eventStream = true;
+
+	weak_ptr<HttpSession> weakSelf = dynamic_pointer_cast<HttpSession>(shared_from_this());
+	vector<EventJournal::Event::Ptr> replay;
+	uint64_t curSeq = 0;
+	auto poller = getPoller();
+	bool complete = EventJournal::Instance().subscribe(this,lastSeq,[weakSelf,poller](const EventJournal::Event::Ptr &event){
+		//该回调在事件日志的锁内触发，不能在此获取本对象的强引用:
+		//若此时持有最后一个引用，析构时取消订阅会导致死锁，所以只切换到本连接线程后再发送
+		poller->async([weakSelf,event](){
+			auto strongSelf = weakSelf.lock();
+			if(!strongSelf){
+				return;
+			}
+			strongSelf->send(event->toEventStream());
+			strongSelf->_ticker.resetTime();
+		},false);
+	},replay,curSeq);
+
+	_StrPrinter printer;
+	//断线后客户端3秒后重连，重连时会通过Last-Event-ID头告知最后收到的事件序号
+	printer << "retry: 3000\n\n";
+	if(!complete){
+		//部分事件已经丢弃，客户端需要重新获取全量数据(例如调用getMediaList)
+		printer << "id: " << curSeq << "\nevent: reset\ndata: {\"seq\":" << curSeq << "}\n\n";
+	}else if(!lastSeq){
+		//告知客户端当前事件序号，以便断线后从此处恢复
+		printer << "id: " << curSeq << "\nevent: ready\ndata: {\"seq\":" << curSeq << "}\n\n";
+	}else{
+		for(auto &event : replay){
+			printer << event->toEventStream();
+		}
+	}
+	send(printer);
+}
+
 void HttpSession::onWrite(const Buffer::Ptr &buffer) {
 	_ticker.resetTime();
 	_ui64TotalBytes += buffer->size();
 	send(buffer);
 }
 
+void HttpSession::onWrite(const vector<Buffer::Ptr> &data) {
+	_ticker.resetTime();
+	vector<Buffer::Ptr> buffers(data);
+	for(auto &buffer : buffers){
+		_ui64TotalBytes += buffer->size();
+	}
+	if(!isSocketBusy()){
+		//发送队列为空时直接通过sendmsg聚集写，gop缓存不拷贝
+		TcpGatherSender::send(_sock->rawFD(), kSockFlags, buffers);
+	}
+	//剩余数据直接引用放入发送队列，等待socket可写
+	for(auto &buffer : buffers){
+		send(buffer);
+	}
+}
+
 void HttpSession::onDetach() {
 	shutdown(SockException(Err_shutdown,"rtmp ring buffer detached"));
 }
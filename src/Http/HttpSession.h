@@ -67,9 +67,17 @@ public:
 	virtual void onManager() override;
 
 	static string urlDecode(const string &str);
+
+	/**
+	 * 把本连接切换成Server-Sent Events事件流，持续推送服务器事件
+	 * 必须在本连接所在线程调用，例如在kBroadcastHttpRequest事件中调用
+	 * @param lastSeq 客户端最后收到的事件序号，0代表只接收新事件
+	 */
+	void startEventStream(uint64_t lastSeq);
 protected:
 	//FlvMuxer override
 	void onWrite(const Buffer::Ptr &data) override ;
+	void onWrite(const vector<Buffer::Ptr> &data) override ;
 	void onDetach() override;
 	std::shared_ptr<FlvMuxer> getSharedPtr() override;
 	//HttpRequestSplitter override
@@ -148,6 +156,8 @@ private:
     MediaInfo _mediaInfo;
     //处理content数据的callback
     function<bool (const char *data,uint64_t len) > _contentCallBack;
+    //是否为事件流连接
+    bool _eventStream = false;
 };
 
 
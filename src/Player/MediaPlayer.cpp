@@ -47,6 +47,7 @@ void MediaPlayer::play(const string &strUrl) {
 	_parser->setOnPlayResult(_playResultCB);
     _parser->setOnResume(_resumeCB);
     _parser->setMediaSouce(_pMediaSrc);
+    _parser->setRtcpStats(_rtcpStats);
 	_parser->mINI::operator=(*this);
 	_parser->play(strUrl);
 }
@@ -67,5 +68,22 @@ void MediaPlayer::teardown() {
 	}
 }
 
+void MediaPlayer::setMediaStats(const MediaStats::Ptr &stats) {
+	if (_parser) {
+		_parser->setMediaStats(stats);
+	}
+}
+
+void MediaPlayer::setRtcpStats(const RtcpStats::Ptr &stats) {
+	_rtcpStats = stats;
+	if (_parser) {
+		_parser->setRtcpStats(stats);
+	}
+}
+
+RtcpStats::Ptr MediaPlayer::getRtcpStats() const {
+	return _rtcpStats;
+}
+
 
 } /* namespace mediakit */
@@ -47,8 +47,18 @@ public:
 	void pause(bool bPause) override;
 	void teardown() override;
 	EventPoller::Ptr getPoller();
+	void setMediaStats(const MediaStats::Ptr &stats) override;
+	/**
+	 * 设置rtcp统计，重新播放时沿用同一个统计对象
+	 */
+	void setRtcpStats(const RtcpStats::Ptr &stats) override;
+	/**
+	 * 获取rtcp统计，没有设置时返回空
+	 */
+	RtcpStats::Ptr getRtcpStats() const;
 private:
 	EventPoller::Ptr _poller;
+	RtcpStats::Ptr _rtcpStats;
 };
 
 } /* namespace mediakit */
@@ -35,6 +35,7 @@
 #include "Util/mini.h"
 #include "Util/RingBuffer.h"
 #include "Common/MediaSource.h"
+#include "Rtsp/RtcpStats.h"
 #include "Extension/Frame.h"
 #include "Extension/Track.h"
 using namespace toolkit;
@@ -150,6 +151,18 @@ public:
      * @return
      */
 	virtual float getPacketLossRate(TrackType trackType) const {return 0; }
+
+    /**
+     * 设置实时统计，用于统计丢包等传输层信息，只支持rtsp
+     * @param stats 统计对象
+     */
+    virtual void setMediaStats(const MediaStats::Ptr &stats) {}
+
+    /**
+     * 设置rtcp统计，用于统计发送给服务器的RR，只支持rtsp
+     * @param stats 统计对象
+     */
+    virtual void setRtcpStats(const RtcpStats::Ptr &stats) {}
 protected:
     virtual void onShutdown(const SockException &ex) {}
     virtual void onPlayResult(const SockException &ex) {}
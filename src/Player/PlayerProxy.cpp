@@ -75,6 +75,8 @@ PlayerProxy::PlayerProxy(const string &strVhost,
     _bEnableHls = bEnableHls;
     _bEnableMp4 = bEnableMp4;
     _iRetryCount = iRetryCount;
+    //rtsp拉流时统计发送给服务器的RR
+    setRtcpStats(std::make_shared<RtcpStats>());
 }
 
 void PlayerProxy::setPlayCallbackOnce(const function<void(const SockException &ex)> &cb){
@@ -199,6 +201,8 @@ private:
 void PlayerProxy::onPlaySuccess() {
 	_mediaMuxer.reset(new MultiMediaSourceMuxer(_strVhost,_strApp,_strSrc,getDuration(),_bEnableHls,_bEnableMp4));
 	_mediaMuxer->setListener(shared_from_this());
+	//rtsp拉流时统计丢包与排序缓存深度
+	setMediaStats(_mediaMuxer->getStats());
 
 	auto videoTrack = getTrack(TrackVideo,false);
 	if(videoTrack){
@@ -55,10 +55,24 @@ void FlvMuxer::start(const EventPoller::Ptr &poller,const RtmpMediaSource::Ptr &
         return;
     }
 
+    //flv头、config帧与gop缓存合并为一次写操作
+    _batch_write = true;
     onWriteFlvHeader(media);
 
+    vector<RtmpPacket::Ptr> gop_cache;
+    _ring_reader = media->attach(poller, true, gop_cache);
+    _gop_filter.reset(gop_cache);
+    for (auto &pkt : gop_cache) {
+        onWriteRtmp(pkt);
+    }
+    _batch_write = false;
+    if (!_batch_buf.empty()) {
+        vector<Buffer::Ptr> batch;
+        batch.swap(_batch_buf);
+        onWrite(batch);
+    }
+
     std::weak_ptr<FlvMuxer> weakSelf = getSharedPtr();
-    _ring_reader = media->getRing()->attach(poller);
     _ring_reader->setDetachCB([weakSelf](){
         auto strongSelf = weakSelf.lock();
         if(!strongSelf){
@@ -71,6 +85,10 @@ void FlvMuxer::start(const EventPoller::Ptr &poller,const RtmpMediaSource::Ptr &
         if(!strongSelf){
             return;
         }
+        if(strongSelf->_gop_filter.filter(pkt)){
+            //已经通过gop缓存发送过
+            return;
+        }
         strongSelf->onWriteRtmp(pkt);
     });
 }
@@ -102,11 +120,11 @@ void FlvMuxer::onWriteFlvHeader(const RtmpMediaSource::Ptr &mediaSrc) {
     }
 
     //flv header
-    onWrite(std::make_shared<BufferRaw>(flv_file_header, sizeof(flv_file_header) - 1));
+    writeBuffer(std::make_shared<BufferRaw>(flv_file_header, sizeof(flv_file_header) - 1));
 
     auto size = htonl(0);
     //PreviousTagSize0 Always 0
-    onWrite(std::make_shared<BufferRaw>((char *)&size,4));
+    writeBuffer(std::make_shared<BufferRaw>((char *)&size,4));
 
     //metadata
     AMFEncoder invoke;
@@ -149,12 +167,12 @@ void FlvMuxer::onWriteFlvTag(uint8_t ui8Type, const Buffer::Ptr &buffer, uint32_
     header.timestamp_ex = (uint8_t) ((ui32TimeStamp >> 24) & 0xff);
     set_be24(header.timestamp,ui32TimeStamp & 0xFFFFFF);
     //tag header
-    onWrite(std::make_shared<BufferRaw>((char *)&header, sizeof(header)));
+    writeBuffer(std::make_shared<BufferRaw>((char *)&header, sizeof(header)));
     //tag data
-    onWrite(buffer);
+    writeBuffer(buffer);
     auto size = htonl((buffer->size() + sizeof(header)));
     //PreviousTagSize
-    onWrite(std::make_shared<BufferRaw>((char *)&size,4));
+    writeBuffer(std::make_shared<BufferRaw>((char *)&size,4));
 }
 
 void FlvMuxer::onWriteRtmp(const RtmpPacket::Ptr &pkt) {
@@ -174,6 +192,21 @@ void FlvMuxer::onWriteRtmp(const RtmpPacket::Ptr &pkt) {
     onWriteFlvTag(pkt, modifiedStamp);
 }
 
+void FlvMuxer::writeBuffer(const Buffer::Ptr &data) {
+    if(_batch_write){
+        //批量写模式，先缓存数据的引用
+        _batch_buf.emplace_back(data);
+        return;
+    }
+    onWrite(data);
+}
+
+void FlvMuxer::onWrite(const vector<Buffer::Ptr> &data) {
+    for (auto &buffer : data) {
+        onWrite(buffer);
+    }
+}
+
 void FlvMuxer::stop() {
     if(_ring_reader){
         _ring_reader.reset();
@@ -43,6 +43,10 @@ public:
 protected:
     void start(const EventPoller::Ptr &poller,const RtmpMediaSource::Ptr &media);
     virtual void onWrite(const Buffer::Ptr &data) = 0;
+    /**
+     * 一次写入多个缓存，开始播放时的flv头、config帧与gop缓存通过此接口输出，默认逐个写入
+     */
+    virtual void onWrite(const vector<Buffer::Ptr> &data);
     virtual void onDetach() = 0;
     virtual std::shared_ptr<FlvMuxer> getSharedPtr() = 0;
 private:
@@ -50,9 +54,15 @@ private:
     void onWriteRtmp(const RtmpPacket::Ptr &pkt);
     void onWriteFlvTag(const RtmpPacket::Ptr &pkt, uint32_t ui32TimeStamp);
     void onWriteFlvTag(uint8_t ui8Type, const Buffer::Ptr &buffer, uint32_t ui32TimeStamp);
+    void writeBuffer(const Buffer::Ptr &data);
 private:
     RtmpMediaSource::RingType::RingReader::Ptr _ring_reader;
     uint32_t _aui32FirstStamp[2] = {0};
+    //过滤环形缓存重复派发的gop缓存数据
+    GopCacheFilter<RtmpPacket::Ptr> _gop_filter;
+    //开始播放时flv头、config帧与gop缓存合并为一次写操作，只缓存引用
+    bool _batch_write = false;
+    vector<Buffer::Ptr> _batch_buf;
 
 };
 
@@ -27,6 +27,65 @@
 #include "Extension/Factory.h"
 namespace mediakit{
 
+//每个包最多缓存的切片组合个数，超过后由调用者直接引用消息体分块发送
+#define CHUNK_CACHE_MAX 4
+
+Buffer::Ptr RtmpPacket::getChunkedBody(size_t chunkSize, int iChunkId) const {
+    auto cache = std::atomic_load(&_chunkCache);
+    if (cache) {
+        for (auto &item : *cache) {
+            if (item.chunkSize == chunkSize && item.chunkId == iChunkId) {
+                return item.body;
+            }
+        }
+        if (cache->size() >= CHUNK_CACHE_MAX) {
+            return nullptr;
+        }
+    }
+    //每个块之后(最后一个除外)插入一个字节的type-3块头
+    size_t chunkCount = strBuf.empty() ? 0 : (strBuf.size() - 1) / chunkSize;
+    auto body = std::make_shared<BufferRaw>(strBuf.size() + chunkCount);
+    body->setSize(strBuf.size() + chunkCount);
+    char *dst = body->data();
+    size_t offset = 0;
+    while (offset < strBuf.size()) {
+        if (offset) {
+            *(dst++) = (iChunkId & 0x3f) | (3 << 6);
+        }
+        size_t chunk = MIN(chunkSize, strBuf.size() - offset);
+        memcpy(dst, strBuf.data() + offset, chunk);
+        dst += chunk;
+        offset += chunk;
+    }
+    ChunkCache item;
+    item.chunkSize = chunkSize;
+    item.chunkId = iChunkId;
+    //切片缓存随该包一起释放，统计其内存占用
+    item.body = body;
+    //写时复制，多个线程同时追加时重试；同一组合被其他线程抢先生成时直接使用其结果
+    while (true) {
+        auto list = cache ? std::make_shared<ChunkCacheList>(*cache) : std::make_shared<ChunkCacheList>();
+        if (list->size() >= CHUNK_CACHE_MAX) {
+            break;
+        }
+        list->emplace_back(item);
+        std::shared_ptr<const ChunkCacheList> desired = list;
+        if (std::atomic_compare_exchange_strong(&_chunkCache, &cache, desired)) {
+            if (_memoryCounter) {
+                _countedBytes += body->size();
+                _memoryCounter->add(body->size());
+            }
+            break;
+        }
+        for (auto &other : *cache) {
+            if (other.chunkSize == chunkSize && other.chunkId == iChunkId) {
+                return other.body;
+            }
+        }
+    }
+    return item.body;
+}
+
 VideoMete::VideoMete(const VideoTrack::Ptr &video,int datarate ){
     if(video->getVideoWidth() > 0 ){
         _metedata.set("width", video->getVideoWidth());
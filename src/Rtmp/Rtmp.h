@@ -35,6 +35,7 @@
 #include "Network/sockutil.h"
 #include "amf.h"
 #include "Extension/Track.h"
+#include "Common/MemoryCounter.h"
 
 using namespace toolkit;
 
@@ -153,21 +154,67 @@ public:
     };
 public:
     RtmpPacket() = default;
-    RtmpPacket(const RtmpPacket &that) = default;
-    RtmpPacket &operator=(const RtmpPacket &that) = default;
-    RtmpPacket &operator=(RtmpPacket &&that) = default;
-
-    RtmpPacket(RtmpPacket &&that){
-        typeId = that.typeId;
-        bodySize = that.bodySize;
-        timeStamp = that.timeStamp;
-        hasAbsStamp = that.hasAbsStamp;
-        hasExtStamp = that.hasExtStamp;
-        deltaStamp = that.deltaStamp;
-        streamId = that.streamId;
-        chunkId = that.chunkId;
+    ~RtmpPacket() {
+        setMemoryCounter(nullptr);
+    }
+    //内存统计与切片缓存属于原对象，拷贝与移动时不转移
+    RtmpPacket(const RtmpPacket &that) {
+        assignHeader(that);
+        strBuf = that.strBuf;
+    }
+    RtmpPacket(RtmpPacket &&that) {
+        assignHeader(that);
         strBuf = std::move(that.strBuf);
     }
+    RtmpPacket &operator=(const RtmpPacket &that) {
+        assignHeader(that);
+        strBuf = that.strBuf;
+        return *this;
+    }
+    RtmpPacket &operator=(RtmpPacket &&that) {
+        assignHeader(that);
+        strBuf = std::move(that.strBuf);
+        return *this;
+    }
+
+    /**
+     * 获取按块大小切片后的消息体，即第一个块的消息头之后的所有数据(各块负载以及块之间的1字节type-3块头)
+     * 该数据与播放器无关，块大小与块流ID相同的播放器共用同一份，首次调用时生成，可在多个线程中同时调用
+     * 只适用于不带扩展时间戳的消息，且块流ID须小于64
+     * @param chunkSize 输出块大小
+     * @param iChunkId 块流ID
+     * @return 缓存的组合已满时返回空，调用者须直接引用消息体分块发送
+     */
+    Buffer::Ptr getChunkedBody(size_t chunkSize, int iChunkId) const;
+
+    /**
+     * 清除切片缓存，循环池中的对象复用前或者修改strBuf后必须调用
+     */
+    void clearChunkCache() {
+        auto cache = std::atomic_exchange(&_chunkCache, std::shared_ptr<const ChunkCacheList>());
+        if (!cache || !_memoryCounter) {
+            return;
+        }
+        for (auto &item : *cache) {
+            _countedBytes -= item.body->size();
+            _memoryCounter->add(-(int64_t) item.body->size());
+        }
+    }
+
+    /**
+     * 设置内存统计，统计消息体以及之后生成的切片缓存，本对象销毁或者改为统计到其他计数器时扣除
+     * 在写入媒体源时(分发之前)设置，循环池中的对象在复用前一直计入原计数器
+     */
+    void setMemoryCounter(const MemoryCounter::Ptr &counter) {
+        if (_memoryCounter) {
+            _memoryCounter->add(-(int64_t) _countedBytes.load());
+        }
+        _memoryCounter = counter;
+        _countedBytes = counter ? strBuf.size() : 0;
+        if (_memoryCounter) {
+            _memoryCounter->add(_countedBytes.load());
+        }
+    }
     bool isVideoKeyFrame() const {
         return typeId == MSG_VIDEO && (uint8_t) strBuf[0] >> 4 == FLV_KEY_FRAME
         && (uint8_t) strBuf[1] == 1;
@@ -293,6 +340,31 @@ public:
         ret = strBuf.substr(2, 2);
         return ret;
     }
+private:
+    class ChunkCache {
+    public:
+        size_t chunkSize;
+        int chunkId;
+        Buffer::Ptr body;
+    };
+    typedef vector<ChunkCache> ChunkCacheList;
+    //切片缓存，按块大小与块流ID组合缓存，通常所有播放器都相同，组合个数有上限
+    mutable std::shared_ptr<const ChunkCacheList> _chunkCache;
+    void assignHeader(const RtmpPacket &that) {
+        typeId = that.typeId;
+        bodySize = that.bodySize;
+        timeStamp = that.timeStamp;
+        hasAbsStamp = that.hasAbsStamp;
+        hasExtStamp = that.hasExtStamp;
+        deltaStamp = that.deltaStamp;
+        streamId = that.streamId;
+        chunkId = that.chunkId;
+    }
+private:
+    //内存统计
+    MemoryCounter::Ptr _memoryCounter;
+    //已经计入_memoryCounter的字节数，切片缓存可能在多个线程中生成
+    mutable atomic<uint32_t> _countedBytes{0};
 };
 
 
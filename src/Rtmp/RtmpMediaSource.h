@@ -37,6 +37,7 @@
 #include "RtmpDemuxer.h"
 #include "Common/config.h"
 #include "Common/MediaSource.h"
+#include "Common/GopCache.h"
 #include "Util/util.h"
 #include "Util/logger.h"
 #include "Util/RingBuffer.h"
@@ -71,6 +72,46 @@ public:
         return _pRing ? _pRing->readerCount() : 0;
 	}
 
+	/**
+	 * 创建环形缓存读取器，开启gop缓存时同时返回gop缓存
+	 * 开启gop缓存时读取器不再使用环形缓存内的数据，调用者应先发送gop缓存，再用GopCacheFilter过滤重复的包
+	 * 先创建读取器再拷贝gop缓存，保证拷贝之后写入的包都能被该读取器收到；
+	 * 与onWrite持有同一把锁，保证创建读取器与拷贝gop缓存之间不会写入新的包
+	 * @param poller 读取器所在线程，必须为当前线程
+	 * @param useBuf 是否需要之前缓存的数据
+	 * @param gop 返回gop缓存
+	 */
+	RingType::RingReader::Ptr attach(const EventPoller::Ptr &poller, bool useBuf, vector<RtmpPacket::Ptr> &gop) {
+		bool useGop = useBuf && GopCache<RtmpPacket::Ptr>::enabled();
+		lock_guard<recursive_mutex> lock(_mtxMap);
+		auto reader = _pRing->attach(poller, useBuf && !useGop);
+		if (useGop) {
+			getGopCache(gop);
+		}
+		return reader;
+	}
+
+	/**
+	 * 获取gop缓存的拷贝
+	 */
+	void getGopCache(vector<RtmpPacket::Ptr> &gop) {
+		lock_guard<recursive_mutex> lock(_mtxMap);
+		_gopCache.getCache(gop);
+	}
+
+	uint64_t getGopCacheBytes() override {
+		lock_guard<recursive_mutex> lock(_mtxMap);
+		return _gopCache.getBytes();
+	}
+
+	/**
+	 * 清空gop缓存，在停止写入数据时调用，防止新的播放器收到过期的gop
+	 */
+	void clearGopCache() {
+		lock_guard<recursive_mutex> lock(_mtxMap);
+		_gopCache.clear();
+	}
+
 	const AMFValue &getMetaData() const {
 		lock_guard<recursive_mutex> lock(_mtxMap);
 		return _metadata;
@@ -89,6 +130,9 @@ public:
 	}
 
     void onWrite(const RtmpPacket::Ptr &pkt,bool isKey = true) override {
+		//循环池中复用的包可能残留上次的切片缓存
+		pkt->clearChunkCache();
+		pkt->setMemoryCounter(_memoryCounter);
 		lock_guard<recursive_mutex> lock(_mtxMap);
 		if (pkt->isCfgFrame()) {
 			_mapCfgFrame[pkt->typeId] = pkt;
@@ -99,16 +143,19 @@ public:
 
         if(!_pRing){
             weak_ptr<RtmpMediaSource> weakSelf = dynamic_pointer_cast<RtmpMediaSource>(shared_from_this());
-            _pRing = std::make_shared<RingType>(_ringSize,[weakSelf](const EventPoller::Ptr &,int size,bool){
+            _pRing = std::make_shared<RingType>(_ringSize,[weakSelf](const EventPoller::Ptr &poller,int size,bool){
                 auto strongSelf = weakSelf.lock();
                 if(!strongSelf){
                     return;
                 }
+                //size为该线程上的观看者个数，环形缓存按线程分发，每个线程一个分发器
+                strongSelf->onPollerReaderChanged(poller,size);
                 strongSelf->onReaderChanged(size);
             });
             onReaderChanged(0);
             regist();
         }
+        _gopCache.input(pkt,pkt->isVideoKeyFrame());
         _pRing->write(pkt,pkt->isVideoKeyFrame());
         checkNoneReader();
     }
@@ -153,6 +200,7 @@ protected:
 	int _ringSize;
 	Ticker _readerTicker;
     bool _asyncEmitNoneReader = false;
+    GopCache<RtmpPacket::Ptr> _gopCache;
 };
 
 } /* namespace mediakit */
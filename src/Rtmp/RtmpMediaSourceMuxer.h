@@ -51,6 +51,21 @@ public:
     int readerCount() const{
         return _mediaSouce->readerCount();
     }
+    void setStats(const MediaStats::Ptr &stats){
+        _mediaSouce->setStats(stats);
+    }
+    /**
+     * 媒体源是否已经开始写入数据(开始写入后才会注册)
+     */
+    bool isStarted() const{
+        return (bool)_mediaSouce->getRing();
+    }
+    /**
+     * 暂停打包时清空缓存
+     */
+    void clearCache(){
+        _mediaSouce->clearGopCache();
+    }
 private:
     void onAllTrackReady() override {
         _mediaSouce->onGetMetaData(getMetedata());
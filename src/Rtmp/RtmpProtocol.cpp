@@ -23,6 +23,7 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  */
+#include <atomic>
 #include "RtmpProtocol.h"
 #include "Rtmp/utils.h"
 #include "Util/util.h"
@@ -211,11 +212,16 @@ private:
 
 void RtmpProtocol::sendRtmp(uint8_t ui8Type, uint32_t ui32StreamId,
                             const std::string& strBuf, uint32_t ui32TimeStamp, int iChunkId) {
-    sendRtmp(ui8Type,ui32StreamId,std::make_shared<BufferString>(strBuf),ui32TimeStamp,iChunkId);
+    sendRtmp(ui8Type,ui32StreamId,obtainBuffer(strBuf.data(),strBuf.size()),ui32TimeStamp,iChunkId);
 }
 
 void RtmpProtocol::sendRtmp(uint8_t ui8Type, uint32_t ui32StreamId,
         const Buffer::Ptr &buf, uint32_t ui32TimeStamp, int iChunkId){
+    sendRtmp(ui8Type, ui32StreamId, vector<Buffer::Ptr>{buf}, ui32TimeStamp, iChunkId);
+}
+
+void RtmpProtocol::sendRtmp(uint8_t ui8Type, uint32_t ui32StreamId,
+        const vector<Buffer::Ptr> &body, uint32_t ui32TimeStamp, int iChunkId){
     if (iChunkId < 2 || iChunkId > 63) {
         auto strErr = StrPrinter << "不支持发送该类型的块流 ID:" << iChunkId << endl;
         throw std::runtime_error(strErr);
@@ -223,19 +229,12 @@ void RtmpProtocol::sendRtmp(uint8_t ui8Type, uint32_t ui32StreamId,
 	//是否有扩展时间戳
     bool bExtStamp = ui32TimeStamp >= 0xFFFFFF;
 
-    //rtmp头
-	BufferRaw::Ptr bufferHeader = obtainBuffer();
-	bufferHeader->setCapacity(sizeof(RtmpHeader));
-	bufferHeader->setSize(sizeof(RtmpHeader));
-	//对rtmp头赋值，如果使用整形赋值，在arm android上可能由于数据对齐导致总线错误的问题
-	RtmpHeader *header = (RtmpHeader*) bufferHeader->data();
-    header->flags = (iChunkId & 0x3f) | (0 << 6);
-    header->typeId = ui8Type;
-    set_be24(header->timeStamp, bExtStamp ? 0xFFFFFF : ui32TimeStamp);
-    set_be24(header->bodySize, buf->size());
-    set_le32(header->streamId, ui32StreamId);
+    uint32_t bodySize = 0;
+    for (auto &buf : body) {
+        bodySize += buf->size();
+    }
     //发送rtmp头
-    onSendRawData(bufferHeader);
+    onSendRawData(makeRtmpHeader(ui8Type, ui32StreamId, bodySize, ui32TimeStamp, iChunkId));
 
     //扩展时间戳字段
 	BufferRaw::Ptr bufferExtStamp;
@@ -253,24 +252,73 @@ void RtmpProtocol::sendRtmp(uint8_t ui8Type, uint32_t ui32StreamId,
 	bufferFlags->setSize(1);
 	bufferFlags->data()[0] = (iChunkId & 0x3f) | (3 << 6);
     
-    size_t offset = 0;
 	uint32_t totalSize = sizeof(RtmpHeader);
-    while (offset < buf->size()) {
-        if (offset) {
-            onSendRawData(bufferFlags);
-            totalSize += 1;
-        }
-        if (bExtStamp) {
-            //扩展时间戳
-            onSendRawData(bufferExtStamp);
-            totalSize += 4;
+    //当前块剩余的字节数，块的边界与各段数据的边界无关
+    size_t chunkLeft = 0;
+    bool firstChunk = true;
+    for (auto &buf : body) {
+        size_t offset = 0;
+        while (offset < buf->size()) {
+            if (!chunkLeft) {
+                if (!firstChunk) {
+                    onSendRawData(bufferFlags);
+                    totalSize += 1;
+                }
+                if (bExtStamp) {
+                    //扩展时间戳
+                    onSendRawData(bufferExtStamp);
+                    totalSize += 4;
+                }
+                firstChunk = false;
+                chunkLeft = _iChunkLenOut;
+            }
+            size_t chunk = min(chunkLeft, buf->size() - offset);
+            if (chunk == buf->size()) {
+                //整段数据在同一个块内，直接发送
+                onSendRawData(buf);
+            } else {
+                onSendRawData(std::make_shared<BufferPartial>(buf, offset, chunk));
+            }
+            totalSize += chunk;
+            offset += chunk;
+            chunkLeft -= chunk;
         }
-        size_t chunk = min(_iChunkLenOut, buf->size() - offset);
-        onSendRawData(std::make_shared<BufferPartial>(buf,offset,chunk));
-        totalSize += chunk;
-        offset += chunk;
     }
-    _ui32ByteSent += totalSize;
+    onSendBytes(totalSize);
+}
+
+void RtmpProtocol::sendRtmp(const RtmpPacket::Ptr &pkt, uint32_t ui32StreamId, uint32_t ui32TimeStamp) {
+    //只有一个块时直接发送该包
+    Buffer::Ptr body;
+    if (ui32TimeStamp < 0xFFFFFF && pkt->chunkId >= 2 && pkt->chunkId <= 63) {
+        body = pkt->size() <= _iChunkLenOut ? pkt : pkt->getChunkedBody(_iChunkLenOut, pkt->chunkId);
+    }
+    if (!body) {
+        //扩展时间戳在每个块中都要重复，无法共用切片；切片缓存组合已满时也直接引用消息体分块发送
+        sendRtmp(pkt->typeId, ui32StreamId, pkt, ui32TimeStamp, pkt->chunkId);
+        return;
+    }
+    onSendRawData(makeRtmpHeader(pkt->typeId, ui32StreamId, pkt->size(), ui32TimeStamp, pkt->chunkId));
+    onSendRawData(body);
+    onSendBytes(sizeof(RtmpHeader) + body->size());
+}
+
+BufferRaw::Ptr RtmpProtocol::makeRtmpHeader(uint8_t ui8Type, uint32_t ui32StreamId, uint32_t ui32BodySize, uint32_t ui32TimeStamp, int iChunkId) {
+    BufferRaw::Ptr bufferHeader = obtainBuffer();
+    bufferHeader->setCapacity(sizeof(RtmpHeader));
+    bufferHeader->setSize(sizeof(RtmpHeader));
+    //对rtmp头赋值，如果使用整形赋值，在arm android上可能由于数据对齐导致总线错误的问题
+    RtmpHeader *header = (RtmpHeader*) bufferHeader->data();
+    header->flags = (iChunkId & 0x3f) | (0 << 6);
+    header->typeId = ui8Type;
+    set_be24(header->timeStamp, ui32TimeStamp >= 0xFFFFFF ? 0xFFFFFF : ui32TimeStamp);
+    set_be24(header->bodySize, ui32BodySize);
+    set_le32(header->streamId, ui32StreamId);
+    return bufferHeader;
+}
+
+void RtmpProtocol::onSendBytes(uint32_t ui32Bytes) {
+    _ui32ByteSent += ui32Bytes;
     if (_ui32WinSize > 0 && _ui32ByteSent - _ui32LastSent >= _ui32WinSize) {
         _ui32LastSent = _ui32ByteSent;
         sendAcknowledgement(_ui32ByteSent);
@@ -777,8 +825,52 @@ void RtmpProtocol::handle_rtmpChunk(RtmpPacket& chunkData) {
 		}
 }
 
+/**
+ * 线程私有的小内存池
+ * 只复用仅被池子自己引用的buffer，socket发送队列中仍在引用的buffer不会被改写；
+ * 按分配顺序依次检查，发送队列也是先进先出释放，通常第一个就能复用，
+ * 连续多个都在使用中时(发送中的buffer比池子多)扩容，池子满后临时分配；
+ * 曾经用于较大数据(例如metadata)的buffer复用时替换为新的buffer，防止池子长期占用大块内存
+ */
+class RtmpBufferPool {
+public:
+    static RtmpBufferPool &Instance() {
+        static thread_local RtmpBufferPool s_pool;
+        return s_pool;
+    }
+
+    BufferRaw::Ptr obtain() {
+        auto probe = MIN(_buffers.size(), (size_t) kMaxProbe);
+        for (size_t i = 0; i < probe; ++i) {
+            auto &buffer = _buffers[_pos];
+            _pos = (_pos + 1) % _buffers.size();
+            if (buffer.use_count() == 1) {
+                //可能由其他线程释放，须保证其释放前的读操作先于本线程的改写
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (buffer->size() > kMaxKeepSize) {
+                    buffer = std::make_shared<BufferRaw>();
+                }
+                return buffer;
+            }
+        }
+        auto ret = std::make_shared<BufferRaw>();
+        if (_buffers.size() < kMaxPoolSize) {
+            _buffers.emplace_back(ret);
+        }
+        return ret;
+    }
+
+private:
+    static const size_t kMaxPoolSize = 16 * 1024;
+    static const int kMaxProbe = 8;
+    //复用时保留的最大数据长度，rtmp头、控制消息等都远小于该值
+    static const uint32_t kMaxKeepSize = 4 * 1024;
+    vector<BufferRaw::Ptr> _buffers;
+    size_t _pos = 0;
+};
+
 BufferRaw::Ptr RtmpProtocol::obtainBuffer() {
-    return std::make_shared<BufferRaw>() ;//_bufferPool.obtain();
+    return RtmpBufferPool::Instance().obtain();
 }
 
 BufferRaw::Ptr RtmpProtocol::obtainBuffer(const void *data, int len) {
@@ -75,15 +75,29 @@ protected:
 	void sendResponse(int iType, const string &str);
 	void sendRtmp(uint8_t ui8Type, uint32_t ui32StreamId, const std::string &strBuf, uint32_t ui32TimeStamp, int iChunkID);
 	void sendRtmp(uint8_t ui8Type, uint32_t ui32StreamId, const Buffer::Ptr &buffer, uint32_t ui32TimeStamp, int iChunkID);
+	/**
+	 * 发送由多段数据依次拼接而成的消息体，各段数据不拷贝，切片时直接引用
+	 * @param body 消息体的各段数据
+	 */
+	void sendRtmp(uint8_t ui8Type, uint32_t ui32StreamId, const vector<Buffer::Ptr> &body, uint32_t ui32TimeStamp, int iChunkID);
+	/**
+	 * 发送媒体包，只有消息头为每个播放器单独生成，切片后的消息体由所有播放器共用
+	 * @param pkt 媒体包，使用其typeId与chunkId
+	 * @param ui32StreamId 消息流ID
+	 * @param ui32TimeStamp 该播放器的时间戳
+	 */
+	void sendRtmp(const RtmpPacket::Ptr &pkt, uint32_t ui32StreamId, uint32_t ui32TimeStamp);
 protected:
 	int _iReqID = 0;
 	uint32_t _ui32StreamId = STREAM_CONTROL;
 	int _iNowStreamID = 0;
 	int _iNowChunkID = 0;
 	bool _bDataStarted = false;
-	inline BufferRaw::Ptr obtainBuffer();
-	inline BufferRaw::Ptr obtainBuffer(const void *data, int len);
-	//ResourcePool<BufferRaw,MAX_SEND_PKT> _bufferPool;
+	/**
+	 * 从本线程的小内存池获取buffer，用于rtmp头、块头、控制消息等
+	 */
+	BufferRaw::Ptr obtainBuffer();
+	BufferRaw::Ptr obtainBuffer(const void *data, int len);
 private:
 	void handle_S0S1S2(const function<void()> &cb);
 	void handle_C0C1();
@@ -99,6 +113,8 @@ private:
 	void handle_C2();
 	void handle_rtmp();
 	void handle_rtmpChunk(RtmpPacket &chunkData);
+	BufferRaw::Ptr makeRtmpHeader(uint8_t ui8Type, uint32_t ui32StreamId, uint32_t ui32BodySize, uint32_t ui32TimeStamp, int iChunkId);
+	void onSendBytes(uint32_t ui32Bytes);
 
 private:
 	////////////ChunkSize////////////
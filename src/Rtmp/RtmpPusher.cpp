@@ -210,7 +210,7 @@ inline void RtmpPusher::send_metaData(){
     sendRequest(MSG_DATA, enc.data());
     
     src->getConfigFrame([&](const RtmpPacket::Ptr &pkt){
-        sendRtmp(pkt->typeId, _ui32StreamId, pkt, pkt->timeStamp, pkt->chunkId );
+        sendRtmp(pkt, _ui32StreamId, pkt->timeStamp);
     });
     
     _pRtmpReader = src->getRing()->attach(getPoller());
@@ -220,7 +220,7 @@ inline void RtmpPusher::send_metaData(){
     	if(!strongSelf) {
     		return;
     	}
-    	strongSelf->sendRtmp(pkt->typeId, strongSelf->_ui32StreamId, pkt, pkt->timeStamp, pkt->chunkId);
+    	strongSelf->sendRtmp(pkt, strongSelf->_ui32StreamId, pkt->timeStamp);
     });
     _pRtmpReader->setDetachCB([weakSelf](){
         auto strongSelf = weakSelf.lock();
@@ -27,6 +27,8 @@
 
 #include "RtmpSession.h"
 #include "Common/config.h"
+#include "Common/MemoryCounter.h"
+#include "Common/TcpGatherSender.h"
 #include "Util/onceToken.h"
 
 namespace mediakit {
@@ -152,15 +154,30 @@ void RtmpSession::onCmd_publish(AMFDecoder &dec) {
                                                                            _mediaInfo._streamid,
                                                                            false));
         bool authSuccess = err.empty();
-        bool ok = (!src && !_pPublisherSrc && authSuccess);
+        bool nameFree = !src && !_pPublisherSrc;
+        //媒体数据内存超过预算，拒绝新的推流
+        bool overBudget = authSuccess && nameFree && MemoryCounter::isOverBudget();
+        bool ok = (nameFree && authSuccess && !overBudget);
+        string code = "NetStream.Publish.Start";
+        string description = "Started publishing stream.";
+        if (!authSuccess) {
+            code = "NetStream.Publish.BadAuth";
+            description = err;
+        } else if (!nameFree) {
+            code = "NetStream.Publish.BadName";
+            description = "Already publishing.";
+        } else if (overBudget) {
+            code = "NetStream.Publish.Failed";
+            description = "Media memory budget exceeded.";
+        }
         AMFValue status(AMF_OBJECT);
         status.set("level", ok ? "status" : "error");
-        status.set("code", ok ? "NetStream.Publish.Start" : (authSuccess ? "NetStream.Publish.BadName" : "NetStream.Publish.BadAuth"));
-        status.set("description", ok ? "Started publishing stream." : (authSuccess ? "Already publishing." : err.data()));
+        status.set("code", code);
+        status.set("description", description);
         status.set("clientid", "0");
         sendReply("onStatus", nullptr, status);
         if (!ok) {
-            string errMsg = StrPrinter << (authSuccess ? "already publishing:" : err.data()) << " "
+            string errMsg = StrPrinter << description << " "
                                     << _mediaInfo._vhost << " "
                                     << _mediaInfo._app << " "
                                     << _mediaInfo._streamid;
@@ -265,21 +282,48 @@ void RtmpSession::sendPlayResponse(const string &err,const RtmpMediaSource::Ptr
     invoke << "onMetaData" << src->getMetaData();
     sendResponse(MSG_DATA, invoke.data());
 
+    //config帧与gop缓存合并为一次写操作发送
+    beginBatchSend();
     src->getConfigFrame([&](const RtmpPacket::Ptr &pkt) {
         //DebugP(this)<<"send initial frame";
         onSendMedia(pkt);
     });
 
-    _pRingReader = src->getRing()->attach(getPoller());
+    vector<RtmpPacket::Ptr> gopCache;
+    _pRingReader = src->attach(getPoller(), true, gopCache);
+    _gopFilter.reset(gopCache);
+    for (auto &pkt : gopCache) {
+        onSendMedia(pkt);
+    }
+    endBatchSend();
+
     weak_ptr<RtmpSession> weakSelf = dynamic_pointer_cast<RtmpSession>(shared_from_this());
     SockUtil::setNoDelay(_sock->rawFD(), false);
+    //gop缓存已经合并发送，之后的音视频按需合并为聚合消息
+    _bAggregate = enableAggregate(_mediaInfo._vhost);
     _pRingReader->setReadCB([weakSelf](const RtmpPacket::Ptr &pkt) {
         auto strongSelf = weakSelf.lock();
         if (!strongSelf) {
             return;
         }
+        if (strongSelf->_gopFilter.filter(pkt)) {
+            //已经通过gop缓存发送过
+            return;
+        }
+        if (!strongSelf->checkSend(pkt->size(), strongSelf->isSocketBusy(), pkt->isVideoKeyFrame())) {
+            //播放器网络太慢，丢弃该包
+            return;
+        }
         strongSelf->onSendMedia(pkt);
     });
+    _sock->setOnFlush([weakSelf]() {
+        auto strongSelf = weakSelf.lock();
+        if (!strongSelf) {
+            return false;
+        }
+        strongSelf->onSocketFlushed();
+        return true;
+    });
     _pRingReader->setDetachCB([weakSelf]() {
         auto strongSelf = weakSelf.lock();
         if (!strongSelf) {
@@ -473,6 +517,32 @@ void RtmpSession::onCmd_seek(AMFDecoder &dec) {
 }
 
 void RtmpSession::onSendMedia(const RtmpPacket::Ptr &pkt) {
+	if (pkt->isVideoKeyFrame()) {
+		_lastKeyFrame = pkt;
+	}
+	if (_bAggregate && !_bBatchSend) {
+		if (_aggregatePending.empty()) {
+			//本线程周期结束后合并发送
+			weak_ptr<RtmpSession> weakSelf = dynamic_pointer_cast<RtmpSession>(shared_from_this());
+			getPoller()->async([weakSelf]() {
+				auto strongSelf = weakSelf.lock();
+				if (strongSelf) {
+					strongSelf->flushAggregate();
+				}
+			}, false);
+		}
+		_aggregatePending.emplace_back(pkt);
+		_aggregateBytes += pkt->size();
+		if (_aggregateBytes >= 512 * 1024) {
+			//限制聚合消息大小
+			flushAggregate();
+		}
+		return;
+	}
+	sendRtmp(pkt, pkt->streamId, getModifiedStamp(pkt));
+}
+
+uint32_t RtmpSession::getModifiedStamp(const RtmpPacket::Ptr &pkt) {
 	auto modifiedStamp = pkt->timeStamp;
 	auto &firstStamp = _aui32FirstStamp[pkt->typeId % 2];
 	if(!firstStamp){
@@ -486,9 +556,123 @@ void RtmpSession::onSendMedia(const RtmpPacket::Ptr &pkt) {
 		CLEAR_ARR(_aui32FirstStamp);
 		modifiedStamp = 0;
 	}
-	sendRtmp(pkt->typeId, pkt->streamId, pkt, modifiedStamp, pkt->chunkId);
+	return modifiedStamp;
 }
 
+void RtmpSession::flushAggregate() {
+	if (_aggregatePending.empty()) {
+		return;
+	}
+	if (_aggregatePending.size() == 1) {
+		auto &pkt = _aggregatePending.front();
+		sendRtmp(pkt, pkt->streamId, getModifiedStamp(pkt));
+	} else {
+		//每个子消息为11字节消息头 + 消息体 + 4字节的子消息长度(back pointer)
+		//消息头与back pointer取自小内存池，消息体直接引用媒体包，切片时不拷贝
+		vector<Buffer::Ptr> body;
+		body.reserve(3 * _aggregatePending.size());
+		uint32_t firstStamp = 0;
+		for (auto &pkt : _aggregatePending) {
+			auto stamp = getModifiedStamp(pkt);
+			if (body.empty()) {
+				firstStamp = stamp;
+			}
+			auto header = obtainBuffer();
+			header->setCapacity(11);
+			header->setSize(11);
+			auto ptr = header->data();
+			ptr[0] = pkt->typeId;
+			set_be24(ptr + 1, pkt->size());
+			set_be24(ptr + 4, stamp & 0xFFFFFF);
+			ptr[7] = stamp >> 24;
+			set_be24(ptr + 8, pkt->streamId);
+
+			auto backPointer = obtainBuffer();
+			backPointer->setCapacity(4);
+			backPointer->setSize(4);
+			set_be32(backPointer->data(), pkt->size() + 11);
+
+			body.emplace_back(std::move(header));
+			body.emplace_back(pkt);
+			body.emplace_back(std::move(backPointer));
+		}
+		//聚合消息的时间戳与块流ID取自第一个子消息，纯音频时使用音频块流
+		auto &front = _aggregatePending.front();
+		sendRtmp(MSG_AGGREGATE, front->streamId, body, firstStamp, front->typeId == MSG_AUDIO ? CHUNK_AUDIO : CHUNK_VIDEO);
+	}
+	_aggregatePending.clear();
+	_aggregateBytes = 0;
+}
+
+bool RtmpSession::enableAggregate(const string &vhost) {
+	GET_CONFIG(bool, aggregate, Rtmp::kAggregate);
+	GET_CONFIG(bool, enableVhost, General::kEnableVhost);
+	if (!enableVhost) {
+		return aggregate;
+	}
+	//与vhost同名配置段中的配置优先
+	auto &ini = mINI::Instance();
+	auto it = ini.find(vhost + "." + Rtmp::kAggregate);
+	if (it == ini.end()) {
+		return aggregate;
+	}
+	return it->second.as<bool>();
+}
+
+
+void RtmpSession::onSocketFlushed() {
+    if (!onSendFlushed()) {
+        return;
+    }
+    //发送缓存已经清空，从gop缓存恢复播放
+    vector<RtmpPacket::Ptr> gopCache;
+    bool haveVideo = false;
+    auto src = _pPlayerSrc.lock();
+    if (src) {
+        src->getGopCache(gopCache);
+        src->getConfigFrame([&](const RtmpPacket::Ptr &pkt) {
+            if (pkt->typeId == MSG_VIDEO) {
+                haveVideo = true;
+            }
+        });
+    }
+    if (!haveVideo || (!gopCache.empty() && gopCache.front() == _lastKeyFrame.lock())) {
+        //丢包发生在已发送的gop中间(或者纯音频没有关键帧)，重发gop缓存会导致重复的包以及时间戳回退
+        gopCache.clear();
+    }
+    _gopFilter.reset(gopCache);
+    //没有可重发的gop缓存时，有视频则等待下一个关键帧
+    resumeSend(gopCache.empty() && haveVideo);
+    InfoP(this) << "发送缓存已清空,恢复播放,重发gop缓存包数:" << gopCache.size();
+    beginBatchSend();
+    for (auto &pkt : gopCache) {
+        onSendMedia(pkt);
+    }
+    endBatchSend();
+}
+
+void RtmpSession::beginBatchSend() {
+    //先发送之前缓存的聚合消息，保证顺序
+    flushAggregate();
+    _bBatchSend = true;
+}
+
+void RtmpSession::endBatchSend() {
+    _bBatchSend = false;
+    if (_aBatchBuf.empty()) {
+        return;
+    }
+    vector<Buffer::Ptr> buffers;
+    buffers.swap(_aBatchBuf);
+    if (!isSocketBusy()) {
+        //发送队列为空时直接通过sendmsg聚集写，gop缓存不拷贝
+        TcpGatherSender::send(_sock->rawFD(), kSockFlags, buffers);
+    }
+    //剩余数据直接引用放入发送队列，等待socket可写
+    for (auto &buffer : buffers) {
+        send(buffer);
+    }
+}
 
 bool RtmpSession::close(MediaSource &sender,bool force)  {
     //此回调在其他线程触发
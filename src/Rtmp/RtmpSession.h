@@ -32,6 +32,7 @@
 #include "Rtmp.h"
 #include "utils.h"
 #include "Common/config.h"
+#include "Common/ReaderWatermark.h"
 #include "RtmpProtocol.h"
 #include "RtmpToRtspMediaSource.h"
 #include "Util/util.h"
@@ -41,7 +42,7 @@ using namespace toolkit;
 
 namespace mediakit {
 
-class RtmpSession: public TcpSession ,public  RtmpProtocol , public MediaSourceEvent{
+class RtmpSession: public TcpSession ,public  RtmpProtocol , public MediaSourceEvent , public ReaderWatermark{
 public:
 	typedef std::shared_ptr<RtmpSession> Ptr;
 	RtmpSession(const Socket::Ptr &_sock);
@@ -68,10 +69,33 @@ private:
 	void setMetaData(AMFDecoder &dec);
 
 	void onSendMedia(const RtmpPacket::Ptr &pkt);
+	uint32_t getModifiedStamp(const RtmpPacket::Ptr &pkt);
+	/**
+	 * 该vhost是否开启了聚合消息输出
+	 */
+	static bool enableAggregate(const string &vhost);
+	/**
+	 * 把本线程周期内缓存的音视频消息合并为一个聚合消息发送
+	 */
+	void flushAggregate();
 	void onSendRawData(const Buffer::Ptr &buffer) override{
         _ui64TotalBytes += buffer->size();
+        if(_bBatchSend){
+            //批量发送模式，先缓存数据的引用
+            _aBatchBuf.emplace_back(buffer);
+            return;
+        }
 		send(buffer);
 	}
+	/**
+	 * 开始批量发送，之后的数据先缓存起来，直到endBatchSend时通过一次聚集写发送
+	 */
+	void beginBatchSend();
+	void endBatchSend();
+	/**
+	 * 套接字发送缓存清空，如果之前因为积压丢弃了数据，则从gop缓存恢复播放
+	 */
+	void onSocketFlushed();
 	void onRtmpChunk(RtmpPacket &chunkData) override;
 
 	template<typename first, typename second>
@@ -95,6 +119,18 @@ private:
 	uint32_t _aui32FirstStamp[2] = {0};
 	//消耗的总流量
 	uint64_t _ui64TotalBytes = 0;
+	//过滤环形缓存重复派发的gop缓存数据
+	GopCacheFilter<RtmpPacket::Ptr> _gopFilter;
+	//最近一次发送的视频关键帧，丢包恢复时用于判断gop缓存是否已经发送过
+	weak_ptr<RtmpPacket> _lastKeyFrame;
+	//批量发送缓存
+	bool _bBatchSend = false;
+	vector<Buffer::Ptr> _aBatchBuf;
+	//是否以聚合消息方式发送音视频
+	bool _bAggregate = false;
+	//等待合并为聚合消息的音视频
+	vector<RtmpPacket::Ptr> _aggregatePending;
+	uint32_t _aggregateBytes = 0;
 
 };
 
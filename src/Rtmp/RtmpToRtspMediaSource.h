@@ -57,6 +57,7 @@ public:
 						  int ringSize = 0):RtmpMediaSource(vhost, app, id,ringSize){
 		_recorder = std::make_shared<MediaRecorder>(vhost, app, id, bEnableHls, bEnableMp4);
 		_rtmpDemuxer = std::make_shared<RtmpDemuxer>();
+		_stats = std::make_shared<MediaStats>();
 	}
 	virtual ~RtmpToRtspMediaSource(){}
 
@@ -77,8 +78,10 @@ public:
 				_recorder->addTrack(track);
 				track->addDelegate(_rtspMuxer);
 				track->addDelegate(_recorder);
+				track->addDelegate(_stats);
 			}
             _rtspMuxer->setListener(_listener);
+            _rtspMuxer->setStats(_stats);
 		}
 		RtmpMediaSource::onWrite(pkt,key_pos);
 	}
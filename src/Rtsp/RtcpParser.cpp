@@ -0,0 +1,149 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "RtcpParser.h"
+#if defined(_WIN32)
+#include "Util/util.h"
+#else
+#include <sys/time.h>
+#endif
+
+namespace mediakit {
+
+static inline uint32_t loadBE32(const uint8_t *ptr) {
+    return ((uint32_t) ptr[0] << 24) | ((uint32_t) ptr[1] << 16) | ((uint32_t) ptr[2] << 8) | ptr[3];
+}
+
+static inline uint16_t loadBE16(const uint8_t *ptr) {
+    return ((uint16_t) ptr[0] << 8) | ptr[1];
+}
+
+void RtcpParser::forEach(const uint8_t *data, size_t len, const onRtcp &cb) {
+    while (len >= 4) {
+        if ((data[0] >> 6) != 2) {
+            //版本号不对
+            break;
+        }
+        //长度字段为32位字数减1
+        size_t size = (loadBE16(data + 2) + 1) * 4;
+        if (size > len) {
+            break;
+        }
+        cb(data[1], data[0] & 0x1F, data, size);
+        data += size;
+        len -= size;
+    }
+}
+
+bool RtcpParser::parseNack(const uint8_t *data, size_t len, uint32_t &mediaSsrc, vector<uint16_t> &seqs) {
+    //4个字节头 + 发送者ssrc + 媒体源ssrc + 至少一个FCI
+    if (len < 16 || data[1] != RTCP_RTPFB || (data[0] & 0x1F) != 1) {
+        return false;
+    }
+    mediaSsrc = loadBE32(data + 8);
+    for (size_t offset = 12; offset + 4 <= len; offset += 4) {
+        //每个FCI为一个丢失的序号(PID)以及其后16个包的丢失掩码(BLP)
+        uint16_t pid = loadBE16(data + offset);
+        uint16_t blp = loadBE16(data + offset + 2);
+        seqs.emplace_back(pid);
+        for (int i = 0; i < 16; ++i) {
+            if (blp & (1 << i)) {
+                seqs.emplace_back(pid + i + 1);
+            }
+        }
+    }
+    return true;
+}
+
+bool RtcpParser::parseReportBlocks(const uint8_t *data, size_t len, vector<RtcpReportBlock> &blocks) {
+    size_t offset;
+    if (data[1] == RTCP_SR) {
+        //4个字节头 + 发送者ssrc + 20个字节发送者信息
+        offset = 28;
+    } else if (data[1] == RTCP_RR) {
+        //4个字节头 + 发送者ssrc
+        offset = 8;
+    } else {
+        return false;
+    }
+    int count = data[0] & 0x1F;
+    if (len < offset + count * 24) {
+        return false;
+    }
+    for (int i = 0; i < count; ++i, offset += 24) {
+        RtcpReportBlock block;
+        auto ptr = data + offset;
+        block.ssrc = loadBE32(ptr);
+        block.fractionLost = ptr[4];
+        //24位有符号数
+        block.totalLost = (int32_t) (loadBE32(ptr + 4) << 8) >> 8;
+        block.extHighestSeq = loadBE32(ptr + 8);
+        block.jitter = loadBE32(ptr + 12);
+        block.lsr = loadBE32(ptr + 16);
+        block.dlsr = loadBE32(ptr + 20);
+        blocks.emplace_back(block);
+    }
+    return true;
+}
+
+bool RtcpParser::parseSenderReport(const uint8_t *data, size_t len, uint32_t &ssrc, uint32_t &ntpMiddle32) {
+    if (len < 28 || data[1] != RTCP_SR) {
+        return false;
+    }
+    ssrc = loadBE32(data + 4);
+    ntpMiddle32 = loadBE32(data + 10);
+    return true;
+}
+
+void RtcpParser::getNtpStamp(uint32_t &msw, uint32_t &lsw) {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    //0x83AA7E80为1900年到1970年的秒数
+    msw = tv.tv_sec + 0x83AA7E80;
+    lsw = (uint32_t) (((uint64_t) tv.tv_usec << 32) / 1000000);
+}
+
+uint32_t RtcpParser::getNtpMiddle32() {
+    uint32_t msw, lsw;
+    getNtpStamp(msw, lsw);
+    return (msw << 16) | (lsw >> 16);
+}
+
+int32_t RtcpParser::getRttMS(uint32_t lsr, uint32_t dlsr) {
+    if (!lsr) {
+        //对端还未收到过SR
+        return -1;
+    }
+    uint32_t rtt = getNtpMiddle32() - lsr - dlsr;
+    if (rtt & 0x80000000) {
+        //时钟精度误差导致的负数
+        return 0;
+    }
+    return (int32_t) (((uint64_t) rtt * 1000) >> 16);
+}
+
+}//namespace mediakit
@@ -0,0 +1,142 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ZLMEDIAKIT_RTCPPARSER_H
+#define ZLMEDIAKIT_RTCPPARSER_H
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+using namespace std;
+
+namespace mediakit {
+
+//rtcp包类型
+typedef enum {
+    RTCP_SR = 200,
+    RTCP_RR = 201,
+    RTCP_SDES = 202,
+    RTCP_BYE = 203,
+    RTCP_APP = 204,
+    //传输层反馈(RFC 4585)，FMT为1时是Generic NACK
+    RTCP_RTPFB = 205,
+    RTCP_PSFB = 206,
+} RtcpType;
+
+/**
+ * SR/RR中的一个接收报告块(RFC 3550 6.4.1)
+ */
+class RtcpReportBlock {
+public:
+    //被报告的媒体源ssrc
+    uint32_t ssrc = 0;
+    //上一个报告周期的丢包率，单位1/256
+    uint8_t fractionLost = 0;
+    //累计丢包个数，乱序或重复的包可能导致其为负数
+    int32_t totalLost = 0;
+    //收到的最大扩展序号
+    uint32_t extHighestSeq = 0;
+    //到达间隔抖动，单位为rtp时间戳
+    uint32_t jitter = 0;
+    //最后一个SR的ntp时间戳中间32位
+    uint32_t lsr = 0;
+    //收到最后一个SR到发送本报告的延时，单位1/65536秒
+    uint32_t dlsr = 0;
+};
+
+/**
+ * rtcp解析
+ */
+class RtcpParser {
+public:
+    /**
+     * 复合rtcp包中的一个rtcp包
+     * @param pt 包类型
+     * @param fmt 头部第一个字节的低5位，SR/RR中为报告块个数，反馈包中为反馈类型
+     * @param data 该rtcp包(含4个字节头)
+     * @param len 该rtcp包长度
+     */
+    typedef function<void(uint8_t pt, uint8_t fmt, const uint8_t *data, size_t len)> onRtcp;
+
+    /**
+     * 遍历复合rtcp包，遇到非法的包时停止
+     */
+    static void forEach(const uint8_t *data, size_t len, const onRtcp &cb);
+
+    /**
+     * 解析Generic NACK(RFC 4585 6.2.1)
+     * @param data rtcp包(含4个字节头)，类型须为RTCP_RTPFB且fmt为1
+     * @param len rtcp包长度
+     * @param mediaSsrc 返回丢包的媒体源ssrc
+     * @param seqs 返回所有丢失的序号
+     * @return 是否解析成功
+     */
+    static bool parseNack(const uint8_t *data, size_t len, uint32_t &mediaSsrc, vector<uint16_t> &seqs);
+
+    /**
+     * 解析SR或RR中的接收报告块
+     * @param data rtcp包(含4个字节头)，类型须为RTCP_SR或RTCP_RR
+     * @param len rtcp包长度
+     * @param blocks 返回所有报告块
+     * @return 是否解析成功
+     */
+    static bool parseReportBlocks(const uint8_t *data, size_t len, vector<RtcpReportBlock> &blocks);
+
+    /**
+     * 解析SR的发送者信息
+     * @param data rtcp包(含4个字节头)，类型须为RTCP_SR
+     * @param len rtcp包长度
+     * @param ssrc 返回发送者ssrc
+     * @param ntpMiddle32 返回ntp时间戳中间32位，即RR中的LSR字段
+     * @return 是否解析成功
+     */
+    static bool parseSenderReport(const uint8_t *data, size_t len, uint32_t &ssrc, uint32_t &ntpMiddle32);
+
+    /**
+     * 获取当前ntp时间戳
+     * @param msw 1900年以来的秒数
+     * @param lsw 秒的小数部分，单位1/2^32秒
+     */
+    static void getNtpStamp(uint32_t &msw, uint32_t &lsw);
+
+    /**
+     * 获取当前ntp时间戳中间32位，单位1/65536秒
+     */
+    static uint32_t getNtpMiddle32();
+
+    /**
+     * 根据接收报告块的LSR与DLSR计算往返时延(RFC 3550 6.4.1)
+     * @param lsr 报告块中的LSR
+     * @param dlsr 报告块中的DLSR
+     * @return 往返时延，单位毫秒，对端未收到过SR时返回-1
+     */
+    static int32_t getRttMS(uint32_t lsr, uint32_t dlsr);
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_RTCPPARSER_H
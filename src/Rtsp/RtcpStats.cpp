@@ -0,0 +1,193 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "RtcpStats.h"
+#include "Util/util.h"
+
+using namespace toolkit;
+
+namespace mediakit {
+
+void RtcpStats::onReport(TrackType type, uint8_t fractionLost, int32_t totalLost, uint32_t jitterMS, int32_t rttMS) {
+    if (type != TrackVideo && type != TrackAudio) {
+        return;
+    }
+    auto &track = _tracks[type];
+    track.fractionLost.store(fractionLost, memory_order_relaxed);
+    track.totalLost.store(totalLost, memory_order_relaxed);
+    track.jitterMS.store(jitterMS, memory_order_relaxed);
+    if (rttMS >= 0) {
+        //对端未收到过SR时保留上次的往返时延
+        track.rttMS.store(rttMS, memory_order_relaxed);
+    }
+    track.lastReport.store(getCurrentMillisecond(), memory_order_relaxed);
+    track.reports.fetch_add(1, memory_order_relaxed);
+}
+
+bool RtcpStats::haveTrack(TrackType type) const {
+    if (type != TrackVideo && type != TrackAudio) {
+        return false;
+    }
+    return _tracks[type].reports.load(memory_order_relaxed) != 0;
+}
+
+RtcpTrackStats RtcpStats::getTrackStats(TrackType type) const {
+    RtcpTrackStats ret;
+    if (type != TrackVideo && type != TrackAudio) {
+        return ret;
+    }
+    auto &track = _tracks[type];
+    ret.fractionLost = track.fractionLost.load(memory_order_relaxed);
+    ret.totalLost = track.totalLost.load(memory_order_relaxed);
+    ret.jitterMS = track.jitterMS.load(memory_order_relaxed);
+    ret.rttMS = track.rttMS.load(memory_order_relaxed);
+    ret.reports = track.reports.load(memory_order_relaxed);
+    auto lastReport = track.lastReport.load(memory_order_relaxed);
+    auto now = getCurrentMillisecond();
+    ret.idleMS = lastReport && now > lastReport ? now - lastReport : 0;
+    return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//序号跳跃超过该值时视为对端重置了序号
+#define RTP_SEQ_MAX_DROPOUT 3000
+#define RTP_SEQ_MAX_MISORDER 100
+
+void RtcpReceiverContext::onRtp(uint16_t seq, uint32_t stamp, uint32_t samplerate) {
+    if (!samplerate) {
+        return;
+    }
+    //到达时间转换成rtp时间戳单位
+    int64_t arrival = getCurrentMicrosecond() * samplerate / 1000000;
+    if (!_started || samplerate != _samplerate) {
+        _started = true;
+        _samplerate = samplerate;
+        _baseSeq = seq;
+        _maxSeq = seq;
+        _cycles = 0;
+        _received = 1;
+        _expectedPrior = 0;
+        _receivedPrior = 0;
+        _jitterQ4 = 0;
+        _lastTransit = arrival - stamp;
+        return;
+    }
+
+    uint16_t delta = seq - _maxSeq;
+    if (delta < RTP_SEQ_MAX_DROPOUT) {
+        //按序到达或者有少量丢包
+        if (seq < _maxSeq) {
+            //序号回环
+            _cycles += 0x10000;
+        }
+        _maxSeq = seq;
+    } else if (delta <= 0x10000 - RTP_SEQ_MAX_MISORDER) {
+        //序号大幅跳跃，视为对端重置了序号，重新开始统计
+        _lostBase = getTotalLost();
+        _started = false;
+        onRtp(seq, stamp, samplerate);
+        return;
+    }
+    //其他情况为乱序或重复的包
+    ++_received;
+
+    //RFC 3550 A.8
+    int64_t transit = arrival - stamp;
+    int64_t d = transit - _lastTransit;
+    _lastTransit = transit;
+    if (d < 0) {
+        d = -d;
+    }
+    if (d > 0x7FFFFFFF) {
+        //时间戳跳跃
+        return;
+    }
+    _jitterQ4 += (uint32_t) d - ((_jitterQ4 + 8) >> 4);
+}
+
+void RtcpReceiverContext::onSenderReport(uint32_t ntpMiddle32) {
+    _lsr = ntpMiddle32;
+    _lsrRecvUS = getCurrentMicrosecond();
+}
+
+bool RtcpReceiverContext::makeReport(uint8_t &fractionLost, int32_t &totalLost, uint32_t &extHighestSeq,
+                                     uint32_t &jitter, uint32_t &lsr, uint32_t &dlsr) {
+    fractionLost = 0;
+    totalLost = 0;
+    extHighestSeq = 0;
+    jitter = 0;
+    lsr = _lsr;
+    dlsr = _lsr ? (uint32_t) (((getCurrentMicrosecond() - _lsrRecvUS) << 16) / 1000000) : 0;
+    if (!_started) {
+        return false;
+    }
+
+    //RFC 3550 A.3
+    extHighestSeq = _cycles + _maxSeq;
+    uint64_t expected = extHighestSeq - _baseSeq + 1;
+    int64_t lost = (int64_t) expected - (int64_t) _received;
+    //24位有符号数
+    if (lost > 0x7FFFFF) {
+        lost = 0x7FFFFF;
+    } else if (lost < -0x800000) {
+        lost = -0x800000;
+    }
+    totalLost = (int32_t) lost;
+
+    int64_t expectedInterval = expected - _expectedPrior;
+    int64_t receivedInterval = _received - _receivedPrior;
+    _expectedPrior = expected;
+    _receivedPrior = _received;
+    int64_t lostInterval = expectedInterval - receivedInterval;
+    if (expectedInterval > 0 && lostInterval > 0) {
+        fractionLost = (uint8_t) MIN((lostInterval << 8) / expectedInterval, 255);
+    }
+    jitter = _jitterQ4 >> 4;
+    return true;
+}
+
+uint32_t RtcpReceiverContext::getJitterMS() const {
+    if (!_samplerate) {
+        return 0;
+    }
+    return (uint64_t) (_jitterQ4 >> 4) * 1000 / _samplerate;
+}
+
+int64_t RtcpReceiverContext::getTotalLost() const {
+    if (!_started) {
+        return _lostBase;
+    }
+    uint64_t expected = _cycles + _maxSeq - _baseSeq + 1;
+    return _lostBase + (int64_t) expected - (int64_t) _received;
+}
+
+void RtcpReceiverContext::clear() {
+    *this = RtcpReceiverContext();
+}
+
+}//namespace mediakit
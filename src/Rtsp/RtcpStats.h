@@ -0,0 +1,187 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ZLMEDIAKIT_RTCPSTATS_H
+#define ZLMEDIAKIT_RTCPSTATS_H
+
+#include <atomic>
+#include <memory>
+#include "Extension/Frame.h"
+
+using namespace std;
+
+namespace mediakit {
+
+/**
+ * 某个track根据rtcp接收报告得到的网络质量快照
+ */
+class RtcpTrackStats {
+public:
+    //最近一个报告周期的丢包率，单位1/256
+    uint32_t fractionLost = 0;
+    //累计丢包个数
+    int32_t totalLost = 0;
+    //到达间隔抖动，单位毫秒
+    uint32_t jitterMS = 0;
+    //往返时延，单位毫秒，-1为未知
+    int32_t rttMS = -1;
+    //接收报告个数
+    uint64_t reports = 0;
+    //距离最后一个接收报告的时间，单位毫秒
+    uint64_t idleMS = 0;
+};
+
+/**
+ * 会话级别的rtcp统计
+ * rtsp服务器中来自观看者的RR，或者rtsp拉流时发送给服务器的RR，在会话线程中更新，
+ * 统计值都是原子变量，其他线程(如http api)可以无锁读取
+ */
+class RtcpStats {
+public:
+    typedef std::shared_ptr<RtcpStats> Ptr;
+    RtcpStats() {}
+    ~RtcpStats() {}
+
+    /**
+     * 更新某track的接收报告
+     * @param type track类型
+     * @param fractionLost 丢包率，单位1/256
+     * @param totalLost 累计丢包个数
+     * @param jitterMS 到达间隔抖动，单位毫秒
+     * @param rttMS 往返时延，单位毫秒，-1为未知
+     */
+    void onReport(TrackType type, uint8_t fractionLost, int32_t totalLost, uint32_t jitterMS, int32_t rttMS);
+
+    /**
+     * 增加NACK重传统计
+     * @param retransmitted 重传的包个数
+     * @param missed 已经不在缓存中无法重传的包个数
+     */
+    void addNack(uint32_t retransmitted, uint32_t missed) {
+        _nackRetransmitted.fetch_add(retransmitted, memory_order_relaxed);
+        _nackMissed.fetch_add(missed, memory_order_relaxed);
+    }
+
+    uint64_t getNackRetransmitted() const {
+        return _nackRetransmitted.load(memory_order_relaxed);
+    }
+
+    uint64_t getNackMissed() const {
+        return _nackMissed.load(memory_order_relaxed);
+    }
+
+    /**
+     * 是否收到过该track的接收报告
+     */
+    bool haveTrack(TrackType type) const;
+
+    /**
+     * 获取某个track的统计快照，可以在任意线程调用
+     */
+    RtcpTrackStats getTrackStats(TrackType type) const;
+private:
+    class TrackStats {
+    public:
+        atomic<uint32_t> fractionLost{0};
+        atomic<int32_t> totalLost{0};
+        atomic<uint32_t> jitterMS{0};
+        atomic<int32_t> rttMS{-1};
+        atomic<uint64_t> reports{0};
+        atomic<uint64_t> lastReport{0};
+    };
+    TrackStats _tracks[2];
+    atomic<uint64_t> _nackRetransmitted{0};
+    atomic<uint64_t> _nackMissed{0};
+};
+
+/**
+ * rtp接收端统计(RFC 3550 A.1、A.3、A.8)，用于生成RR的报告块，只能在接收线程中使用
+ */
+class RtcpReceiverContext {
+public:
+    RtcpReceiverContext() {}
+    ~RtcpReceiverContext() {}
+
+    /**
+     * 收到rtp包时调用，须在排序之前调用以反映真实的到达间隔
+     * @param seq rtp序号
+     * @param stamp rtp时间戳(未转换成毫秒)
+     * @param samplerate 时间戳的采样率
+     */
+    void onRtp(uint16_t seq, uint32_t stamp, uint32_t samplerate);
+
+    /**
+     * 收到SR时调用
+     * @param ntpMiddle32 SR中ntp时间戳的中间32位
+     */
+    void onSenderReport(uint32_t ntpMiddle32);
+
+    /**
+     * 生成报告块字段，同时开始新的报告周期
+     * @param fractionLost 返回本报告周期的丢包率，单位1/256
+     * @param totalLost 返回累计丢包个数
+     * @param extHighestSeq 返回收到的最大扩展序号
+     * @param jitter 返回到达间隔抖动，单位为rtp时间戳
+     * @param lsr 返回最后一个SR的ntp时间戳中间32位
+     * @param dlsr 返回收到最后一个SR到现在的延时，单位1/65536秒
+     * @return 是否收到过rtp包
+     */
+    bool makeReport(uint8_t &fractionLost, int32_t &totalLost, uint32_t &extHighestSeq,
+                    uint32_t &jitter, uint32_t &lsr, uint32_t &dlsr);
+
+    /**
+     * 获取到达间隔抖动，单位毫秒
+     */
+    uint32_t getJitterMS() const;
+
+    /**
+     * 获取累计丢包个数(RFC 3550 A.3，期望收到的包个数减去实际收到的包个数)
+     * 乱序到达的包不计为丢包，对端重置序号后继续累加
+     */
+    int64_t getTotalLost() const;
+
+    void clear();
+private:
+    bool _started = false;
+    uint16_t _maxSeq = 0;
+    uint32_t _cycles = 0;
+    uint32_t _baseSeq = 0;
+    uint64_t _received = 0;
+    uint64_t _expectedPrior = 0;
+    uint64_t _receivedPrior = 0;
+    //对端重置序号之前的累计丢包个数
+    int64_t _lostBase = 0;
+    //到达间隔抖动，单位为rtp时间戳，放大16倍以减少整数运算误差
+    uint32_t _jitterQ4 = 0;
+    int64_t _lastTransit = 0;
+    uint32_t _samplerate = 0;
+    uint32_t _lsr = 0;
+    uint64_t _lsrRecvUS = 0;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_RTCPSTATS_H
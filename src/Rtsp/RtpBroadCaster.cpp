@@ -28,8 +28,11 @@
 #include <type_traits>
 #include "RtpBroadCaster.h"
 #include "Util/util.h"
+#include "Util/onceToken.h"
+#include "Util/NoticeCenter.h"
 #include "Network/sockutil.h"
 #include "RtspSession.h"
+#include "UdpBatchSender.h"
 
 using namespace std;
 using namespace toolkit;
@@ -83,6 +86,12 @@ void MultiCastAddressMaker::release(uint32_t iAddr){
 
 recursive_mutex RtpBroadCaster::g_mtx;
 unordered_map<string, weak_ptr<RtpBroadCaster> > RtpBroadCaster::g_mapBroadCaster;
+unordered_map<string, RtpBroadCaster::Ptr > RtpBroadCaster::g_mapAlwaysOn;
+
+static string makeKey(const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream){
+	GET_CONFIG(bool,enableVhost,General::kEnableVhost);
+	return StrPrinter << strLocalIp << " " << (enableVhost ? strVhost : DEFAULT_VHOST) << " " << strApp << " " << strStream;
+}
 
 void RtpBroadCaster::setDetachCB(void* listener, const onDetach& cb) {
 	lock_guard<recursive_mutex> lck(_mtx);
@@ -93,17 +102,19 @@ void RtpBroadCaster::setDetachCB(void* listener, const onDetach& cb) {
 	}
 }
 RtpBroadCaster::~RtpBroadCaster() {
-	_pReader->setReadCB(nullptr);
-	_pReader->setDetachCB(nullptr);
-	DebugL;
+	if(_pReader){
+		_pReader->setReadCB(nullptr);
+		_pReader->setDetachCB(nullptr);
+	}
+	DebugL << _strKey;
 }
 RtpBroadCaster::RtpBroadCaster(const EventPoller::Ptr &poller,const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream) {
-	auto src = dynamic_pointer_cast<RtspMediaSource>(MediaSource::find(RTSP_SCHEMA,strVhost,strApp, strStream));
-	if(!src){
-		auto strErr = StrPrinter << "未找到媒体源:" << strVhost << " " << strApp << " " << strStream << endl;
-		throw std::runtime_error(strErr);
-	}
+	_poller = poller;
+	_strKey = makeKey(strLocalIp,strVhost,strApp,strStream);
 	_multiAddr = MultiCastAddressMaker::Instance().obtain();
+	if(!_multiAddr){
+		throw std::runtime_error("分配组播地址失败");
+	}
 	for(auto i = 0; i < 2; i++){
 		_apUdpSock[i].reset(new Socket(poller));
 		if(!_apUdpSock[i]->bindUdpSock(0, strLocalIp.data())){
@@ -124,47 +135,97 @@ RtpBroadCaster::RtpBroadCaster(const EventPoller::Ptr &poller,const string &strL
 		bzero(&(peerAddr.sin_zero), sizeof peerAddr.sin_zero);
 		_apUdpSock[i]->setSendPeerAddr((struct sockaddr *)&peerAddr);
 	}
-	_pReader = src->getRing()->attach(poller);
-	_pReader->setReadCB([this](const RtpPacket::Ptr &pkt){
-		int i = (int)(pkt->type);
-		auto &pSock = _apUdpSock[i];
-		auto &peerAddr = _aPeerUdpAddr[i];
-        BufferRtp::Ptr buffer(new BufferRtp(pkt,4));
-		pSock->send(buffer);
-	});
-	_pReader->setDetachCB([this](){
-		unordered_map<void * , onDetach > _mapDetach_copy;
-		{
-			lock_guard<recursive_mutex> lck(_mtx);
-			_mapDetach_copy = std::move(_mapDetach);
-		}
-		for(auto &pr : _mapDetach_copy){
-			pr.second();
-		}
-	});
 	DebugL << MultiCastAddressMaker::toString(*_multiAddr) << " "
 			<< _apUdpSock[0]->get_local_port() << " "
 			<< _apUdpSock[1]->get_local_port() << " "
             << strVhost << " "
 			<< strApp << " " << strStream;
 }
+
+void RtpBroadCaster::attach(const RtspMediaSource::Ptr &src){
+	//环形缓存读取器必须在其所在线程中创建
+	_pReader = src->getRing()->attach(_poller);
+	_pReader->setReadCB([this](const RtpPacketBatch::Ptr &batch){
+		sendRtp(batch);
+	});
+	_pReader->setDetachCB([this](){
+		onDetached();
+	});
+}
+
+void RtpBroadCaster::sendRtp(const RtpPacketBatch::Ptr &batch){
+	auto &pkts = batch->getPackets();
+	size_t sent = 0;
+	GET_CONFIG(bool,udpBatchSend,Rtp::kUdpBatchSend);
+	if(udpBatchSend && pkts.size() > 1){
+		//同一帧的rtp包属于同一个track,批量发送
+		int i = (int)(pkts[0]->type);
+		auto &pSock = _apUdpSock[i];
+		if(!pSock->isSocketBusy()){
+			sent = UdpBatchSender::send(pSock->rawFD(), (struct sockaddr *)&_aPeerUdpAddr[i], sizeof(struct sockaddr_in), pkts);
+		}
+	}
+	for(; sent < pkts.size(); ++sent){
+		auto &pkt = pkts[sent];
+		int i = (int)(pkt->type);
+		auto &pSock = _apUdpSock[i];
+		BufferRtp::Ptr buffer(new BufferRtp(pkt,4));
+		pSock->send(buffer);
+	}
+}
+
+void RtpBroadCaster::onDetached(){
+	unordered_map<void * , onDetach > _mapDetach_copy;
+	{
+		lock_guard<recursive_mutex> lck(_mtx);
+		_mapDetach_copy = std::move(_mapDetach);
+	}
+	for(auto &pr : _mapDetach_copy){
+		pr.second();
+	}
+	Ptr self;
+	{
+		lock_guard<recursive_mutex> lck(g_mtx);
+		auto it = g_mapAlwaysOn.find(_strKey);
+		if(it != g_mapAlwaysOn.end() && it->second.get() == this){
+			//常驻组播等待媒体源重新注册，在锁外释放
+			self.swap(it->second);
+		}
+	}
+}
+
 uint16_t RtpBroadCaster::getPort(TrackType trackType){
 	return _apUdpSock[trackType]->get_local_port();
 }
 string RtpBroadCaster::getIP(){
 	return inet_ntoa(_aPeerUdpAddr[0].sin_addr);
 }
-RtpBroadCaster::Ptr RtpBroadCaster::make(const EventPoller::Ptr &poller,const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream){
+const EventPoller::Ptr &RtpBroadCaster::getPoller() const{
+	return _poller;
+}
+RtpBroadCaster::Ptr RtpBroadCaster::make(const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream){
 	try{
+		auto src = dynamic_pointer_cast<RtspMediaSource>(MediaSource::find(RTSP_SCHEMA,strVhost,strApp, strStream));
+		if(!src){
+			auto strErr = StrPrinter << "未找到媒体源:" << strVhost << " " << strApp << " " << strStream << endl;
+			throw std::runtime_error(strErr);
+		}
+		//固定在负载最低的线程上发送，与请求者所在线程无关
+		auto poller = EventPollerPool::Instance().getPoller();
 		auto ret = Ptr(new RtpBroadCaster(poller,strLocalIp,strVhost,strApp,strStream),[poller](RtpBroadCaster *ptr){
             poller->async([ptr]() {
                 delete ptr;
-            });
+            }, false);
 		});
-		lock_guard<recursive_mutex> lck(g_mtx);
-		string strKey = StrPrinter << strLocalIp << " "  << strVhost << " " << strApp << " " << strStream << endl;
 		weak_ptr<RtpBroadCaster> weakPtr = ret;
-		g_mapBroadCaster.emplace(strKey,weakPtr);
+		poller->async([weakPtr,src](){
+			auto strongPtr = weakPtr.lock();
+			if(strongPtr){
+				strongPtr->attach(src);
+			}
+		});
+		lock_guard<recursive_mutex> lck(g_mtx);
+		g_mapBroadCaster[ret->_strKey] = weakPtr;
 		return ret;
 	}catch (std::exception &ex) {
 		WarnL << ex.what();
@@ -172,20 +233,64 @@ RtpBroadCaster::Ptr RtpBroadCaster::make(const EventPoller::Ptr &poller,const st
 	}
 }
 
-RtpBroadCaster::Ptr RtpBroadCaster::get(const EventPoller::Ptr &poller,const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream) {
-	string strKey = StrPrinter << strLocalIp << " " << strVhost << " " << strApp << " " << strStream << endl;
+RtpBroadCaster::Ptr RtpBroadCaster::get(const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream) {
+	auto strKey = makeKey(strLocalIp,strVhost,strApp,strStream);
 	lock_guard<recursive_mutex> lck(g_mtx);
 	auto it = g_mapBroadCaster.find(strKey);
 	if (it == g_mapBroadCaster.end()) {
-		return make(poller,strLocalIp,strVhost,strApp, strStream);
+		return make(strLocalIp,strVhost,strApp, strStream);
 	}
 	auto ret = it->second.lock();
 	if (!ret) {
 		g_mapBroadCaster.erase(it);
-		return make(poller,strLocalIp,strVhost,strApp, strStream);
+		return make(strLocalIp,strVhost,strApp, strStream);
+	}
+	return ret;
+}
+
+RtpBroadCaster::Ptr RtpBroadCaster::startAlwaysOn(const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream){
+	static onceToken s_token([](){
+		//媒体源重新注册后恢复常驻组播
+		NoticeCenter::Instance().addListener(&g_mapAlwaysOn,Broadcast::kBroadcastMediaChanged,[](BroadcastMediaChangedArgs){
+			if(bRegist && schema == RTSP_SCHEMA){
+				onMediaRegist(vhost,app,stream);
+			}
+		});
+	});
+	auto strKey = makeKey(strLocalIp,strVhost,strApp,strStream);
+	lock_guard<recursive_mutex> lck(g_mtx);
+	auto &ret = g_mapAlwaysOn[strKey];
+	if(!ret){
+		//媒体源还未注册时返回空
+		ret = get(strLocalIp,strVhost,strApp,strStream);
 	}
 	return ret;
 }
 
+bool RtpBroadCaster::stopAlwaysOn(const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream){
+	Ptr caster;
+	lock_guard<recursive_mutex> lck(g_mtx);
+	auto it = g_mapAlwaysOn.find(makeKey(strLocalIp,strVhost,strApp,strStream));
+	if(it == g_mapAlwaysOn.end()){
+		return false;
+	}
+	caster = std::move(it->second);
+	g_mapAlwaysOn.erase(it);
+	return true;
+}
+
+void RtpBroadCaster::onMediaRegist(const string &strVhost,const string &strApp,const string &strStream){
+	//不含网卡ip的key后缀
+	auto suffix = makeKey("",strVhost,strApp,strStream);
+	lock_guard<recursive_mutex> lck(g_mtx);
+	for(auto &pr : g_mapAlwaysOn){
+		auto &key = pr.first;
+		if(pr.second || key.size() <= suffix.size() || key.compare(key.size() - suffix.size(), suffix.size(), suffix) != 0){
+			continue;
+		}
+		pr.second = get(key.substr(0, key.size() - suffix.size()),strVhost,strApp,strStream);
+		InfoL << "恢复常驻组播:" << key << " " << (pr.second ? pr.second->getIP() : "failed");
+	}
+}
 
 }//namespace mediakit
@@ -65,29 +65,68 @@ private:
 	recursive_mutex _mtx;
 	unordered_set<uint32_t> _setBadAddr;
 };
+/**
+ * rtp组播输出
+ * 每个流在每个网卡上只创建一个，所有组播播放器共享；
+ * 固定运行在创建时从线程池中选出的负载最低的线程上，不随第一个请求者的线程而定，
+ * 同一帧的rtp包通过sendmmsg/GSO批量发送；
+ * 可以设置为常驻组播，没有rtsp会话时也持续输出，媒体源重新注册后自动恢复
+ */
 class RtpBroadCaster {
 public:
 	typedef std::shared_ptr<RtpBroadCaster> Ptr;
 	typedef function<void()> onDetach;
 	virtual ~RtpBroadCaster();
-	static Ptr get(const EventPoller::Ptr &poller,const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream);
+	/**
+	 * 获取某个流在某网卡上的组播输出，不存在时创建
+	 * @param strLocalIp 发送组播的网卡ip
+	 * @return 媒体源不存在或分配组播地址失败时返回空
+	 */
+	static Ptr get(const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream);
+
+	/**
+	 * 开启常驻组播，媒体源未注册时等其注册后再开始输出
+	 * @return 当前的组播输出，媒体源还未注册时返回空
+	 */
+	static Ptr startAlwaysOn(const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream);
+
+	/**
+	 * 关闭常驻组播，仍有组播播放器时继续输出直到所有播放器断开
+	 * @return 是否存在该常驻组播
+	 */
+	static bool stopAlwaysOn(const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream);
+
 	void setDetachCB(void *listener,const onDetach &cb);
 	uint16_t getPort(TrackType trackType);
 	string getIP();
+	/**
+	 * 获取发送线程
+	 */
+	const EventPoller::Ptr &getPoller() const;
 private:
 	static recursive_mutex g_mtx;
 	static unordered_map<string , weak_ptr<RtpBroadCaster> > g_mapBroadCaster;
-	static Ptr make(const EventPoller::Ptr &poller,const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream);
+	//常驻组播，值为空代表等待媒体源注册
+	static unordered_map<string , Ptr > g_mapAlwaysOn;
+	static Ptr make(const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream);
+	static void onMediaRegist(const string &strVhost,const string &strApp,const string &strStream);
 
+	RtpBroadCaster(const EventPoller::Ptr &poller,const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream);
+	/**
+	 * 在发送线程中创建环形缓存读取器
+	 */
+	void attach(const RtspMediaSource::Ptr &src);
+	void onDetached();
+	void sendRtp(const RtpPacketBatch::Ptr &batch);
+private:
+	EventPoller::Ptr _poller;
+	string _strKey;
 	std::shared_ptr<uint32_t> _multiAddr;
 	recursive_mutex _mtx;
 	unordered_map<void * , onDetach > _mapDetach;
 	RtspMediaSource::RingType::RingReader::Ptr _pReader;
 	Socket::Ptr _apUdpSock[2];
 	struct sockaddr_in _aPeerUdpAddr[2];
-
-	RtpBroadCaster(const EventPoller::Ptr &poller,const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream);
-
 };
 
 }//namespace mediakit
@@ -30,7 +30,8 @@ namespace mediakit{
 
 RtpPacket::Ptr RtpInfo::makeRtp(TrackType type, const void* data, unsigned int len, bool mark, uint32_t uiStamp) {
     uint16_t ui16RtpLen = len + 12;
-    uint32_t ts = htonl((_ui32SampleRate / 1000) * uiStamp);
+    auto rtpStamp = _stampScale.fromMS(uiStamp);
+    uint32_t ts = htonl(rtpStamp);
     uint16_t sq = htons(_ui16Sequence);
     uint32_t sc = htonl(_ui32Ssrc);
 
@@ -57,6 +58,7 @@ RtpPacket::Ptr RtpInfo::makeRtp(TrackType type, const void* data, unsigned int l
     rtppkt->mark = mark;
     rtppkt->sequence = _ui16Sequence;
     rtppkt->timeStamp = uiStamp;
+    rtppkt->rtpStamp = rtpStamp;
     rtppkt->ssrc = _ui32Ssrc;
     rtppkt->type = type;
     rtppkt->offset = 16;
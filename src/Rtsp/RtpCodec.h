@@ -104,6 +104,7 @@ public:
         }
         _ui32Ssrc = ui32Ssrc;
         _ui32SampleRate = ui32SampleRate;
+        _stampScale.setSampleRate(ui32SampleRate);
         _ui32MtuSize = ui32MtuSize;
         _ui8PlayloadType = ui8PlayloadType;
         _ui8Interleaved = ui8Interleaved;
@@ -145,6 +146,8 @@ protected:
     uint8_t _ui8Interleaved;
     uint16_t _ui16Sequence = 0;
     uint32_t _ui32TimeStamp = 0;
+    //毫秒转rtp时间戳的比例
+    StampScale _stampScale;
 };
 
 class RtpCodec : public RtpRing, public FrameRingInterfaceDelegate , public CodecInfo{
@@ -0,0 +1,243 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_RTPJITTERBUFFER_H
+#define ZLMEDIAKIT_RTPJITTERBUFFER_H
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+using namespace std;
+
+namespace mediakit {
+
+/**
+ * rtp排序缓存
+ * 采用2的幂次大小的环形数组，以seq & mask为下标，插入与输出都是O(1)；
+ * seq比较考虑16位回环，可以按包个数或者按时长限制缓存深度，
+ * 已经输出(或者被放弃等待)的序号之后才到达的包视为迟到包直接丢弃
+ * @tparam T rtp包类型，需要支持与nullptr比较
+ */
+template <typename T>
+class RtpJitterBuffer {
+public:
+    typedef function<void(const T &pkt)> onOutput;
+
+    /**
+     * @param maxCount 最多缓存的包个数
+     * @param maxDelayMS 最早的缓存包与最新包的最大时间戳差，单位毫秒，0代表不限制
+     */
+    RtpJitterBuffer(uint32_t maxCount = 64, uint32_t maxDelayMS = 0) {
+        setMaxSize(maxCount, maxDelayMS);
+    }
+    ~RtpJitterBuffer() {}
+
+    /**
+     * 设置缓存深度，缓存为空时才会调整环形数组大小
+     */
+    void setMaxSize(uint32_t maxCount, uint32_t maxDelayMS) {
+        _maxCount = maxCount ? maxCount : 1;
+        _maxDelayMS = maxDelayMS;
+        if (!_size && capacityOf(_maxCount) != _slots.size()) {
+            _slots.clear();
+        }
+    }
+
+    /**
+     * 输入rtp包，排好序的包通过cb输出
+     * @param seq rtp序号
+     * @param stamp 时间戳，单位毫秒
+     * @param pkt rtp包
+     * @param cb 输出回调
+     * @return false代表迟到或重复的包被丢弃
+     */
+    bool input(uint16_t seq, uint32_t stamp, const T &pkt, const onOutput &cb) {
+        if (_slots.empty()) {
+            _slots.resize(capacityOf(_maxCount));
+            _mask = _slots.size() - 1;
+        }
+        if (!_started) {
+            _started = true;
+            _nextSeq = seq;
+        }
+
+        int diff = (int16_t) (uint16_t) (seq - _nextSeq);
+        if (diff < 0) {
+            if (-diff <= (int) _slots.size()) {
+                //迟到包，它之后的包已经输出
+                ++_lateDropped;
+                return false;
+            }
+            //seq大幅回退，认为是流重新开始了
+            flush(cb);
+            _nextSeq = seq;
+            diff = 0;
+        } else if (diff >= (int) _slots.size()) {
+            //seq大幅前跳，超出了缓存窗口，输出所有缓存后从该包重新开始
+            flush(cb);
+            _nextSeq = seq;
+            diff = 0;
+        }
+
+        if (diff == 0 && !_size) {
+            //正确序列并且无缓存，直接输出
+            ++_nextSeq;
+            cb(pkt);
+            return true;
+        }
+
+        auto &slot = _slots[seq & _mask];
+        if (slot.pkt != nullptr) {
+            ++_duplicated;
+            return false;
+        }
+        slot.pkt = pkt;
+        slot.stamp = stamp;
+        ++_size;
+        popReady(cb);
+
+        //缓存过深，放弃等待丢失的包
+        while (_size && (_size >= _maxCount || isTooLate(stamp))) {
+            skipMissing(cb);
+        }
+        return true;
+    }
+
+    /**
+     * 按序输出所有缓存的包
+     */
+    void flush(const onOutput &cb) {
+        while (_size) {
+            skipMissing(cb);
+        }
+    }
+
+    /**
+     * 清空缓存，不输出
+     */
+    void clear() {
+        for (auto &slot : _slots) {
+            slot.pkt = nullptr;
+        }
+        _size = 0;
+        _started = false;
+    }
+
+    /**
+     * 当前缓存的包个数
+     */
+    uint32_t size() const {
+        return _size;
+    }
+
+    /**
+     * 迟到被丢弃的包个数
+     */
+    uint64_t getLateDropped() const {
+        return _lateDropped;
+    }
+
+    /**
+     * 放弃等待的丢失包个数
+     */
+    uint64_t getSkipped() const {
+        return _skipped;
+    }
+
+    /**
+     * 重复的包个数
+     */
+    uint64_t getDuplicated() const {
+        return _duplicated;
+    }
+private:
+    static uint32_t capacityOf(uint32_t maxCount) {
+        //多预留一倍，保证在缓存深度内的seq不会映射到同一个位置
+        uint32_t ret = 1;
+        while (ret < 2 * maxCount && ret < 0x8000) {
+            ret <<= 1;
+        }
+        return ret;
+    }
+
+    //输出从_nextSeq开始连续的包
+    void popReady(const onOutput &cb) {
+        while (_size) {
+            auto &slot = _slots[_nextSeq & _mask];
+            if (slot.pkt == nullptr) {
+                break;
+            }
+            T pkt = std::move(slot.pkt);
+            slot.pkt = nullptr;
+            --_size;
+            ++_nextSeq;
+            cb(pkt);
+        }
+    }
+
+    //跳过丢失的包，然后输出后续连续的包
+    void skipMissing(const onOutput &cb) {
+        while (_slots[_nextSeq & _mask].pkt == nullptr) {
+            ++_nextSeq;
+            ++_skipped;
+        }
+        popReady(cb);
+    }
+
+    //最早的缓存包是否已经等待过久
+    bool isTooLate(uint32_t stamp) const {
+        if (!_maxDelayMS) {
+            return false;
+        }
+        for (uint16_t seq = _nextSeq;; ++seq) {
+            auto &slot = _slots[seq & _mask];
+            if (slot.pkt != nullptr) {
+                return (int32_t) (stamp - slot.stamp) > (int32_t) _maxDelayMS;
+            }
+        }
+    }
+private:
+    class Slot {
+    public:
+        T pkt;
+        uint32_t stamp = 0;
+    };
+    vector<Slot> _slots;
+    uint32_t _mask = 0;
+    uint32_t _size = 0;
+    uint32_t _maxCount;
+    uint32_t _maxDelayMS;
+    bool _started = false;
+    uint16_t _nextSeq = 0;
+    uint64_t _lateDropped = 0;
+    uint64_t _skipped = 0;
+    uint64_t _duplicated = 0;
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_RTPJITTERBUFFER_H
@@ -27,11 +27,6 @@
 #include "Common/config.h"
 #include "RtpReceiver.h"
 
-#define POP_HEAD(trackidx) \
-		auto it = _rtp_sort_cache_map[trackidx].begin(); \
-		onRtpSorted(it->second, trackidx); \
-		_rtp_sort_cache_map[trackidx].erase(it);
-
 #define AV_RB16(x)                           \
     ((((const uint8_t*)(x))[0] << 8) |          \
       ((const uint8_t*)(x))[1])
@@ -44,42 +39,33 @@ RtpReceiver::RtpReceiver() {}
 RtpReceiver::~RtpReceiver() {}
 
 bool RtpReceiver::handleOneRtp(int track_index,SdpTrack::Ptr &track, unsigned char *rtp_raw_ptr, unsigned int rtp_raw_len) {
-    auto rtp_ptr = _rtp_pool.obtain();
-    auto &rtp = *rtp_ptr;
-    auto length = rtp_raw_len + 4;
-
-    rtp.interleaved = 2 * track->_type;
-    rtp.mark = rtp_raw_ptr[1] >> 7;
-    rtp.PT = rtp_raw_ptr[1] & 0x7F;
-    //序列号
-    memcpy(&rtp.sequence,rtp_raw_ptr+2,2);//内存对齐
-    rtp.sequence = ntohs(rtp.sequence);
-    //时间戳
-    memcpy(&rtp.timeStamp, rtp_raw_ptr+4, 4);//内存对齐
-
+    //先在接收缓存中原地解析并校验rtp头，校验通过后才从循环池获取对象并拷贝，
+    //这样非法包、ssrc不匹配的包不会占用循环池也不会产生拷贝
+    if(rtp_raw_len < 12){
+        WarnL << "rtp包长度过小:" << rtp_raw_len;
+        return false;
+    }
     if(!track->_samplerate){
         //无法把时间戳转换成毫秒
         return false;
     }
-    //时间戳转换成毫秒
-    rtp.timeStamp = ntohl(rtp.timeStamp) * 1000LL / track->_samplerate;
-    //ssrc
-    memcpy(&rtp.ssrc,rtp_raw_ptr+8,4);//内存对齐
-    rtp.ssrc = ntohl(rtp.ssrc);
-    rtp.type = track->_type;
 
-    if (track->_ssrc != rtp.ssrc) {
+    //ssrc
+    uint32_t ssrc;
+    memcpy(&ssrc,rtp_raw_ptr+8,4);//内存对齐
+    ssrc = ntohl(ssrc);
+    if (track->_ssrc != ssrc) {
         if (track->_ssrc == 0) {
             //保存SSRC至track对象
-            track->_ssrc = rtp.ssrc;
+            track->_ssrc = ssrc;
         }else{
             //ssrc错误
-            WarnL << "ssrc错误:" << rtp.ssrc << " != " << track->_ssrc;
+            WarnL << "ssrc错误:" << ssrc << " != " << track->_ssrc;
             if (_ssrc_err_count[track_index]++ > 10) {
                 //ssrc切换后清除老数据
-                WarnL << "ssrc更换:" << track->_ssrc << " -> " << rtp.ssrc;
-                _rtp_sort_cache_map[track_index].clear();
-                track->_ssrc = rtp.ssrc;
+                WarnL << "ssrc更换:" << track->_ssrc << " -> " << ssrc;
+                _jitter_buffer[track_index].clear();
+                track->_ssrc = ssrc;
             }
             return false;
         }
@@ -88,28 +74,50 @@ bool RtpReceiver::handleOneRtp(int track_index,SdpTrack::Ptr &track, unsigned ch
     //ssrc匹配正确，不匹配计数清零
     _ssrc_err_count[track_index] = 0;
 
-    //获取rtp中媒体数据偏移量
-    rtp.offset 	= 12 + 4;
-    int csrc     	= rtp_raw_ptr[0] & 0x0f;
-    int ext      	= rtp_raw_ptr[0] & 0x10;
-    rtp.offset 	+= 4 * csrc;
-    if (ext && rtp_raw_len >= rtp.offset) {
+    //获取rtp中媒体数据偏移量(不含4个字节的interleaved头)
+    unsigned int offset = 12;
+    int csrc = rtp_raw_ptr[0] & 0x0f;
+    int ext = rtp_raw_ptr[0] & 0x10;
+    offset += 4 * csrc;
+    if (ext && rtp_raw_len >= offset + 4) {
         /* calculate the header extension length (stored as number of 32-bit words) */
-        ext = (AV_RB16(rtp_raw_ptr + rtp.offset - 2) + 1) << 2;
-        rtp.offset += ext;
+        ext = (AV_RB16(rtp_raw_ptr + offset + 2) + 1) << 2;
+        offset += ext;
     }
 
-    if(length <= rtp.offset){
-        WarnL << "无有效负载的rtp包:" << length << "<=" << (int)rtp.offset;
+    if(rtp_raw_len <= offset){
+        WarnL << "无有效负载的rtp包:" << rtp_raw_len << "<=" << offset;
         return false;
     }
 
+    auto length = rtp_raw_len + 4;
     if(length > RTP_MAX_SIZE){
         WarnL << "超大的rtp包:" << length << ">" << RTP_MAX_SIZE;
         return false;
     }
 
-    //设置rtp负载长度
+    auto rtp_ptr = _rtp_pool.obtain();
+    auto &rtp = *rtp_ptr;
+    rtp.interleaved = 2 * track->_type;
+    rtp.mark = rtp_raw_ptr[1] >> 7;
+    rtp.PT = rtp_raw_ptr[1] & 0x7F;
+    //序列号
+    memcpy(&rtp.sequence,rtp_raw_ptr+2,2);//内存对齐
+    rtp.sequence = ntohs(rtp.sequence);
+    //时间戳
+    memcpy(&rtp.rtpStamp, rtp_raw_ptr+4, 4);//内存对齐
+    rtp.rtpStamp = ntohl(rtp.rtpStamp);
+    //统计丢包与到达间隔抖动，须在排序前统计
+    _rtcp_ctx[track_index].onRtp(rtp.sequence, rtp.rtpStamp, track->_samplerate);
+    //时间戳转换成毫秒，原始时间戳保留在rtpStamp中
+    auto &scale = _stamp_scale[track_index];
+    scale.setSampleRate(track->_samplerate);
+    rtp.timeStamp = scale.toMS(rtp.rtpStamp);
+    rtp.ssrc = ssrc;
+    rtp.type = track->_type;
+    rtp.offset = offset + 4;
+
+    //设置rtp负载长度，循环池中的对象容量足够时不会重新分配内存
     rtp.setCapacity(length);
     rtp.setSize(length);
     uint8_t *payload_ptr = (uint8_t *)rtp.data();
@@ -117,7 +125,7 @@ bool RtpReceiver::handleOneRtp(int track_index,SdpTrack::Ptr &track, unsigned ch
     payload_ptr[1] = rtp.interleaved;
     payload_ptr[2] = rtp_raw_len >> 8;
     payload_ptr[3] = (rtp_raw_len & 0x00FF);
-    //拷贝rtp负载
+    //一次性拷贝整个rtp包
     memcpy(payload_ptr + 4, rtp_raw_ptr, rtp_raw_len);
     //排序rtp
     sortRtp(rtp_ptr,track_index);
@@ -125,55 +133,44 @@ bool RtpReceiver::handleOneRtp(int track_index,SdpTrack::Ptr &track, unsigned ch
 }
 
 void RtpReceiver::sortRtp(const RtpPacket::Ptr &rtp,int track_index){
-    if(rtp->sequence != _last_seq[track_index] + 1 && _last_seq[track_index] != 0){
-        //包乱序或丢包
-        _seq_ok_count[track_index] = 0;
-        _sort_started[track_index] = true;
-        if(_last_seq[track_index] > rtp->sequence && _last_seq[track_index] - rtp->sequence > 0xFF){
-            //sequence回环，清空所有排序缓存
-            while (_rtp_sort_cache_map[track_index].size()) {
-                POP_HEAD(track_index)
-            }
-            ++_seq_cycle_count[track_index];
+    if(_stats){
+        //丢包数为扩展最大序号减去收到的包个数，乱序和重复的包不会被误计为丢包
+        auto lost = _rtcp_ctx[track_index].getTotalLost();
+        if(lost != _rtp_lost[track_index]){
+            _stats->addRtpLost(rtp->type, lost - _rtp_lost[track_index]);
+            _rtp_lost[track_index] = lost;
         }
-    }else{
-        //正确序列的包
-        _seq_ok_count[track_index]++;
     }
-
+    if(_last_seq[track_index] > rtp->sequence && _last_seq[track_index] - rtp->sequence > 0xFF){
+        //sequence回环
+        ++_seq_cycle_count[track_index];
+    }
     _last_seq[track_index] = rtp->sequence;
 
-    //开始排序缓存
-    if (_sort_started[track_index]) {
-        _rtp_sort_cache_map[track_index].emplace(rtp->sequence, rtp);
-        GET_CONFIG(uint32_t,clearCount,Rtp::kClearCount);
-        GET_CONFIG(uint32_t,maxRtpCount,Rtp::kMaxRtpCount);
-        if (_seq_ok_count[track_index] >= clearCount) {
-            //网络环境改善，需要清空排序缓存
-            _seq_ok_count[track_index] = 0;
-            _sort_started[track_index] = false;
-            while (_rtp_sort_cache_map[track_index].size()) {
-                POP_HEAD(track_index)
-            }
-        } else if (_rtp_sort_cache_map[track_index].size() >= maxRtpCount) {
-            //排序缓存溢出
-            POP_HEAD(track_index)
-        }
-    }else{
-        //正确序列
-        onRtpSorted(rtp, track_index);
+    //排序缓存，排好序的包回调onRtpSorted
+    GET_CONFIG(uint32_t,maxRtpCount,Rtp::kMaxRtpCount);
+    GET_CONFIG(uint32_t,maxJitterMS,Rtp::kMaxJitterMS);
+    auto &jitter_buffer = _jitter_buffer[track_index];
+    jitter_buffer.setMaxSize(maxRtpCount,maxJitterMS);
+    jitter_buffer.input(rtp->sequence,rtp->timeStamp,rtp,[this,track_index](const RtpPacket::Ptr &pkt){
+        onRtpSorted(pkt, track_index);
+    });
+
+    if(_stats){
+        _stats->setJitterSize(rtp->type, getJitterSize(track_index));
     }
 }
 
 void RtpReceiver::clear() {
     CLEAR_ARR(_last_seq)
     CLEAR_ARR(_ssrc_err_count)
-    CLEAR_ARR(_seq_ok_count)
-    CLEAR_ARR(_sort_started)
     CLEAR_ARR(_seq_cycle_count)
+    CLEAR_ARR(_rtp_lost)
 
-    _rtp_sort_cache_map[0].clear();
-    _rtp_sort_cache_map[1].clear();
+    _jitter_buffer[0].clear();
+    _jitter_buffer[1].clear();
+    _rtcp_ctx[0].clear();
+    _rtcp_ctx[1].clear();
 }
 
 void RtpReceiver::setPoolSize(int size) {
@@ -181,12 +178,20 @@ void RtpReceiver::setPoolSize(int size) {
 }
 
 int RtpReceiver::getJitterSize(int track_index){
-    return _rtp_sort_cache_map[track_index].size();
+    return _jitter_buffer[track_index].size();
 }
 
 int RtpReceiver::getCycleCount(int track_index){
     return _seq_cycle_count[track_index];
 }
 
+void RtpReceiver::setMediaStats(const MediaStats::Ptr &stats){
+    _stats = stats;
+}
+
+RtcpReceiverContext &RtpReceiver::getRtcpContext(int track_index){
+    return _rtcp_ctx[track_index];
+}
+
 
 }//namespace mediakit
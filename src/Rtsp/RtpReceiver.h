@@ -33,6 +33,9 @@
 #include <memory>
 #include "RtpCodec.h"
 #include "RtspMediaSource.h"
+#include "RtpJitterBuffer.h"
+#include "RtcpStats.h"
+#include "Common/MediaStats.h"
 
 using namespace std;
 using namespace toolkit;
@@ -65,6 +68,16 @@ protected:
     void setPoolSize(int size);
     int getJitterSize(int track_index);
     int getCycleCount(int track_index);
+
+    /**
+     * 设置实时统计，用于统计丢包与排序缓存深度
+     */
+    void setMediaStats(const MediaStats::Ptr &stats);
+
+    /**
+     * 获取rtp接收端统计，用于生成RR
+     */
+    RtcpReceiverContext &getRtcpContext(int track_index);
 private:
     void sortRtp(const RtpPacket::Ptr &rtp , int track_index);
 private:
@@ -72,16 +85,20 @@ private:
     uint32_t _ssrc_err_count[2] = { 0, 0 };
     //上次seq
     uint16_t _last_seq[2] = { 0 , 0 };
-    //seq连续次数计数
-    uint32_t _seq_ok_count[2] = { 0 , 0};
     //seq回环次数计数
     uint32_t _seq_cycle_count[2] = { 0 , 0};
-    //是否开始seq排序
-    bool _sort_started[2] = { 0 , 0};
     //rtp排序缓存，根据seq排序
-    map<uint16_t , RtpPacket::Ptr> _rtp_sort_cache_map[2];
+    RtpJitterBuffer<RtpPacket::Ptr> _jitter_buffer[2];
     //rtp循环池
     RtspMediaSource::PoolType _rtp_pool;
+    //实时统计
+    MediaStats::Ptr _stats;
+    //rtp接收端统计，在排序前更新
+    RtcpReceiverContext _rtcp_ctx[2];
+    //已经计入实时统计的丢包个数
+    int64_t _rtp_lost[2] = { 0, 0 };
+    //rtp时间戳转毫秒的比例
+    StampScale _stamp_scale[2];
 };
 
 }//namespace mediakit
@@ -0,0 +1,116 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "RtpRetransmitCache.h"
+
+namespace mediakit {
+
+RtpRetransmitCache::RtpRetransmitCache(uint32_t maxCount) {
+    uint32_t capacity = 1;
+    while (capacity < maxCount && capacity < 0x8000) {
+        capacity <<= 1;
+    }
+    _slots.resize(capacity);
+}
+
+void RtpRetransmitCache::popFront() {
+    _slots[_head & (_slots.size() - 1)] = nullptr;
+    ++_head;
+    --_span;
+}
+
+void RtpRetransmitCache::input(const RtpPacket::Ptr &pkt, uint32_t maxMS) {
+    lock_guard<mutex> lck(_mtx);
+    if (!maxMS) {
+        if (_span) {
+            _slots.assign(_slots.size(), nullptr);
+            _span = 0;
+        }
+        return;
+    }
+    auto mask = _slots.size() - 1;
+    uint16_t seq = pkt->sequence;
+    int16_t diff = seq - _last;
+    if (_span && diff <= 0) {
+        //重复或者回退的包，只更新窗口内的位置
+        if ((uint16_t) (seq - _head) < _span) {
+            _slots[seq & mask] = pkt;
+        }
+        return;
+    }
+    if (!_span || (uint32_t) diff >= _slots.size()) {
+        //首个包或者序号跳变，重新开始
+        _slots.assign(_slots.size(), nullptr);
+        _head = seq;
+        _span = 0;
+        diff = 1;
+    }
+    //先淘汰最早的包腾出位置，防止新包覆盖窗口内的位置
+    while (_span + diff > _slots.size()) {
+        popFront();
+    }
+    //序号空洞的位置清空
+    for (int i = 1; i < diff; ++i) {
+        _slots[(uint16_t) (_last + i) & mask] = nullptr;
+    }
+    _slots[seq & mask] = pkt;
+    _last = seq;
+    _span += diff;
+    //淘汰过期的包
+    while (_span > 1) {
+        auto &front = _slots[_head & mask];
+        if (front && (int32_t) (pkt->timeStamp - front->timeStamp) <= (int32_t) maxMS) {
+            break;
+        }
+        popFront();
+    }
+}
+
+RtpPacket::Ptr RtpRetransmitCache::find(uint16_t seq) {
+    lock_guard<mutex> lck(_mtx);
+    if ((uint16_t) (seq - _head) >= _span) {
+        return nullptr;
+    }
+    auto &pkt = _slots[seq & (_slots.size() - 1)];
+    if (!pkt || pkt->sequence != seq) {
+        return nullptr;
+    }
+    return pkt;
+}
+
+void RtpRetransmitCache::clear() {
+    lock_guard<mutex> lck(_mtx);
+    _slots.assign(_slots.size(), nullptr);
+    _span = 0;
+}
+
+uint32_t RtpRetransmitCache::size() {
+    lock_guard<mutex> lck(_mtx);
+    return _span;
+}
+
+}//namespace mediakit
@@ -0,0 +1,86 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ZLMEDIAKIT_RTPRETRANSMITCACHE_H
+#define ZLMEDIAKIT_RTPRETRANSMITCACHE_H
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include "Rtsp.h"
+
+using namespace std;
+
+namespace mediakit {
+
+/**
+ * rtp重传缓存
+ * 保存某个track最近一段时间内的rtp包，供所有播放器根据NACK重传，
+ * 采用以seq & mask为下标的环形数组，写入与查找都是O(1)；
+ * 缓存深度受时长和包个数双重限制，写入线程与查找线程不同，需要加锁
+ */
+class RtpRetransmitCache {
+public:
+    typedef std::shared_ptr<RtpRetransmitCache> Ptr;
+
+    /**
+     * @param maxCount 最多缓存的包个数，会向上取整为2的幂
+     */
+    RtpRetransmitCache(uint32_t maxCount = 4096);
+    ~RtpRetransmitCache() {}
+
+    /**
+     * 写入一个rtp包，须按序号顺序写入
+     * @param pkt rtp包
+     * @param maxMS 缓存时长，单位毫秒，0代表不缓存
+     */
+    void input(const RtpPacket::Ptr &pkt, uint32_t maxMS);
+
+    /**
+     * 查找某序号的rtp包，没有缓存时返回空
+     */
+    RtpPacket::Ptr find(uint16_t seq);
+
+    void clear();
+
+    /**
+     * 缓存中的包个数(包括序号空洞)
+     */
+    uint32_t size();
+private:
+    void popFront();
+private:
+    mutex _mtx;
+    vector<RtpPacket::Ptr> _slots;
+    uint16_t _head = 0;
+    uint16_t _last = 0;
+    //_head到_last之间的序号个数
+    uint32_t _span = 0;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_RTPRETRANSMITCACHE_H
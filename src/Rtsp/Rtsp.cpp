@@ -25,6 +25,7 @@
  */
 
 #include <stdlib.h>
+#include <time.h>
 #include "Rtsp.h"
 #include "Common/Parser.h"
 
@@ -164,5 +165,27 @@ vector<SdpTrack::Ptr> SdpParser::getAvailableTrack() const {
 	return ret;
 }
 
+//所有响应共用的Server头
+static const char s_serverHeader[] = "Server: " SERVER_NAME "(build in " __DATE__ " " __TIME__ ")\r\n";
+
+void makeRtspResponseHead(string &res, const string &res_code, const char *protocol, int cseq, const string &session, size_t reserve){
+	res.reserve(256 + reserve);
+	res.append(protocol).append(" ").append(res_code).append("\r\n");
+
+	char buf[64];
+	res.append("CSeq: ");
+	res.append(buf, snprintf(buf, sizeof(buf), "%d", cseq));
+	res.append("\r\n");
+	if(!session.empty()){
+		res.append("Session: ").append(session).append("\r\n");
+	}
+
+	res.append(s_serverHeader, sizeof(s_serverHeader) - 1);
+	time_t tt = time(NULL);
+	res.append("Date: ");
+	res.append(buf, strftime(buf, sizeof buf, "%a, %b %d %Y %H:%M:%S GMT", gmtime(&tt)));
+	res.append("\r\n");
+}
+
 }//namespace mediakit
 
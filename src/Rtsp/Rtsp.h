@@ -55,8 +55,10 @@ public:
 	uint8_t interleaved;
 	uint8_t PT;
 	bool mark;
-	//时间戳，单位毫秒
+	//时间戳，单位毫秒，由rtpStamp换算而来，用于排序、gop缓存与解复用
 	uint32_t timeStamp;
+	//rtp头中的原始时间戳，单位为采样率，转发时原样使用，不做任何换算
+	uint32_t rtpStamp;
 	uint16_t sequence;
 	uint32_t ssrc;
 	uint8_t offset;
@@ -105,6 +107,8 @@ public:
 	uint16_t _seq = 0;
 	//时间戳，单位毫秒
 	uint32_t _time_stamp = 0;
+	//rtp时间戳，单位为采样率
+	uint32_t _rtp_stamp = 0;
 };
 
 class SdpParser {
@@ -226,6 +230,17 @@ private:
 	_StrPrinter _printer;
 };
 
+/**
+ * 渲染rtsp响应的状态行以及所有响应共用的CSeq、Session、Server、Date头
+ * @param res 输出的响应
+ * @param res_code 状态码及描述，例如"200 OK"
+ * @param protocol 协议版本，例如"RTSP/1.0"
+ * @param cseq 请求的CSeq
+ * @param session 会话id，为空时不输出Session头
+ * @param reserve 除公共头外还需预留的长度
+ */
+void makeRtspResponseHead(string &res, const string &res_code, const char *protocol, int cseq, const string &session, size_t reserve = 0);
+
 } //namespace mediakit
 
 #endif //RTSP_RTSP_H_
@@ -30,11 +30,15 @@
 #include <mutex>
 #include <string>
 #include <memory>
+#include <vector>
 #include <functional>
 #include <unordered_map>
 #include "Common/config.h"
 #include "Common/MediaSource.h"
+#include "Common/GopCache.h"
 #include "RtpCodec.h"
+#include "RtpRetransmitCache.h"
+#include "RtspSdpCache.h"
 
 #include "Util/logger.h"
 #include "Util/RingBuffer.h"
@@ -48,11 +52,66 @@ using namespace toolkit;
 
 namespace mediakit {
 
+/**
+ * 一帧(同一track、同一时间戳)的所有rtp包
+ * 媒体源以帧为单位写入环形缓存，一帧只触发一次读取回调，播放器可以一次性发送整帧数据
+ * 写入环形缓存后不可再修改
+ */
+class RtpPacketBatch {
+public:
+	typedef std::shared_ptr<RtpPacketBatch> Ptr;
+	/**
+	 * @param keyPos 是否为关键帧的开始
+	 * @param counter 内存统计计数器，本对象销毁时扣除
+	 */
+	RtpPacketBatch(bool keyPos = false, const MemoryCounter::Ptr &counter = nullptr) : _keyPos(keyPos), _counter(counter){}
+	~RtpPacketBatch(){
+		if(_counter){
+			_counter->add(-(int64_t)_bytes);
+		}
+	}
+
+	void append(const RtpPacket::Ptr &rtp) {
+		_bytes += rtp->size();
+		_packets.emplace_back(rtp);
+		if(_counter){
+			_counter->add(rtp->size());
+		}
+	}
+
+	const vector<RtpPacket::Ptr> &getPackets() const {
+		return _packets;
+	}
+
+	const RtpPacket::Ptr &front() const {
+		return _packets.front();
+	}
+
+	/**
+	 * 所有rtp包的总字节数
+	 */
+	uint32_t size() const {
+		return _bytes;
+	}
+
+	/**
+	 * 是否为关键帧的开始
+	 */
+	bool keyPos() const {
+		return _keyPos;
+	}
+private:
+	vector<RtpPacket::Ptr> _packets;
+	uint32_t _bytes = 0;
+	bool _keyPos;
+	MemoryCounter::Ptr _counter;
+};
+
 class RtspMediaSource: public MediaSource , public RingDelegate<RtpPacket::Ptr> {
 public:
 	typedef ResourcePool<RtpPacket> PoolType;
 	typedef std::shared_ptr<RtspMediaSource> Ptr;
-	typedef RingBuffer<RtpPacket::Ptr> RingType;
+	typedef RingBuffer<RtpPacketBatch::Ptr> RingType;
 
 	RtspMediaSource(const string &strVhost,
 	                const string &strApp,
@@ -72,11 +131,72 @@ public:
         return _pRing ? _pRing->readerCount() : 0;
 	}
 
+	/**
+	 * 创建环形缓存读取器，开启gop缓存时同时返回gop缓存
+	 * 开启gop缓存时读取器不再使用环形缓存内的数据，调用者应先发送gop缓存，再用GopCacheFilter过滤重复的包
+	 * 先创建读取器再拷贝gop缓存，保证拷贝之后写入的包都能被该读取器收到；
+	 * 与flushBatch持有同一把锁，保证创建读取器与拷贝gop缓存之间不会写入新的包
+	 * @param poller 读取器所在线程，必须为当前线程
+	 * @param useBuf 是否需要之前缓存的数据
+	 * @param gop 返回gop缓存
+	 */
+	RingType::RingReader::Ptr attach(const EventPoller::Ptr &poller, bool useBuf, vector<RtpPacketBatch::Ptr> &gop) {
+		bool useGop = useBuf && GopCache<RtpPacketBatch::Ptr>::enabled();
+		lock_guard<recursive_mutex> lock(_mtxGop);
+		auto reader = _pRing->attach(poller, useBuf && !useGop);
+		if (useGop) {
+			getGopCache(gop);
+		}
+		return reader;
+	}
+
+	/**
+	 * 获取gop缓存的拷贝
+	 */
+	void getGopCache(vector<RtpPacketBatch::Ptr> &gop) {
+		lock_guard<recursive_mutex> lock(_mtxGop);
+		_gopCache.getCache(gop);
+	}
+
+	uint64_t getGopCacheBytes() override {
+		lock_guard<recursive_mutex> lock(_mtxGop);
+		return _gopCache.getBytes();
+	}
+
+	/**
+	 * 从重传缓存中查找rtp包，用于响应播放器的NACK
+	 * @param trackType track类型
+	 * @param seq rtp序号
+	 * @return 不在缓存中时返回空
+	 */
+	RtpPacket::Ptr getRetransmitPacket(TrackType trackType, uint16_t seq) {
+		if(trackType != TrackVideo && trackType != TrackAudio){
+			return nullptr;
+		}
+		return _retransmitCache[trackType].find(seq);
+	}
+
+	/**
+	 * 清空gop缓存，在停止写入数据时调用，防止新的播放器收到过期的gop
+	 */
+	void clearGopCache() {
+		lock_guard<recursive_mutex> lock(_mtxGop);
+		_gopCache.clear();
+	}
+
     const string& getSdp() const {
 		//获取该源的媒体描述信息
 		return _strSdp;
 	}
 
+	/**
+	 * 获取预先渲染的DESCRIBE响应模板，可以在任意线程调用
+	 * @return 还未设置sdp时返回空
+	 */
+	RtspSdpCache::Ptr getSdpCache() const {
+		return std::atomic_load(&_sdpCache);
+	}
+
 	virtual uint32_t getSsrc(TrackType trackType) {
 		auto track = _sdpParser.getTrack(trackType);
 		if(!track){
@@ -84,6 +204,16 @@ public:
 		}
 		return track->_ssrc;
 	}
+	/**
+	 * 获取某track最新的rtp时间戳，单位为采样率
+	 */
+	virtual uint32_t getRtpStamp(TrackType trackType) {
+		auto track = _sdpParser.getTrack(trackType);
+		if(!track){
+			return 0;
+		}
+		return track->_rtp_stamp;
+	}
 	virtual uint16_t getSeqence(TrackType trackType) {
 		auto track = _sdpParser.getTrack(trackType);
 		if(!track){
@@ -112,10 +242,25 @@ public:
 		}
 	}
 
+	/**
+	 * 不打包rtp时更新track的时间戳，seq在打包暂停期间不增长，无需更新
+	 * @param trackType track类型
+	 * @param stamp 毫秒时间戳
+	 */
+	void updateStamp(TrackType trackType, uint32_t stamp) {
+		auto track = _sdpParser.getTrack(trackType);
+		if(track){
+			track->_time_stamp = stamp;
+			track->_rtp_stamp = StampScale(track->_samplerate).fromMS(stamp);
+		}
+	}
+
 	virtual void onGetSDP(const string& sdp) {
 		//派生类设置该媒体源媒体描述信息
 		_strSdp = sdp;
 		_sdpParser.load(sdp);
+		//播放器在其他线程中读取模板，替换整个只读对象
+		std::atomic_store(&_sdpCache, RtspSdpCache::Ptr(std::make_shared<RtspSdpCache>(sdp)));
 		if(_pRing){
             regist();
 		}
@@ -126,15 +271,23 @@ public:
 		if(track){
 			track->_seq = rtppt->sequence;
 			track->_time_stamp = rtppt->timeStamp;
+			track->_rtp_stamp = rtppt->rtpStamp;
 			track->_ssrc = rtppt->ssrc;
 		}
+		if(rtppt->type == TrackVideo || rtppt->type == TrackAudio){
+			//所有播放器共用的重传缓存
+			GET_CONFIG(uint32_t,nackCacheMS,Rtp::kNackCacheMS);
+			_retransmitCache[rtppt->type].input(rtppt, nackCacheMS);
+		}
 		if(!_pRing){
 		    weak_ptr<RtspMediaSource> weakSelf = dynamic_pointer_cast<RtspMediaSource>(shared_from_this());
-            _pRing = std::make_shared<RingType>(_ringSize,[weakSelf](const EventPoller::Ptr &,int size,bool){
+            _pRing = std::make_shared<RingType>(_ringSize,[weakSelf](const EventPoller::Ptr &poller,int size,bool){
                 auto strongSelf = weakSelf.lock();
                 if(!strongSelf){
                     return;
                 }
+                //size为该线程上的观看者个数，环形缓存按线程分发，每个线程一个分发器
+                strongSelf->onPollerReaderChanged(poller,size);
                 strongSelf->onReaderChanged(size);
             });
             onReaderChanged(0);
@@ -142,10 +295,40 @@ public:
                 regist();
             }
 		}
-		_pRing->write(rtppt,keyPos);
+		if(keyPos){
+			//多slice的IDR帧每个slice的首包都会标记为关键帧，只有一帧的第一个slice才是gop的开始，否则gop缓存会在帧中间被清空
+			keyPos = !_haveKeyStamp || _lastKeyStamp != rtppt->timeStamp;
+			_haveKeyStamp = true;
+			_lastKeyStamp = rtppt->timeStamp;
+		}
+		if(_batch){
+			auto &front = _batch->front();
+			if(keyPos || front->type != rtppt->type || front->timeStamp != rtppt->timeStamp){
+				//新的一帧开始
+				flushBatch();
+			}
+		}
+		if(!_batch){
+			_batch = std::make_shared<RtpPacketBatch>(keyPos, _memoryCounter);
+		}
+		_batch->append(rtppt);
+		if(rtppt->mark){
+			//mark位代表一帧结束，立即写入环形缓存
+			flushBatch();
+		}
         checkNoneReader();
 	}
 private:
+	void flushBatch(){
+		RtpPacketBatch::Ptr batch;
+		batch.swap(_batch);
+		//写入gop缓存与环形缓存须在同一把锁内完成，防止与attach交错
+		//环形缓存可能同步回调本线程的读取器，读取器中可能再获取gop缓存，所以使用递归锁
+		lock_guard<recursive_mutex> lock(_mtxGop);
+		_gopCache.input(batch, batch->keyPos());
+		_pRing->write(batch,batch->keyPos());
+	}
+
     void onReaderChanged(int size){
 	    //我们记录最后一次活动时间
         _readerTicker.resetTime();
@@ -167,10 +350,20 @@ private:
 protected:
 	SdpParser _sdpParser;
     string _strSdp; //媒体描述信息
+    RtspSdpCache::Ptr _sdpCache; //DESCRIBE响应模板
     RingType::Ptr _pRing; //rtp环形缓冲
     int _ringSize;
     Ticker _readerTicker;
     bool _asyncEmitNoneReader = false;
+    recursive_mutex _mtxGop;
+    GopCache<RtpPacketBatch::Ptr> _gopCache;
+    //正在合并的一帧rtp包
+    RtpPacketBatch::Ptr _batch;
+    //最近一个关键帧的时间戳
+    bool _haveKeyStamp = false;
+    uint32_t _lastKeyStamp = 0;
+    //NACK重传缓存，下标为TrackType
+    RtpRetransmitCache _retransmitCache[2];
 };
 
 } /* namespace mediakit */
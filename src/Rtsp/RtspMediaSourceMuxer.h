@@ -51,9 +51,30 @@ public:
     int readerCount() const{
         return _mediaSouce->readerCount();
     }
+    void setStats(const MediaStats::Ptr &stats){
+        _mediaSouce->setStats(stats);
+    }
     void setTimeStamp(uint32_t stamp){
         _mediaSouce->setTimeStamp(stamp);
     }
+    /**
+     * 暂停打包期间更新媒体源的时间戳，使得恢复前收到的PLAY请求的RTP-Info与恢复后的第一个包一致
+     */
+    void updateStamp(const Frame::Ptr &frame){
+        _mediaSouce->updateStamp(frame->getTrackType(), frame->stamp());
+    }
+    /**
+     * 媒体源是否已经开始写入数据(开始写入后才会注册)
+     */
+    bool isStarted() const{
+        return (bool)_mediaSouce->getRing();
+    }
+    /**
+     * 暂停打包时清空缓存
+     */
+    void clearCache(){
+        _mediaSouce->clearGopCache();
+    }
 private:
     void onAllTrackReady() override {
         _mediaSouce->onGetSDP(getSdp());
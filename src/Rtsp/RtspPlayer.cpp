@@ -32,6 +32,7 @@
 
 #include "Common/config.h"
 #include "RtspPlayer.h"
+#include "RtcpParser.h"
 #include "Util/MD5.h"
 #include "Util/mini.h"
 #include "Util/util.h"
@@ -450,7 +451,7 @@ void RtspPlayer::handleResPAUSE(const Parser& parser, bool bPause) {
                 auto strRtpTime = FindField(strTrack.data(), "rtptime=", ";");
                 auto idx = getTrackIndexByControlSuffix(strControlSuffix);
                 if(idx != -1){
-                    _aiFistStamp[idx] = atoll(strRtpTime.data()) * 1000 / _aTrackInfo[idx]->_samplerate;
+                    _aiFistStamp[idx] = StampScale(_aTrackInfo[idx]->_samplerate).toMS((uint32_t)atoll(strRtpTime.data()));
                     _aiNowStamp[idx] = _aiFistStamp[idx];
                     DebugL << "rtptime(ms):" << strControlSuffix <<" " << strRtpTime;
                 }
@@ -493,7 +494,17 @@ void RtspPlayer::onRtpPacket(const char *data, uint64_t len) {
 }
 
 void RtspPlayer::onRtcpPacket(int iTrackidx, SdpTrack::Ptr &track, unsigned char *pucData, unsigned int uiLen){
-
+    RtcpParser::forEach(pucData, uiLen, [&](uint8_t pt, uint8_t fmt, const uint8_t *data, size_t len){
+        uint32_t ssrc, ntpMiddle32;
+        if(pt != RTCP_SR || !RtcpParser::parseSenderReport(data, len, ssrc, ntpMiddle32)){
+            return;
+        }
+        if(track->_ssrc && ssrc != track->_ssrc){
+            return;
+        }
+        //记录SR，RR中的LSR、DLSR字段用于服务器计算往返时延
+        getRtcpContext(iTrackidx).onSenderReport(ntpMiddle32);
+    });
 }
 
 
@@ -560,7 +571,18 @@ void RtspPlayer::sendReceiverReport(bool overTcp,int iTrackIndex){
     uint8_t aui8Rtcp[4 + 32 + 10 + sizeof(s_cname) + 1] = {0};
     uint8_t *pui8Rtcp_RR = aui8Rtcp + 4, *pui8Rtcp_SDES = pui8Rtcp_RR + 32;
     auto &track = _aTrackInfo[iTrackIndex];
-    auto &counter = _aRtcpCnt[iTrackIndex];
+
+    uint8_t fractionLost;
+    int32_t totalLost;
+    uint32_t extHighestSeq, jitter, lsr, dlsr;
+    auto &ctx = getRtcpContext(iTrackIndex);
+    if(!ctx.makeReport(fractionLost, totalLost, extHighestSeq, jitter, lsr, dlsr)){
+        return;
+    }
+    if(_rtcpStats){
+        //拉流端无法计算往返时延(需要对端发送RR)
+        _rtcpStats->onReport(track->_type, fractionLost, totalLost, ctx.getJitterMS(), -1);
+    }
 
     aui8Rtcp[0] = '$';
     aui8Rtcp[1] = track->_interleaved + 1;
@@ -579,27 +601,21 @@ void RtspPlayer::sendReceiverReport(bool overTcp,int iTrackIndex){
     // server SSRC
     memcpy(&pui8Rtcp_RR[8], &ssrc, 4);
 
-    //FIXME: 8 bits of fraction, 24 bits of total packets lost
-    pui8Rtcp_RR[12] = 0x00;
-    pui8Rtcp_RR[13] = 0x00;
-    pui8Rtcp_RR[14] = 0x00;
-    pui8Rtcp_RR[15] = 0x00;
-
-    //FIXME: max sequence received
-    int cycleCount = getCycleCount(iTrackIndex);
-    pui8Rtcp_RR[16] = cycleCount >> 8;
-    pui8Rtcp_RR[17] = cycleCount & 0xFF;
-    pui8Rtcp_RR[18] = counter.pktCnt >> 8;
-    pui8Rtcp_RR[19] = counter.pktCnt & 0xFF;
-
-    uint32_t  jitter = htonl(getJitterSize(iTrackIndex));
-    //FIXME: jitter
+    // 8 bits of fraction, 24 bits of total packets lost
+    uint32_t lost = htonl(((uint32_t)fractionLost << 24) | ((uint32_t)totalLost & 0xFFFFFF));
+    memcpy(pui8Rtcp_RR + 12, &lost, 4);
+    // max sequence received
+    extHighestSeq = htonl(extHighestSeq);
+    memcpy(pui8Rtcp_RR + 16, &extHighestSeq, 4);
+    // jitter
+    jitter = htonl(jitter);
     memcpy(pui8Rtcp_RR + 20, &jitter , 4);
     /* last SR timestamp */
-    memcpy(pui8Rtcp_RR + 24, &counter.lastTimeStamp, 4);
-    uint32_t msInc = htonl(ntohl(counter.timeStamp) - ntohl(counter.lastTimeStamp));
+    lsr = htonl(lsr);
+    memcpy(pui8Rtcp_RR + 24, &lsr, 4);
     /* delay since last SR */
-    memcpy(pui8Rtcp_RR + 28, &msInc, 4);
+    dlsr = htonl(dlsr);
+    memcpy(pui8Rtcp_RR + 28, &dlsr, 4);
 
     // CNAME
     pui8Rtcp_SDES[0] = 0x81;
@@ -742,18 +758,11 @@ void RtspPlayer::onRecvRTP_l(const RtpPacket::Ptr &pkt, const SdpTrack::Ptr &tra
     if(iTrackIndex == -1){
         return;
     }
-    RtcpCounter &counter = _aRtcpCnt[iTrackIndex];
-    counter.pktCnt = pkt->sequence;
     auto &ticker = _aRtcpTicker[iTrackIndex];
     if (ticker.elapsedTime() > 5 * 1000) {
         //send rtcp every 5 second
-        counter.lastTimeStamp = counter.timeStamp;
-        //直接保存网络字节序
-        memcpy(&counter.timeStamp, pkt->data() + 8 , 4);
-        if(counter.lastTimeStamp != 0){
-            sendReceiverReport(_eType == Rtsp::RTP_TCP,iTrackIndex);
-            ticker.resetTime();
-        }
+        ticker.resetTime();
+        sendReceiverReport(_eType == Rtsp::RTP_TCP,iTrackIndex);
     }
 
 
@@ -57,6 +57,12 @@ public:
 	void pause(bool bPause) override;
 	void teardown() override;
 	float getPacketLossRate(TrackType type) const override;
+	void setMediaStats(const MediaStats::Ptr &stats) override {
+		RtpReceiver::setMediaStats(stats);
+	}
+	void setRtcpStats(const RtcpStats::Ptr &stats) override {
+		_rtcpStats = stats;
+	}
 protected:
 	//派生类回调函数
 	virtual bool onCheckSDP(const string &strSdp, const SdpParser &parser) = 0;
@@ -156,8 +162,8 @@ private:
 	uint32_t _aiNowStamp[2] = {0,0};
 
 	//rtcp相关
-    RtcpCounter _aRtcpCnt[2]; //rtcp统计,trackid idx 为数组下标
     Ticker _aRtcpTicker[2]; //rtcp发送时间,trackid idx 为数组下标
+    RtcpStats::Ptr _rtcpStats; //RR统计，可为空
 };
 
 } /* namespace mediakit */
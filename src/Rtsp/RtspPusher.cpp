@@ -366,12 +366,14 @@ void RtspPusher::sendRecord() {
 
         _pRtspReader = src->getRing()->attach(getPoller());
         weak_ptr<RtspPusher> weakSelf = dynamic_pointer_cast<RtspPusher>(shared_from_this());
-        _pRtspReader->setReadCB([weakSelf](const RtpPacket::Ptr &pkt){
+        _pRtspReader->setReadCB([weakSelf](const RtpPacketBatch::Ptr &batch){
             auto strongSelf = weakSelf.lock();
             if(!strongSelf) {
                 return;
             }
-            strongSelf->sendRtpPacket(pkt);
+            for(auto &pkt : batch->getPackets()){
+                strongSelf->sendRtpPacket(pkt);
+            }
         });
         _pRtspReader->setDetachCB([weakSelf](){
             auto strongSelf = weakSelf.lock();
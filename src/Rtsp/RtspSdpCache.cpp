@@ -0,0 +1,113 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "RtspSdpCache.h"
+#include "Common/config.h"
+#include "Util/util.h"
+
+using namespace toolkit;
+
+namespace mediakit {
+
+static const string s_empty;
+
+static string makeDescribeTail(const string &sdp) {
+    string ret = StrPrinter << "Content-Length: " << sdp.size() << "\r\n"
+                            << "Content-Type: application/sdp\r\n"
+                            << "\r\n";
+    ret.append(sdp);
+    return ret;
+}
+
+RtspSdpCache::RtspSdpCache(const string &sdp) : _sdp(sdp) {
+    GET_CONFIG(uint32_t, nackCacheMS, Rtp::kNackCacheMS);
+    _nack = nackCacheMS != 0;
+    _describeSdp = addNackFeedback(sdp);
+    _describeTail = makeDescribeTail(_describeSdp);
+    _tracks = SdpParser(sdp).getAvailableTrack();
+}
+
+const string &RtspSdpCache::getDescribeTail() const {
+    GET_CONFIG(uint32_t, nackCacheMS, Rtp::kNackCacheMS);
+    if ((nackCacheMS != 0) != _nack) {
+        return s_empty;
+    }
+    return _describeTail;
+}
+
+void RtspSdpCache::renderDescribeResponse(string &res, int cseq, const string &session, const string &contentBase) const {
+    makeRtspResponseHead(res, "200 OK", "RTSP/1.0", cseq, session, getDescribeTail().size() + contentBase.size());
+    appendDescribeResponse(res, contentBase);
+}
+
+void RtspSdpCache::appendDescribeResponse(string &res, const string &contentBase) const {
+    res.append("Content-Base: ").append(contentBase).append("/\r\n");
+    res.append("x-Accept-Retransmit: our-retransmit\r\n"
+               "x-Accept-Dynamic-Rate: 1\r\n");
+    auto &tail = getDescribeTail();
+    if (tail.empty()) {
+        //模板生成后修改了NACK配置，重新渲染
+        res.append(makeDescribeTail(addNackFeedback(_sdp)));
+        return;
+    }
+    res.append(tail);
+}
+
+vector<SdpTrack::Ptr> RtspSdpCache::cloneTracks() const {
+    vector<SdpTrack::Ptr> ret;
+    ret.reserve(_tracks.size());
+    for (auto &track : _tracks) {
+        ret.emplace_back(std::make_shared<SdpTrack>(*track));
+    }
+    return ret;
+}
+
+string RtspSdpCache::addNackFeedback(const string &sdp) {
+    GET_CONFIG(uint32_t, nackCacheMS, Rtp::kNackCacheMS);
+    if (!nackCacheMS || sdp.find("a=rtcp-fb:") != string::npos) {
+        return sdp;
+    }
+    string ret;
+    ret.reserve(sdp.size() + 64);
+    size_t pos = 0;
+    while (pos < sdp.size()) {
+        auto end = sdp.find('\n', pos);
+        end = (end == string::npos) ? sdp.size() : end + 1;
+        ret.append(sdp, pos, end - pos);
+        if (sdp.compare(pos, 9, "a=rtpmap:") == 0) {
+            auto pt = atoi(sdp.data() + pos + 9);
+            if (ret.back() != '\n') {
+                ret.append("\r\n");
+            }
+            ret.append(StrPrinter << "a=rtcp-fb:" << pt << " nack\r\n");
+        }
+        pos = end;
+    }
+    return ret;
+}
+
+}//namespace mediakit
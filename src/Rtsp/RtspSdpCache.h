@@ -0,0 +1,106 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ZLMEDIAKIT_RTSPSDPCACHE_H
+#define ZLMEDIAKIT_RTSPSDPCACHE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Rtsp.h"
+
+using namespace std;
+
+namespace mediakit {
+
+/**
+ * 预先渲染的DESCRIBE响应模板
+ * 媒体源每次设置sdp时生成一份新的只读模板，所有播放器共享；
+ * DESCRIBE时无需再解析sdp、追加NACK反馈属性或格式化Content-Length，
+ * 只需拷贝track并在状态行与会话相关的头后追加模板尾部
+ */
+class RtspSdpCache {
+public:
+    typedef std::shared_ptr<const RtspSdpCache> Ptr;
+
+    /**
+     * 生成模板
+     * @param sdp 媒体源的sdp
+     */
+    RtspSdpCache(const string &sdp);
+    ~RtspSdpCache() {}
+
+    /**
+     * 获取原始sdp
+     */
+    const string &getSdp() const {
+        return _sdp;
+    }
+
+    /**
+     * 获取DESCRIBE响应的sdp(开启NACK重传时带有a=rtcp-fb属性)
+     */
+    const string &getDescribeSdp() const {
+        return _describeSdp;
+    }
+
+    /**
+     * 获取DESCRIBE响应的尾部，包括Content-Type、Content-Length头、空行以及sdp
+     * 模板生成后rtp.nackCacheMS配置发生变化时返回空，调用者应重新渲染
+     */
+    const string &getDescribeTail() const;
+
+    /**
+     * 渲染完整的DESCRIBE响应，状态行与公共头由makeRtspResponseHead生成，其余部分由模板拷贝
+     * @param res 输出的响应
+     * @param cseq 请求的CSeq
+     * @param session 会话id，为空时不输出Session头
+     * @param contentBase 请求的url
+     */
+    void renderDescribeResponse(string &res, int cseq, const string &session, const string &contentBase) const;
+
+    /**
+     * 拷贝一份可用的track，每个会话都需要独立修改track的状态
+     */
+    vector<SdpTrack::Ptr> cloneTracks() const;
+
+    /**
+     * 开启NACK重传时在每个a=rtpmap后追加a=rtcp-fb:<pt> nack，告知播放器可以发送NACK
+     */
+    static string addNackFeedback(const string &sdp);
+private:
+    void appendDescribeResponse(string &res, const string &contentBase) const;
+private:
+    bool _nack;
+    string _sdp;
+    string _describeSdp;
+    string _describeTail;
+    vector<SdpTrack::Ptr> _tracks;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_RTSPSDPCACHE_H
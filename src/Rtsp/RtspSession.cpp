@@ -27,7 +27,13 @@
 #include <atomic>
 #include <iomanip>
 #include "Common/config.h"
+#include "Common/MemoryCounter.h"
+#include "Common/TcpGatherSender.h"
 #include "UDPServer.h"
+#include "UdpBatchSender.h"
+#include "RtspUdpMux.h"
+#include "RtcpParser.h"
+#include "RtspSdpCache.h"
 #include "RtspSession.h"
 #include "Util/mini.h"
 #include "Util/MD5.h"
@@ -35,9 +41,11 @@
 #include "Util/onceToken.h"
 #include "Util/TimeTicker.h"
 #include "Util/NoticeCenter.h"
+#include "Util/uv_errno.h"
 #include "Network/sockutil.h"
 
-#define RTSP_SERVER_SEND_RTCP 0
+//SR发送间隔，单位毫秒
+#define RTSP_SERVER_SR_INTERVAL_MS (5 * 1000)
 
 using namespace std;
 using namespace toolkit;
@@ -91,6 +99,10 @@ void RtspSession::onError(const SockException& err) {
 		//取消UDP端口监听
 		UDPServer::Instance().stopListenPeer(get_peer_ip().data(), this);
 	}
+	if (_muxRtpSock) {
+		//取消复用端口监听
+		RtspUdpMux::Instance().stopListen(this);
+	}
 
 	if (_http_x_sessioncookie.size() != 0) {
 		//移除http getter的弱引用记录
@@ -190,13 +202,13 @@ void RtspSession::onWholeRtspPacket(Parser &parser) {
 }
 
 void RtspSession::onRtpPacket(const char *data, uint64_t len) {
-	if(!_pushSrc){
-		return;
-	}
-
 	int trackIdx = -1;
 	uint8_t interleaved = data[1];
 	if(interleaved %2 == 0){
+		if(!_pushSrc){
+			//播放器只会发送rtcp
+			return;
+		}
 		trackIdx = getTrackIndexByInterleaved(interleaved);
         if (trackIdx != -1) {
             handleOneRtp(trackIdx,_aTrackInfo[trackIdx],(unsigned char *)data + 4, len - 4);
@@ -209,9 +221,65 @@ void RtspSession::onRtpPacket(const char *data, uint64_t len) {
 	}
 }
 
+//每秒最多重传的rtp包个数，防止恶意NACK放大流量
+#define RTCP_NACK_MAX_PER_SECOND 2000
+
 void RtspSession::onRtcpPacket(int iTrackidx, SdpTrack::Ptr &track, unsigned char *pucData, unsigned int uiLen){
+	auto pMediaSrc = _pMediaSrc.lock();
+	RtcpParser::forEach(pucData, uiLen, [&](uint8_t pt, uint8_t fmt, const uint8_t *data, size_t len){
+		if(pt == RTCP_RR || pt == RTCP_SR){
+			onRecvReceiverReport(track, data, len);
+			return;
+		}
+		if(pt != RTCP_RTPFB || fmt != 1 || _rtpType != Rtsp::RTP_UDP || !pMediaSrc){
+			//只有udp方式的播放器需要重传
+			return;
+		}
+		uint32_t ssrc;
+		vector<uint16_t> seqs;
+		if(!RtcpParser::parseNack(data, len, ssrc, seqs) || (ssrc && ssrc != track->_ssrc)){
+			return;
+		}
+		if(_nackTicker.elapsedTime() > 1000){
+			_nackTicker.resetTime();
+			_nackCountInSecond = 0;
+		}
+		uint32_t retransmitted = 0;
+		uint32_t missed = 0;
+		for(auto seq : seqs){
+			if(_nackCountInSecond >= RTCP_NACK_MAX_PER_SECOND){
+				break;
+			}
+			auto pkt = pMediaSrc->getRetransmitPacket(track->_type, seq);
+			if(!pkt){
+				//已经过期
+				++missed;
+				continue;
+			}
+			++_nackCountInSecond;
+			++retransmitted;
+			sendRtpPacket(pkt);
+		}
+		_rtcpStats->addNack(retransmitted, missed);
+	});
+}
 
+void RtspSession::onRecvReceiverReport(const SdpTrack::Ptr &track, const uint8_t *data, size_t len){
+	vector<RtcpReportBlock> blocks;
+	if(!RtcpParser::parseReportBlocks(data, len, blocks)){
+		return;
+	}
+	for(auto &block : blocks){
+		if(block.ssrc != track->_ssrc){
+			//不是关于本track的报告
+			continue;
+		}
+		uint32_t jitterMS = track->_samplerate ? (uint64_t)block.jitter * 1000 / track->_samplerate : 0;
+		_rtcpStats->onReport(track->_type, block.fractionLost, block.totalLost, jitterMS,
+							 RtcpParser::getRttMS(block.lsr, block.dlsr));
+	}
 }
+
 int64_t RtspSession::getContentLength(Parser &parser) {
 	if(parser.Method() == "POST"){
 		//http post请求的content数据部分是base64编码后的rtsp请求信令包
@@ -242,6 +310,17 @@ void RtspSession::handleReq_ANNOUNCE(const Parser &parser) {
 		throw SockException(Err_shutdown,err);
 	}
 
+	if(MemoryCounter::isOverBudget()){
+		//媒体数据内存超过预算，拒绝新的推流
+		sendRtspResponse("503 Service Unavailable", {"Content-Type", "text/plain"}, "Media memory budget exceeded.");
+		string err = StrPrinter << "ANNOUNCE:"
+								<< "Media memory budget exceeded:"
+								<< _mediaInfo._vhost << " "
+								<< _mediaInfo._app << " "
+								<< _mediaInfo._streamid << endl;
+		throw SockException(Err_shutdown,err);
+	}
+
 	_strSession = makeRandStr(12);
     _strSdp = parser.Content();
     _aTrackInfo = SdpParser(_strSdp).getAvailableTrack();
@@ -249,6 +328,7 @@ void RtspSession::handleReq_ANNOUNCE(const Parser &parser) {
 	_pushSrc = std::make_shared<RtspToRtmpMediaSource>(_mediaInfo._vhost,_mediaInfo._app,_mediaInfo._streamid);
 	_pushSrc->setListener(dynamic_pointer_cast<MediaSourceEvent>(shared_from_this()));
 	_pushSrc->onGetSDP(_strSdp);
+	setMediaStats(_pushSrc->getStats());
 	sendRtspResponse("200 OK");
 }
 
@@ -361,10 +441,11 @@ void RtspSession::onAuthSuccess() {
             strongSelf->shutdown(SockException(Err_shutdown,err));
             return;
         }
-        //找到了响应的rtsp流
-        strongSelf->_strSdp = rtsp_src->getSdp();
-        SdpParser sdpParser(strongSelf->_strSdp);
-        strongSelf->_aTrackInfo = sdpParser.getAvailableTrack();
+        //找到了响应的rtsp流，使用预先渲染的模板，无需再解析sdp
+        auto sdpCache = rtsp_src->getSdpCache();
+        if (sdpCache) {
+            strongSelf->_aTrackInfo = sdpCache->cloneTracks();
+        }
         if (strongSelf->_aTrackInfo.empty()) {
             //该流无效
             strongSelf->send_StreamNotFound();
@@ -376,14 +457,10 @@ void RtspSession::onAuthSuccess() {
         for(auto &track : strongSelf->_aTrackInfo){
             track->_ssrc = rtsp_src->getSsrc(track->_type);
             track->_seq = rtsp_src->getSeqence(track->_type);
-            track->_time_stamp = rtsp_src->getTimeStamp(track->_type);
+            track->_rtp_stamp = rtsp_src->getRtpStamp(track->_type);
         }
 
-        strongSelf->sendRtspResponse("200 OK",
-                                     {"Content-Base",strongSelf->_strContentBase + "/",
-                                      "x-Accept-Retransmit","our-retransmit",
-                                      "x-Accept-Dynamic-Rate","1"
-                                     },strongSelf->_strSdp);
+        strongSelf->sendDescribeResponse(sdpCache);
     });
 }
 void RtspSession::onAuthFailed(const string &realm,const string &why,bool close) {
@@ -570,6 +647,27 @@ inline void RtspSession::send_SessionNotFound() {
 	sendRtspResponse("454 Session Not Found",{"Connection","Close"});
 }
 
+static struct sockaddr_in makePeerAddr(const string &ip, uint16_t port){
+	struct sockaddr_in peerAddr;
+	peerAddr.sin_family = AF_INET;
+	peerAddr.sin_port = htons(port);
+	peerAddr.sin_addr.s_addr = inet_addr(ip.data());
+	bzero(&(peerAddr.sin_zero), sizeof peerAddr.sin_zero);
+	return peerAddr;
+}
+
+bool RtspSession::openUdpMux() {
+	auto pSockRtp = RtspUdpMux::Instance().getSock(getPoller(),false);
+	auto pSockRtcp = RtspUdpMux::Instance().getSock(getPoller(),true);
+	if(!pSockRtp || !pSockRtcp){
+		//未开启端口复用或者绑定失败，每个会话单独分配端口
+		return false;
+	}
+	_muxRtpSock = pSockRtp;
+	_muxRtcpSock = pSockRtcp;
+	return true;
+}
+
 void RtspSession::handleReq_Setup(const Parser &parser) {
 //处理setup命令，该函数可能进入多次
     auto controlSuffix = split(parser.Url(),"/").back();// parser.FullUrl().substr(_strContentBase.size());
@@ -627,40 +725,58 @@ void RtspSession::handleReq_Setup(const Parser &parser) {
 	}
 		break;
 	case Rtsp::RTP_UDP: {
+		//设置客户端内网端口信息
+		string strClientPort = FindField(parser["Transport"].data(), "client_port=", NULL);
+		uint16_t ui16RtpPort = atoi( FindField(strClientPort.data(), NULL, "-").data());
+        uint16_t ui16RtcpPort = atoi( FindField(strClientPort.data(), "-" , NULL).data());
+        //rtp/rtcp发送目标地址
+        _aPeerRtpAddr[trackIdx] = makePeerAddr(get_peer_ip(), ui16RtpPort);
+        _aPeerRtcpAddr[trackIdx] = makePeerAddr(get_peer_ip(), ui16RtcpPort);
+
+		if(_muxRtpSock || openUdpMux()){
+			//所有会话复用同一对udp端口
+			startListenPeerUdpData(trackIdx);
+			sendRtspResponse("200 OK",
+							 {"Transport",StrPrinter << "RTP/AVP/UDP;unicast;"
+													 << "client_port=" << strClientPort << ";"
+													 << "server_port=" << _muxRtpSock->getLocalPort() << "-" << _muxRtcpSock->getLocalPort() << ";"
+													 << "ssrc=" << printSSRC(trackRef->_ssrc)
+							 });
+			break;
+		}
+
 		//我们用trackIdx区分rtp和rtcp包
-		auto pSockRtp = std::make_shared<Socket>(_sock->getPoller());
-		if (!pSockRtp->bindUdpSock(0,get_local_ip().data())) {
-			//分配端口失败
-			send_NotAcceptable();
-            throw SockException(Err_shutdown, "open rtp socket failed");
-        }
+		Socket::Ptr pSockRtp;
+		uint16_t ui16SrvRtpPort;
+		if(_pushSrc){
+			//推流时rtp端口只收不发，使用批量接收
+			auto pRecvRtp = UdpBatchReceiver::create(_sock->getPoller(),get_local_ip().data());
+			if (!pRecvRtp) {
+				//分配端口失败
+				send_NotAcceptable();
+				throw SockException(Err_shutdown, "open rtp socket failed");
+			}
+			_apRtpRecv[trackIdx] = pRecvRtp;
+			ui16SrvRtpPort = pRecvRtp->getLocalPort();
+		}else{
+			pSockRtp = std::make_shared<Socket>(_sock->getPoller());
+			if (!pSockRtp->bindUdpSock(0,get_local_ip().data())) {
+				//分配端口失败
+				send_NotAcceptable();
+				throw SockException(Err_shutdown, "open rtp socket failed");
+			}
+			ui16SrvRtpPort = pSockRtp->get_local_port();
+			pSockRtp->setSendPeerAddr((struct sockaddr *)(&_aPeerRtpAddr[trackIdx]));
+		}
 		auto pSockRtcp = std::make_shared<Socket>(_sock->getPoller());
-		if (!pSockRtcp->bindUdpSock(pSockRtp->get_local_port() + 1,get_local_ip().data())) {
+		if (!pSockRtcp->bindUdpSock(ui16SrvRtpPort + 1,get_local_ip().data())) {
 			//分配端口失败
 			send_NotAcceptable();
             throw SockException(Err_shutdown, "open rtcp socket failed");
         }
+        pSockRtcp->setSendPeerAddr((struct sockaddr *)(&_aPeerRtcpAddr[trackIdx]));
 		_apRtpSock[trackIdx] = pSockRtp;
 		_apRtcpSock[trackIdx] = pSockRtcp;
-		//设置客户端内网端口信息
-		string strClientPort = FindField(parser["Transport"].data(), "client_port=", NULL);
-		uint16_t ui16RtpPort = atoi( FindField(strClientPort.data(), NULL, "-").data());
-        uint16_t ui16RtcpPort = atoi( FindField(strClientPort.data(), "-" , NULL).data());
-
-        struct sockaddr_in peerAddr;
-        //设置rtp发送目标地址
-		peerAddr.sin_family = AF_INET;
-		peerAddr.sin_port = htons(ui16RtpPort);
-		peerAddr.sin_addr.s_addr = inet_addr(get_peer_ip().data());
-		bzero(&(peerAddr.sin_zero), sizeof peerAddr.sin_zero);
-		pSockRtp->setSendPeerAddr((struct sockaddr *)(&peerAddr));
-
-		//设置rtcp发送目标地址
-        peerAddr.sin_family = AF_INET;
-        peerAddr.sin_port = htons(ui16RtcpPort);
-        peerAddr.sin_addr.s_addr = inet_addr(get_peer_ip().data());
-        bzero(&(peerAddr.sin_zero), sizeof peerAddr.sin_zero);
-        pSockRtcp->setSendPeerAddr((struct sockaddr *)(&peerAddr));
 
 		//尝试获取客户端nat映射地址
 		startListenPeerUdpData(trackIdx);
@@ -669,14 +785,14 @@ void RtspSession::handleReq_Setup(const Parser &parser) {
 		sendRtspResponse("200 OK",
 						 {"Transport",StrPrinter << "RTP/AVP/UDP;unicast;"
 												 << "client_port=" << strClientPort << ";"
-												 << "server_port=" << pSockRtp->get_local_port() << "-" << pSockRtcp->get_local_port() << ";"
+												 << "server_port=" << ui16SrvRtpPort << "-" << pSockRtcp->get_local_port() << ";"
 												 << "ssrc=" << printSSRC(trackRef->_ssrc)
 						 });
 	}
 		break;
 	case Rtsp::RTP_MULTICAST: {
 		if(!_pBrdcaster){
-			_pBrdcaster = RtpBroadCaster::get(getPoller(),get_local_ip(),_mediaInfo._vhost, _mediaInfo._app, _mediaInfo._streamid);
+			_pBrdcaster = RtpBroadCaster::get(get_local_ip(),_mediaInfo._vhost, _mediaInfo._app, _mediaInfo._streamid);
 			if (!_pBrdcaster) {
 				send_NotAcceptable();
                 throw SockException(Err_shutdown, "can not get a available udp multicast socket");
@@ -706,7 +822,7 @@ void RtspSession::handleReq_Setup(const Parser &parser) {
 						 {"Transport",StrPrinter << "RTP/AVP;multicast;"
 												 << "destination=" << _pBrdcaster->getIP() << ";"
 												 << "source=" << get_local_ip() << ";"
-												 << "port=" << iSrvPort << "-" << pSockRtcp->get_local_port() << ";"
+												 << "port=" << iSrvPort << "-" << pSockRtcp->getLocalPort() << ";"
 												 << "ttl=" << udpTTL << ";"
 												 << "ssrc=" << printSSRC(trackRef->_ssrc)
 						 });
@@ -757,7 +873,53 @@ void RtspSession::handleReq_Play(const Parser &parser) {
 		}
 		_bFirstPlay = false;
 
-		_StrPrinter rtp_info;
+		vector<RtpPacketBatch::Ptr> gopCache;
+		if (!_pRtpReader && _rtpType != Rtsp::RTP_MULTICAST) {
+			//先创建读取器再获取gop缓存，读取器的回调在后续的任务中才会触发，此时_enableSendRtp为false
+			weak_ptr<RtspSession> weakSelf = dynamic_pointer_cast<RtspSession>(shared_from_this());
+			_pRtpReader = pMediaSrc->attach(getPoller(),useBuf,gopCache);
+			_gopFilter.reset(gopCache);
+			_pRtpReader->setDetachCB([weakSelf]() {
+				auto strongSelf = weakSelf.lock();
+				if(!strongSelf) {
+					return;
+				}
+                strongSelf->shutdown(SockException(Err_shutdown,"rtsp ring buffer detached"));
+            });
+			_pRtpReader->setReadCB([weakSelf](const RtpPacketBatch::Ptr &batch) {
+				auto strongSelf = weakSelf.lock();
+				if(!strongSelf) {
+					return;
+				}
+				if(strongSelf->_gopFilter.filter(batch)) {
+					//已经通过gop缓存发送过
+					return;
+				}
+				if(!strongSelf->_enableSendRtp) {
+					return;
+				}
+				if(strongSelf->_rtpType == Rtsp::RTP_TCP &&
+				   !strongSelf->checkSend(batch->size(), strongSelf->isSocketBusy(), batch->keyPos())) {
+					//播放器网络太慢，丢弃该帧
+					return;
+				}
+				strongSelf->sendRtpPacket(batch);
+			});
+			if(_rtpType == Rtsp::RTP_TCP) {
+				//udp方式由内核丢弃数据报，只需要处理tcp方式的发送积压
+				_sock->setOnFlush([weakSelf]() {
+					auto strongSelf = weakSelf.lock();
+					if(!strongSelf) {
+						return false;
+					}
+					strongSelf->onSocketFlushed();
+					return true;
+				});
+			}
+		}
+
+		string rtp_info;
+		rtp_info.reserve(128 * _aTrackInfo.size());
 		for(auto &track : _aTrackInfo){
 			if (track->_inited == false) {
 				//还有track没有setup
@@ -766,17 +928,30 @@ void RtspSession::handleReq_Play(const Parser &parser) {
 			}
 			track->_ssrc = pMediaSrc->getSsrc(track->_type);
 			track->_seq = pMediaSrc->getSeqence(track->_type);
-			track->_time_stamp = pMediaSrc->getTimeStamp(track->_type);
+			track->_rtp_stamp = pMediaSrc->getRtpStamp(track->_type);
+			for(auto &batch : gopCache){
+				auto &rtp = batch->front();
+				if(rtp->type == track->_type){
+					//播放器先收到gop缓存，所以RTP-Info须从gop缓存中该track的第一个包开始
+					track->_seq = rtp->sequence;
+					track->_rtp_stamp = rtp->rtpStamp;
+					break;
+				}
+			}
 
-			rtp_info << "url=" << _strContentBase << "/" << track->_control_surffix << ";"
-					 << "seq=" << track->_seq << ";"
-					 << "rtptime=" << (int)(track->_time_stamp * (track->_samplerate / 1000)) << ",";
+			char buf[64];
+			rtp_info.append("url=").append(_strContentBase).append("/").append(track->_control_surffix);
+			//rtptime直接使用rtp头中的时间戳，与播放器收到的第一个包一致
+			rtp_info.append(buf, snprintf(buf, sizeof(buf), ";seq=%u;rtptime=%u,", (unsigned int)track->_seq,
+										  (unsigned int)track->_rtp_stamp));
 		}
 
 		rtp_info.pop_back();
 
+		char range[64];
+		snprintf(range, sizeof(range), "npt=%.2f", pMediaSrc->getTimeStamp(TrackInvalid) / 1000.0);
 		sendRtspResponse("200 OK",
-						 {"Range", StrPrinter << "npt=" << setiosflags(ios::fixed) << setprecision(2) <<  pMediaSrc->getTimeStamp(TrackInvalid) / 1000.0,
+						 {"Range", range,
 						  "RTP-Info",rtp_info
 						 });
 
@@ -786,26 +961,8 @@ void RtspSession::handleReq_Play(const Parser &parser) {
 		SockUtil::setNoDelay(_sock->rawFD(),false);
 		(*this) << SocketFlags(kSockFlags);
 
-		if (!_pRtpReader && _rtpType != Rtsp::RTP_MULTICAST) {
-			weak_ptr<RtspSession> weakSelf = dynamic_pointer_cast<RtspSession>(shared_from_this());
-			_pRtpReader = pMediaSrc->getRing()->attach(getPoller(),useBuf);
-			_pRtpReader->setDetachCB([weakSelf]() {
-				auto strongSelf = weakSelf.lock();
-				if(!strongSelf) {
-					return;
-				}
-                strongSelf->shutdown(SockException(Err_shutdown,"rtsp ring buffer detached"));
-            });
-			_pRtpReader->setReadCB([weakSelf](const RtpPacket::Ptr &pack) {
-				auto strongSelf = weakSelf.lock();
-				if(!strongSelf) {
-					return;
-				}
-				if(strongSelf->_enableSendRtp) {
-					strongSelf->sendRtpPacket(pack);
-				}
-			});
-		}
+		//立即发送gop缓存，播放器可以马上开始解码
+		sendRtpPacket(gopCache);
     };
 
     weak_ptr<RtspSession> weakSelf = dynamic_pointer_cast<RtspSession>(shared_from_this());
@@ -927,17 +1084,29 @@ inline void RtspSession::onRcvPeerUdpData(int intervaled, const Buffer::Ptr &pBu
 	if(intervaled % 2 == 0){
 		if(_pushSrc){
 		    //这是rtsp推流上来的rtp包
-			handleOneRtp(intervaled / 2,_aTrackInfo[intervaled / 2],( unsigned char *)pBuf->data(),pBuf->size());
+			auto &track = _aTrackInfo[intervaled / 2];
+			auto ssrc = track->_ssrc;
+			handleOneRtp(intervaled / 2,track,( unsigned char *)pBuf->data(),pBuf->size());
+			if(_muxRtpSock && ssrc != track->_ssrc){
+				//收到第一个rtp包后才知道推流的ssrc，登记后nat映射后的rtcp也能分发到本会话
+				RtspUdpMux::Instance().updateSsrc(this, intervaled / 2, track->_ssrc);
+			}
 		}else if(!_udpSockConnected.count(intervaled)){
             //这是rtsp播放器的rtp打洞包
             _udpSockConnected.emplace(intervaled);
-            _apRtpSock[intervaled / 2]->setSendPeerAddr(&addr);
+            if(_apRtpSock[intervaled / 2]){
+                _apRtpSock[intervaled / 2]->setSendPeerAddr(&addr);
+            }
+            memcpy(&_aPeerRtpAddr[intervaled / 2], &addr, sizeof(struct sockaddr_in));
 		}
 	}else{
 	    //rtcp包
         if(!_udpSockConnected.count(intervaled)){
             _udpSockConnected.emplace(intervaled);
-            _apRtcpSock[(intervaled - 1) / 2]->setSendPeerAddr(&addr);
+            if(_apRtcpSock[(intervaled - 1) / 2]){
+                _apRtcpSock[(intervaled - 1) / 2]->setSendPeerAddr(&addr);
+            }
+            memcpy(&_aPeerRtcpAddr[(intervaled - 1) / 2], &addr, sizeof(struct sockaddr_in));
         }
         onRtcpPacket((intervaled - 1) / 2, _aTrackInfo[(intervaled - 1) / 2], (unsigned char *) pBuf->data(),pBuf->size());
     }
@@ -947,39 +1116,64 @@ inline void RtspSession::onRcvPeerUdpData(int intervaled, const Buffer::Ptr &pBu
 inline void RtspSession::startListenPeerUdpData(int trackIdx) {
 	weak_ptr<RtspSession> weakSelf = dynamic_pointer_cast<RtspSession>(shared_from_this());
     auto srcIP = inet_addr(get_peer_ip().data());
-	auto onUdpData = [weakSelf,srcIP](const Buffer::Ptr &pBuf, struct sockaddr *pPeerAddr,int intervaled){
+    //在会话线程上处理收到的udp数据
+	auto onUdpData = [weakSelf,srcIP](const Buffer::Ptr &pBuf, const struct sockaddr *pPeerAddr,int intervaled){
 		auto strongSelf=weakSelf.lock();
 		if(!strongSelf) {
-			return false;
+			return;
 		}
 
         if (((struct sockaddr_in *) pPeerAddr)->sin_addr.s_addr != srcIP) {
             WarnP(strongSelf.get()) << ((intervaled % 2 == 0) ? "收到其他地址的rtp数据:" : "收到其他地址的rtcp数据:")
                                     << inet_ntoa(((struct sockaddr_in *) pPeerAddr)->sin_addr);
-            return true;
+            return;
         }
-
-		struct sockaddr addr=*pPeerAddr;
-		strongSelf->async([weakSelf,pBuf,addr,intervaled]() {
-			auto strongSelf=weakSelf.lock();
-			if(!strongSelf) {
-				return;
-			}
-			strongSelf->onRcvPeerUdpData(intervaled,pBuf,addr);
-		});
-		return true;
+		strongSelf->onRcvPeerUdpData(intervaled,pBuf,*pPeerAddr);
 	};
 
 	switch (_rtpType){
 		case Rtsp::RTP_MULTICAST:{
-			//组播使用的共享rtcp端口
-			UDPServer::Instance().listenPeer(get_peer_ip().data(), this, [onUdpData](
-					int intervaled, const Buffer::Ptr &pBuf, struct sockaddr *pPeerAddr) {
-				return onUdpData(pBuf,pPeerAddr,intervaled);
+			//组播使用的共享rtcp端口，数据在共享端口所在线程收到，整批投递到会话线程
+			UDPServer::Instance().listenPeer(get_peer_ip().data(), this, [weakSelf,onUdpData](
+					int intervaled, const std::shared_ptr<vector<UdpPacket> > &burst) {
+				auto strongSelf=weakSelf.lock();
+				if(!strongSelf) {
+					return false;
+				}
+				strongSelf->async([onUdpData,intervaled,burst]() {
+					for(auto &pkt : *burst){
+						onUdpData(pkt.buffer,(struct sockaddr *)&pkt.addr,intervaled);
+					}
+				});
+				return true;
 			});
 		}
 			break;
 		case Rtsp::RTP_UDP:{
+			if(_muxRtpSock){
+				//复用端口可能在其他线程收到数据，整批投递到会话线程
+				auto &track = _aTrackInfo[trackIdx];
+				RtspUdpMux::Instance().listen(this, trackIdx, srcIP,
+											  ntohs(_aPeerRtpAddr[trackIdx].sin_port),
+											  ntohs(_aPeerRtcpAddr[trackIdx].sin_port),
+											  //播放同一个流的会话ssrc相同，播放器只按对端ip+rtcp中的媒体ssrc分发；
+											  //推流此时还不知道ssrc，先按对端ip+负载类型分发
+											  track->_ssrc, (bool)_pushSrc, track->_pt,
+											  [weakSelf,onUdpData](int intervaled, const std::shared_ptr<vector<UdpPacket> > &burst) {
+					auto strongSelf=weakSelf.lock();
+					if(!strongSelf) {
+						return false;
+					}
+					strongSelf->async([onUdpData,intervaled,burst]() {
+						for(auto &pkt : *burst){
+							onUdpData(pkt.buffer,(struct sockaddr *)&pkt.addr,intervaled);
+						}
+					});
+					return true;
+				});
+				break;
+			}
+			//udp端口都是在会话线程上创建的，直接在本线程处理
 			auto setEvent = [&](Socket::Ptr &sock,int intervaled){
 				if(!sock){
 					WarnP(this) << "udp端口为空:" << intervaled;
@@ -989,7 +1183,17 @@ inline void RtspSession::startListenPeerUdpData(int trackIdx) {
 					onUdpData(pBuf,pPeerAddr,intervaled);
 				});
 			};
-			setEvent(_apRtpSock[trackIdx], 2*trackIdx );
+			if(_apRtpRecv[trackIdx]){
+				//推流的rtp端口批量接收
+				int intervaled = 2 * trackIdx;
+				_apRtpRecv[trackIdx]->setOnBurst([onUdpData,intervaled](vector<UdpPacket> &burst){
+					for(auto &pkt : burst){
+						onUdpData(pkt.buffer,(struct sockaddr *)&pkt.addr,intervaled);
+					}
+				});
+			}else{
+				setEvent(_apRtpSock[trackIdx], 2*trackIdx );
+			}
 			setEvent(_apRtcpSock[trackIdx], 2*trackIdx + 1 );
 		}
 			break;
@@ -1000,44 +1204,47 @@ inline void RtspSession::startListenPeerUdpData(int trackIdx) {
 
 }
 
-static string dateStr(){
-	char buf[64];
-	time_t tt = time(NULL);
-	strftime(buf, sizeof buf, "%a, %b %d %Y %H:%M:%S GMT", gmtime(&tt));
-	return buf;
+static inline void appendHeader(string &res, const string &key, const string &val){
+	res.append(key).append(": ").append(val).append("\r\n");
 }
 
-bool RtspSession::sendRtspResponse(const string &res_code,
-								   const StrCaseMap &header_const,
-								   const string &sdp,
-								   const char *protocol){
-	auto header = header_const;
-	header.emplace("CSeq",StrPrinter << _iCseq);
-	if(!_strSession.empty()){
-		header.emplace("Session",_strSession);
-	}
-
-	header.emplace("Server",SERVER_NAME "(build in " __DATE__ " " __TIME__ ")");
-	header.emplace("Date",dateStr());
+void RtspSession::beginRtspResponse(string &res, const string &res_code, const char *protocol, size_t reserve){
+	makeRtspResponseHead(res, res_code, protocol, _iCseq, _strSession, reserve);
+}
 
+bool RtspSession::endRtspResponse(string &res, bool hasContentType, const string &sdp){
 	if(!sdp.empty()){
-		header.emplace("Content-Length",StrPrinter << sdp.size());
-		header.emplace("Content-Type","application/sdp");
-	}
-
-	_StrPrinter printer;
-	printer << protocol << " " << res_code << "\r\n";
-	for (auto &pr : header){
-		printer << pr.first << ": " << pr.second << "\r\n";
+		char buf[32];
+		res.append("Content-Length: ");
+		res.append(buf, snprintf(buf, sizeof(buf), "%u", (unsigned int)sdp.size()));
+		res.append("\r\n");
+		if(!hasContentType){
+			res.append("Content-Type: application/sdp\r\n");
+		}
 	}
+	res.append("\r\n");
+	res.append(sdp);
+	return send(std::make_shared<BufferString>(std::move(res))) > 0 ;
+}
 
-	printer << "\r\n";
+void RtspSession::sendDescribeResponse(const RtspSdpCache::Ptr &sdpCache){
+	string res;
+	sdpCache->renderDescribeResponse(res, _iCseq, _strSession, _strContentBase);
+	send(std::make_shared<BufferString>(std::move(res)));
+}
 
-	if(!sdp.empty()){
-		printer << sdp;
+bool RtspSession::sendRtspResponse(const string &res_code,
+								   const StrCaseMap &header,
+								   const string &sdp,
+								   const char *protocol){
+	string res;
+	beginRtspResponse(res, res_code, protocol, sdp.size());
+	bool hasContentType = false;
+	for (auto &pr : header){
+		appendHeader(res, pr.first, pr.second);
+		hasContentType = hasContentType || strcasecmp(pr.first.data(), "Content-Type") == 0;
 	}
-//	DebugP(this) << printer;
-	return send(std::make_shared<BufferString>(printer)) > 0 ;
+	return endRtspResponse(res, hasContentType, sdp);
 }
 
 int RtspSession::send(const Buffer::Ptr &pkt){
@@ -1052,17 +1259,21 @@ bool RtspSession::sendRtspResponse(const string &res_code,
 								   const std::initializer_list<string> &header,
 								   const string &sdp,
 								   const char *protocol) {
-	string key;
-	StrCaseMap header_map;
-	int i = 0;
+	//直接渲染键值对，无需构造StrCaseMap
+	string res;
+	beginRtspResponse(res, res_code, protocol, sdp.size());
+	bool hasContentType = false;
+	const string *key = nullptr;
 	for(auto &val : header){
-		if(++i % 2 == 0){
-			header_map.emplace(key,val);
-		}else{
-			key = val;
+		if(!key){
+			key = &val;
+			continue;
 		}
+		appendHeader(res, *key, val);
+		hasContentType = hasContentType || strcasecmp(key->data(), "Content-Type") == 0;
+		key = nullptr;
 	}
-	return sendRtspResponse(res_code,header_map,sdp,protocol);
+	return endRtspResponse(res, hasContentType, sdp);
 }
 
 inline string RtspSession::printSSRC(uint32_t ui32Ssrc) {
@@ -1123,6 +1334,19 @@ void RtspSession::onNoneReader(MediaSource &sender){
 }
 
 
+//通过复用端口发送数据报，返回发送的字节数；发送缓存满时丢弃，其他错误打印日志
+static int sendToMux(int fd, const char *data, int len, const struct sockaddr_in &addr) {
+    auto ret = ::sendto(fd, data, len, 0, (struct sockaddr *) &addr, sizeof(addr));
+    if (ret == -1) {
+        auto err = get_uv_error(true);
+        if (err != UV_EAGAIN) {
+            WarnL << "udp复用端口发送失败:" << inet_ntoa(addr.sin_addr) << ":" << ntohs(addr.sin_port) << " " << uv_strerror(err);
+        }
+        return 0;
+    }
+    return ret;
+}
+
 void RtspSession::sendRtpPacket(const RtpPacket::Ptr & pkt) {
     //InfoP(this) <<(int)pkt.Interleaved;
     switch (_rtpType) {
@@ -1132,6 +1356,11 @@ void RtspSession::sendRtpPacket(const RtpPacket::Ptr & pkt) {
             break;
         case Rtsp::RTP_UDP: {
             int iTrackIndex = getTrackIndexByTrackType(pkt->type);
+            if (_muxRtpSock) {
+                //复用端口没有发送队列，发送缓存满时直接丢弃，与udp本身的语义一致
+                _ui64TotalBytes += sendToMux(_muxRtpSock->rawFD(), pkt->data() + 4, pkt->size() - 4, _aPeerRtpAddr[iTrackIndex]);
+                break;
+            }
             auto &pSock = _apRtpSock[iTrackIndex];
             if (!pSock) {
                 shutdown(SockException(Err_shutdown,"udp sock not opened yet"));
@@ -1145,24 +1374,155 @@ void RtspSession::sendRtpPacket(const RtpPacket::Ptr & pkt) {
         default:
             break;
     }
+}
+
+void RtspSession::onSocketFlushed() {
+    if(!onSendFlushed()){
+        return;
+    }
+    //发送缓存已经清空，从gop缓存恢复播放
+    vector<RtpPacketBatch::Ptr> gopCache;
+    auto pMediaSrc = _pMediaSrc.lock();
+    if(pMediaSrc){
+        pMediaSrc->getGopCache(gopCache);
+    }
+    bool haveVideo = false;
+    for(auto &track : _aTrackInfo){
+        if(track->_type == TrackVideo){
+            haveVideo = true;
+        }
+    }
+    if(!haveVideo || (!gopCache.empty() && gopCache.front() == _lastKeyBatch.lock())){
+        //丢包发生在已发送的gop中间(或者纯音频没有关键帧)，重发gop缓存会导致重复的rtp包以及seq、时间戳回退
+        gopCache.clear();
+    }
+    _gopFilter.reset(gopCache);
+    //没有可重发的gop缓存时，有视频则等待下一个关键帧
+    resumeSend(gopCache.empty() && haveVideo);
+    InfoP(this) << "发送缓存已清空,恢复播放,重发gop缓存帧数:" << gopCache.size();
+    sendRtpPacket(gopCache);
+}
+
+void RtspSession::sendRtpPacket(const RtpPacketBatch::Ptr &batch) {
+    if(batch->keyPos()){
+        _lastKeyBatch = batch;
+    }
+    updateRtcpCounter(batch);
+    if(_rtpType == Rtsp::RTP_UDP && batch->getPackets().size() > 1){
+        sendRtpPacketUdp(batch);
+        return;
+    }
+    if(_rtpType != Rtsp::RTP_TCP){
+        for(auto &pkt : batch->getPackets()){
+            sendRtpPacket(pkt);
+        }
+        return;
+    }
+    //rtp over tcp时先缓存，本轮事件循环中所有就绪的帧合并为一次写操作
+    appendTcpPending(batch);
+}
+
+void RtspSession::sendRtpPacketUdp(const RtpPacketBatch::Ptr &batch) {
+    auto &pkts = batch->getPackets();
+    //同一帧的rtp包属于同一个track
+    int iTrackIndex = getTrackIndexByTrackType(pkts[0]->type);
+    auto &pSock = _apRtpSock[iTrackIndex];
+    if (!pSock && !_muxRtpSock) {
+        shutdown(SockException(Err_shutdown,"udp sock not opened yet"));
+        return;
+    }
+    size_t sent = 0;
+    GET_CONFIG(bool,udpBatchSend,Rtp::kUdpBatchSend);
+    //socket发送队列有积压时直接写fd会导致乱序
+    if(udpBatchSend && (_muxRtpSock || !pSock->isSocketBusy())){
+        int fd = _muxRtpSock ? _muxRtpSock->rawFD() : pSock->rawFD();
+        sent = UdpBatchSender::send(fd, (struct sockaddr *)&_aPeerRtpAddr[iTrackIndex], sizeof(struct sockaddr_in), pkts);
+        for(size_t i = 0; i < sent; ++i){
+            _ui64TotalBytes += pkts[i]->size() - 4;
+        }
+    }
+    //未能批量发送的包(发送缓存满、不支持sendmmsg等)逐个发送
+    for(size_t i = sent; i < pkts.size(); ++i){
+        sendRtpPacket(pkts[i]);
+    }
+}
 
-#if RTSP_SERVER_SEND_RTCP
-    int iTrackIndex = getTrackIndexByTrackType(pkt->type);
+void RtspSession::sendRtpPacket(const vector<RtpPacketBatch::Ptr> &batches) {
+    if(batches.empty()){
+        return;
+    }
+    for(auto &batch : batches){
+        sendRtpPacket(batch);
+    }
+}
+
+//合并发送的最大字节数，超过后立即发送
+#define TCP_MERGE_MAX_BYTES (512 * 1024)
+
+void RtspSession::appendTcpPending(const RtpPacketBatch::Ptr &batch) {
+    _tcpPending.emplace_back(batch);
+    _tcpPendingBytes += batch->size();
+    if(_tcpPendingBytes >= TCP_MERGE_MAX_BYTES){
+        flushTcpPending();
+        return;
+    }
+    if(_tcpPending.size() == 1){
+        //本轮事件处理完毕后再发送，期间就绪的其他帧一并合并
+        weak_ptr<RtspSession> weakSelf = dynamic_pointer_cast<RtspSession>(shared_from_this());
+        getPoller()->async([weakSelf]() {
+            auto strongSelf = weakSelf.lock();
+            if(strongSelf){
+                strongSelf->flushTcpPending();
+            }
+        }, false);
+    }
+}
+
+void RtspSession::flushTcpPending() {
+    if(_tcpPending.empty()){
+        return;
+    }
+    vector<Buffer::Ptr> buffers;
+    for(auto &batch : _tcpPending){
+        for(auto &pkt : batch->getPackets()){
+            buffers.emplace_back(pkt);
+        }
+    }
+    _tcpPending.clear();
+    _tcpPendingBytes = 0;
+
+    if(!isSocketBusy()){
+        //发送队列为空时直接通过sendmsg聚集写，不拷贝数据
+        _ui64TotalBytes += TcpGatherSender::send(_sock->rawFD(), kSockFlags, buffers);
+    }
+    //剩余的rtp包直接引用放入发送队列，等待socket可写
+    for(auto &buffer : buffers){
+        send(buffer);
+    }
+}
+
+void RtspSession::updateRtcpCounter(const RtpPacketBatch::Ptr &batch) {
+    auto &packets = batch->getPackets();
+    if(packets.empty() || (_rtpType != Rtsp::RTP_TCP && _rtpType != Rtsp::RTP_UDP)){
+        return;
+    }
+    auto &last = packets.back();
+    int iTrackIndex = getTrackIndexByTrackType(last->type);
     if(iTrackIndex == -1){
         return;
     }
     RtcpCounter &counter = _aRtcpCnt[iTrackIndex];
-    counter.pktCnt += 1;
-    counter.octCount += (pkt->length - pkt->offset);
+    for(auto &pkt : packets){
+        counter.pktCnt += 1;
+        counter.octCount += pkt->size() - pkt->offset;
+    }
     auto &ticker = _aRtcpTicker[iTrackIndex];
-    if (ticker.elapsedTime() > 5 * 1000) {
-        //send rtcp every 5 second
+    if (ticker.elapsedTime() > RTSP_SERVER_SR_INTERVAL_MS) {
         ticker.resetTime();
         //直接保存网络字节序
-        memcpy(&counter.timeStamp, pkt->payload + 8 , 4);
+        memcpy(&counter.timeStamp, last->data() + 8 , 4);
         sendSenderReport(_rtpType == Rtsp::RTP_TCP,iTrackIndex);
     }
-#endif
 }
 
 void RtspSession::sendSenderReport(bool overTcp,int iTrackIndex) {
@@ -1185,12 +1545,10 @@ void RtspSession::sendSenderReport(bool overTcp,int iTrackIndex) {
     uint32_t ssrc=htonl(track->_ssrc);
     memcpy(&pui8Rtcp_SR[4], &ssrc, 4);
 
-    uint64_t msw;
-    uint64_t lsw;
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    msw = tv.tv_sec + 0x83AA7E80; /* 0x83AA7E80 is the number of seconds from 1900 to 1970 */
-    lsw = (uint32_t) ((double) tv.tv_usec * (double) (((uint64_t) 1) << 32) * 1.0e-6);
+    //观看者RR中的LSR为此ntp时间戳的中间32位，用于计算往返时延
+    uint32_t msw;
+    uint32_t lsw;
+    RtcpParser::getNtpStamp(msw, lsw);
 
     msw = htonl(msw);
     memcpy(&pui8Rtcp_SR[8], &msw, 4);
@@ -1221,7 +1579,11 @@ void RtspSession::sendSenderReport(bool overTcp,int iTrackIndex) {
     if(overTcp){
         send(obtainBuffer((char *) aui8Rtcp, sizeof(aui8Rtcp)));
     }else {
-        _apRtcpSock[iTrackIndex]->send((char *) aui8Rtcp + 4, sizeof(aui8Rtcp) - 4);
+        if (_muxRtcpSock) {
+            sendToMux(_muxRtcpSock->rawFD(), (char *) aui8Rtcp + 4, sizeof(aui8Rtcp) - 4, _aPeerRtcpAddr[iTrackIndex]);
+        } else if (_apRtcpSock[iTrackIndex]) {
+            _apRtcpSock[iTrackIndex]->send((char *) aui8Rtcp + 4, sizeof(aui8Rtcp) - 4);
+        }
     }
 }
 
@@ -34,12 +34,14 @@
 #include "Util/util.h"
 #include "Util/logger.h"
 #include "Common/config.h"
+#include "Common/ReaderWatermark.h"
 #include "Network/TcpSession.h"
 #include "Player/PlayerBase.h"
 #include "RtpBroadCaster.h"
 #include "RtspMediaSource.h"
 #include "RtspSplitter.h"
 #include "RtpReceiver.h"
+#include "UdpBatchReceiver.h"
 #include "RtspToRtmpMediaSource.h"
 
 using namespace std;
@@ -66,7 +68,7 @@ private:
     uint32_t _offset;
 };
 
-class RtspSession: public TcpSession, public RtspSplitter, public RtpReceiver , public MediaSourceEvent{
+class RtspSession: public TcpSession, public RtspSplitter, public RtpReceiver , public MediaSourceEvent , public ReaderWatermark{
 public:
 	typedef std::shared_ptr<RtspSession> Ptr;
 	typedef std::function<void(const string &realm)> onGetRealm;
@@ -79,6 +81,13 @@ public:
 	void onRecv(const Buffer::Ptr &pBuf) override;
 	void onError(const SockException &err) override;
 	void onManager() override;
+
+	/**
+	 * 获取根据观看者RR统计的网络质量，可以在任意线程调用
+	 */
+	RtcpStats::Ptr getRtcpStats() const {
+		return _rtcpStats;
+	}
 protected:
 	//RtspSplitter override
     /**
@@ -151,9 +160,59 @@ private:
     void onAuthDigest(const string &realm,const string &strMd5);
 
     void sendRtpPacket(const RtpPacket::Ptr &pkt);
+    /**
+     * 发送一帧rtp包，rtp over tcp时与本轮事件循环中的其他帧合并为一次写操作，udp时批量发送数据报
+     */
+    void sendRtpPacket(const RtpPacketBatch::Ptr &batch);
+    /**
+     * udp方式批量发送一帧rtp包
+     */
+    void sendRtpPacketUdp(const RtpPacketBatch::Ptr &batch);
+    /**
+     * 使用所有会话复用的udp端口，未开启复用或绑定失败时返回false
+     */
+    bool openUdpMux();
+    /**
+     * 批量发送多帧rtp包，用于发送gop缓存
+     */
+    void sendRtpPacket(const vector<RtpPacketBatch::Ptr> &batches);
+    /**
+     * rtp over tcp时缓存待发送的帧，本轮事件循环结束时统一发送
+     */
+    void appendTcpPending(const RtpPacketBatch::Ptr &batch);
+    /**
+     * 通过一次sendmsg发送所有缓存的帧，内核发送缓存满时剩余数据放入socket发送队列
+     */
+    void flushTcpPending();
+    /**
+     * 套接字发送缓存清空，如果之前因为积压丢弃了数据，则从gop缓存恢复播放
+     */
+    void onSocketFlushed();
 	bool sendRtspResponse(const string &res_code,const std::initializer_list<string> &header, const string &sdp = "" , const char *protocol = "RTSP/1.0");
 	bool sendRtspResponse(const string &res_code,const StrCaseMap &header = StrCaseMap(), const string &sdp = "",const char *protocol = "RTSP/1.0");
+	/**
+	 * 使用媒体源预先渲染的模板回复DESCRIBE
+	 */
+	void sendDescribeResponse(const RtspSdpCache::Ptr &sdpCache);
+	/**
+	 * 渲染状态行与CSeq、Session、Server、Date头
+	 * @param res 响应内容
+	 * @param reserve 除公共头外预留的长度
+	 */
+	void beginRtspResponse(string &res, const string &res_code, const char *protocol, size_t reserve);
+	/**
+	 * 追加Content头、空行与内容，然后发送
+	 */
+	bool endRtspResponse(string &res, bool hasContentType, const string &sdp);
 	void sendSenderReport(bool overTcp,int iTrackIndex);
+	/**
+	 * 更新SR所需的发送统计，每5秒发送一次SR
+	 */
+	void updateRtcpCounter(const RtpPacketBatch::Ptr &batch);
+	/**
+	 * 处理观看者的RR，统计丢包、抖动与往返时延
+	 */
+	void onRecvReceiverReport(const SdpTrack::Ptr &track, const uint8_t *data, size_t len);
 private:
 	Ticker _ticker;
 	int _iCseq = 0;
@@ -163,13 +222,23 @@ private:
 	bool _bFirstPlay = true;
     MediaInfo _mediaInfo;
 	std::weak_ptr<RtspMediaSource> _pMediaSrc;
-	RingBuffer<RtpPacket::Ptr>::RingReader::Ptr _pRtpReader;
+	RtspMediaSource::RingType::RingReader::Ptr _pRtpReader;
+	//过滤环形缓存重复派发的gop缓存数据
+	GopCacheFilter<RtpPacketBatch::Ptr> _gopFilter;
+	//最近一次发送的关键帧，丢包恢复时用于判断gop缓存是否已经发送过
+	weak_ptr<RtpPacketBatch> _lastKeyBatch;
 	Rtsp::eRtpType _rtpType = Rtsp::RTP_Invalid;
 	vector<SdpTrack::Ptr> _aTrackInfo;
 
 	//RTP over udp
 	Socket::Ptr _apRtpSock[2]; //RTP端口,trackid idx 为数组下标
 	Socket::Ptr _apRtcpSock[2];//RTCP端口,trackid idx 为数组下标
+	UdpBatchReceiver::Ptr _apRtpRecv[2];//推流时的RTP端口,批量接收
+	struct sockaddr_in _aPeerRtpAddr[2];//RTP发送目标地址
+	struct sockaddr_in _aPeerRtcpAddr[2];//RTCP发送目标地址
+	//所有会话复用的udp端口(rtsp.udpMuxPort)，开启后不再单独分配端口
+	UdpBatchReceiver::Ptr _muxRtpSock;
+	UdpBatchReceiver::Ptr _muxRtcpSock;
     unordered_set<int> _udpSockConnected;
 	//RTP over udp_multicast
 	RtpBroadCaster::Ptr _pBrdcaster;
@@ -178,6 +247,14 @@ private:
     string _strNonce;
     //消耗的总流量
     uint64_t _ui64TotalBytes = 0;
+    //RR与NACK重传统计
+    RtcpStats::Ptr _rtcpStats = std::make_shared<RtcpStats>();
+    //NACK重传限速
+    Ticker _nackTicker;
+    uint32_t _nackCountInSecond = 0;
+    //rtp over tcp时等待合并发送的帧
+    vector<RtpPacketBatch::Ptr> _tcpPending;
+    uint32_t _tcpPendingBytes = 0;
 
 	//RTSP over HTTP
 	//quicktime 请求rtsp会产生两次tcp连接，
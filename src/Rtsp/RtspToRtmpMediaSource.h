@@ -49,6 +49,7 @@ public:
                           bool bEnableMp4 = false,
                           int ringSize = 0) : RtspMediaSource(vhost, app, id,ringSize) {
         _recorder = std::make_shared<MediaRecorder>(vhost, app, id, bEnableHls, bEnableMp4);
+        _stats = std::make_shared<MediaStats>();
     }
 
     virtual ~RtspToRtmpMediaSource() {}
@@ -71,8 +72,10 @@ public:
                     _recorder->addTrack(track);
                     track->addDelegate(_rtmpMuxer);
                     track->addDelegate(_recorder);
+                    track->addDelegate(_stats);
                 }
                 _rtmpMuxer->setListener(_listener);
+                _rtmpMuxer->setStats(_stats);
             }
         }
         RtspMediaSource::onWrite(rtp, bKeyPos);
@@ -0,0 +1,268 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "RtspUdpMux.h"
+#include "Common/config.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+
+namespace mediakit {
+
+static inline uint64_t addrKey(uint32_t ip, uint16_t port) {
+    return ((uint64_t) ip << 16) | port;
+}
+
+static inline uint64_t peerKey(uint32_t ip, uint32_t val) {
+    return ((uint64_t) ip << 32) | val;
+}
+
+//在可能有多个值的表中查找，仅在唯一匹配时返回
+template <typename Map>
+static typename Map::mapped_type findUnique(const Map &map, uint64_t key) {
+    auto range = map.equal_range(key);
+    if (range.first != range.second && std::next(range.first) == range.second) {
+        return range.first->second;
+    }
+    return nullptr;
+}
+
+//获取播放器rtcp中的媒体ssrc(报告块或者反馈消息中被报告的ssrc)
+static bool getRtcpMediaSsrc(const char *data, size_t size, uint32_t &ssrc) {
+    if (size < 12) {
+        return false;
+    }
+    uint8_t rc = data[0] & 0x1F;
+    size_t offset = 0;
+    switch ((uint8_t) data[1]) {
+        case 200:
+            //SR，报告块在发送者信息之后
+            if (!rc || size < 32) {
+                return false;
+            }
+            offset = 28;
+            break;
+        case 201:
+            //RR
+            if (!rc) {
+                return false;
+            }
+            offset = 8;
+            break;
+        case 205:
+        case 206:
+            //RTPFB(NACK)/PSFB(PLI等)
+            offset = 8;
+            break;
+        default:
+            return false;
+    }
+    memcpy(&ssrc, data + offset, 4);
+    ssrc = ntohl(ssrc);
+    return true;
+}
+
+INSTANCE_IMP(RtspUdpMux);
+
+RtspUdpMux::RtspUdpMux() {}
+
+RtspUdpMux::~RtspUdpMux() {}
+
+UdpBatchReceiver::Ptr RtspUdpMux::getSock(const EventPoller::Ptr &poller, bool rtcp) {
+    GET_CONFIG(uint16_t, udpMuxPort, Rtsp::kUdpMuxPort);
+    if (!udpMuxPort) {
+        return nullptr;
+    }
+    lock_guard<mutex> lck(_mtxSock);
+    auto &sock = _socks[rtcp][poller.get()];
+    if (!sock) {
+        sock = UdpBatchReceiver::create(poller, "0.0.0.0", udpMuxPort + rtcp, true);
+        if (!sock) {
+            _socks[rtcp].erase(poller.get());
+            return nullptr;
+        }
+        sock->setOnBurst([this, rtcp](vector<UdpPacket> &burst) {
+            onRecv(rtcp, burst);
+        });
+        auto poller_ptr = poller.get();
+        sock->setOnErr([this, rtcp, poller_ptr](const SockException &err) {
+            WarnL << "rtsp udp复用端口异常:" << err.what();
+            //移除该套接字，之后的会话重新创建
+            lock_guard<mutex> lck(_mtxSock);
+            _socks[rtcp].erase(poller_ptr);
+        });
+        InfoL << "rtsp udp复用端口:" << sock->getLocalPort();
+    }
+    return sock;
+}
+
+void RtspUdpMux::modifyTable(const function<void(Table &table)> &fun) {
+    lock_guard<mutex> lck(_mtxTable);
+    auto table = std::make_shared<Table>(*_table);
+    fun(*table);
+    std::atomic_store(&_table, std::shared_ptr<const Table>(table));
+}
+
+void RtspUdpMux::listen(void *tag, int trackIdx, uint32_t peerIp, uint16_t rtpPort, uint16_t rtcpPort, uint32_t ssrc, bool push, int pt, const onRecvData &cb) {
+    auto target = std::make_shared<Target>();
+    target->tag = tag;
+    target->trackIdx = trackIdx;
+    target->ssrc = ssrc;
+    target->cb = cb;
+    modifyTable([&](Table &table) {
+        table.addr[addrKey(peerIp, rtpPort)] = target;
+        table.addr[addrKey(peerIp, rtcpPort)] = target;
+        if (push) {
+            table.pushPt.emplace(peerKey(peerIp, pt & 0x7F), target);
+            if (ssrc) {
+                table.ssrc[ssrc] = target;
+            }
+        } else if (ssrc) {
+            table.peerSsrc.emplace(peerKey(peerIp, ssrc), target);
+        }
+    });
+}
+
+void RtspUdpMux::updateSsrc(void *tag, int trackIdx, uint32_t ssrc) {
+    modifyTable([&](Table &table) {
+        for (auto &pr : table.pushPt) {
+            auto &target = pr.second;
+            if (target->tag != tag || target->trackIdx != trackIdx) {
+                continue;
+            }
+            auto it = table.ssrc.find(target->ssrc);
+            if (it != table.ssrc.end() && it->second == target) {
+                table.ssrc.erase(it);
+            }
+            //Target::ssrc只在修改分发表时(锁内)读写，收包线程不访问
+            target->ssrc = ssrc;
+            table.ssrc[ssrc] = target;
+            break;
+        }
+    });
+}
+
+template <typename Map>
+static void eraseTag(Map &map, void *tag) {
+    for (auto it = map.begin(); it != map.end();) {
+        if (it->second->tag == tag) {
+            it = map.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void RtspUdpMux::stopListen(void *tag) {
+    modifyTable([&](Table &table) {
+        eraseTag(table.addr, tag);
+        eraseTag(table.ssrc, tag);
+        eraseTag(table.peerSsrc, tag);
+        eraseTag(table.pushPt, tag);
+    });
+}
+
+void RtspUdpMux::onRecv(bool rtcp, vector<UdpPacket> &burst) {
+    auto table = std::atomic_load(&_table);
+    //按会话和track分组，每组只回调一次
+    vector<pair<Target::Ptr, std::shared_ptr<vector<UdpPacket> > > > groups;
+    //通过ssrc找到的会话，记住其对端地址
+    vector<pair<uint64_t, Target::Ptr> > learned;
+    for (auto &pkt : burst) {
+        auto key = addrKey(pkt.addr.sin_addr.s_addr, ntohs(pkt.addr.sin_port));
+        Target::Ptr target;
+        auto it = table->addr.find(key);
+        if (it != table->addr.end()) {
+            target = it->second;
+        }
+        for (auto it_learned = learned.begin(); !target && it_learned != learned.end(); ++it_learned) {
+            //本批数据中刚通过ssrc找到的对端
+            if (it_learned->first == key) {
+                target = it_learned->second;
+            }
+        }
+        if (!target && pkt.buffer->size() >= 12) {
+            //rtp的ssrc在第8个字节，rtcp发送者ssrc在第4个字节
+            uint32_t ssrc;
+            memcpy(&ssrc, pkt.buffer->data() + (rtcp ? 4 : 8), 4);
+            auto it_ssrc = table->ssrc.find(ntohl(ssrc));
+            if (it_ssrc != table->ssrc.end()) {
+                target = it_ssrc->second;
+                learned.emplace_back(key, target);
+            }
+        }
+        uint32_t mediaSsrc;
+        if (!target && rtcp && getRtcpMediaSsrc(pkt.buffer->data(), pkt.buffer->size(), mediaSsrc)) {
+            //nat后的播放器，按对端ip+被报告的媒体ssrc查找，仅在唯一匹配时使用
+            target = findUnique(table->peerSsrc, peerKey(pkt.addr.sin_addr.s_addr, mediaSsrc));
+            if (target) {
+                learned.emplace_back(key, target);
+            }
+        }
+        if (!target && !rtcp && pkt.buffer->size() >= 12) {
+            //nat后的推流，ssrc还未知，按对端ip+负载类型查找，仅在唯一匹配时使用
+            target = findUnique(table->pushPt, peerKey(pkt.addr.sin_addr.s_addr, pkt.buffer->data()[1] & 0x7F));
+            if (target) {
+                learned.emplace_back(key, target);
+            }
+        }
+        if (!target) {
+            //未知对端
+            continue;
+        }
+        auto it_group = groups.begin();
+        for (; it_group != groups.end() && it_group->first != target; ++it_group);
+        if (it_group == groups.end()) {
+            groups.emplace_back(target, std::make_shared<vector<UdpPacket> >());
+            it_group = groups.end() - 1;
+        }
+        it_group->second->emplace_back(std::move(pkt));
+    }
+
+    vector<void *> expired;
+    for (auto &group : groups) {
+        auto &target = group.first;
+        if (!target->cb(2 * target->trackIdx + rtcp, group.second)) {
+            expired.emplace_back(target->tag);
+        }
+    }
+    if (learned.empty() && expired.empty()) {
+        return;
+    }
+    modifyTable([&](Table &table) {
+        for (auto &pr : learned) {
+            table.addr[pr.first] = pr.second;
+        }
+        for (auto tag : expired) {
+            eraseTag(table.addr, tag);
+            eraseTag(table.ssrc, tag);
+            eraseTag(table.peerSsrc, tag);
+            eraseTag(table.pushPt, tag);
+        }
+    });
+}
+
+}//namespace mediakit
@@ -0,0 +1,135 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ZLMEDIAKIT_RTSPUDPMUX_H
+#define ZLMEDIAKIT_RTSPUDPMUX_H
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include "UdpBatchReceiver.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * rtsp udp端口复用
+ * 每个线程各自绑定同一对SO_REUSEPORT的rtp/rtcp端口，所有udp方式的rtsp会话共用，
+ * fd个数只与线程数有关，不随会话数增长；
+ * 收到的数据先按对端ip+端口分发，找不到时按ssrc分发并记住该对端地址(nat映射后的地址)：
+ * 推流在SETUP时还不知道ssrc，先按对端ip+rtp负载类型分发第一个rtp包，收到rtp包得知ssrc后再按rtp/rtcp的发送者ssrc分发；播放同一个流的会话ssrc相同，播放器只能按对端ip+rtcp报告块/NACK中的媒体ssrc分发rtcp，
+ * 同一ip上有多个播放器播放同一个流时无法区分，此时仍然只按SETUP声明的client_port分发；
+ * 播放器的rtp端口经过nat映射后无法推测，仍然发往client_port声明的端口，除非播放器从该端口发送了打洞包
+ */
+class RtspUdpMux {
+public:
+    /**
+     * 收到某会话某track的一批数据，在复用端口所在线程回调，返回false代表取消监听
+     * @param intervaled 偶数为rtp，奇数为rtcp
+     * @param burst 数据报列表
+     */
+    typedef function<bool(int intervaled, const std::shared_ptr<vector<UdpPacket> > &burst)> onRecvData;
+
+    static RtspUdpMux &Instance();
+    ~RtspUdpMux();
+
+    /**
+     * 获取某线程上的复用端口，不存在时创建
+     * @param poller 线程
+     * @param rtcp 是否为rtcp端口
+     * @return 未开启复用或者绑定失败时返回空
+     */
+    UdpBatchReceiver::Ptr getSock(const EventPoller::Ptr &poller, bool rtcp);
+
+    /**
+     * 监听某会话某track的数据
+     * @param tag 会话标识
+     * @param trackIdx track索引
+     * @param peerIp 对端ip，网络字节序
+     * @param rtpPort 对端rtp端口，主机字节序
+     * @param rtcpPort 对端rtcp端口，主机字节序
+     * @param ssrc 该track的ssrc，0代表未知(推流收到第一个rtp包后通过updateSsrc登记)
+     * @param push 是否为推流，推流按对端ip+负载类型或者发送者ssrc分发，播放按对端ip+媒体ssrc分发rtcp
+     * @param pt 该track的rtp负载类型，仅推流有效
+     * @param cb 数据回调
+     */
+    void listen(void *tag, int trackIdx, uint32_t peerIp, uint16_t rtpPort, uint16_t rtcpPort, uint32_t ssrc, bool push, int pt, const onRecvData &cb);
+
+    /**
+     * 推流收到第一个rtp包(或者ssrc变化)后登记其ssrc，之后nat映射后的rtcp也能按发送者ssrc分发
+     * @param tag 会话标识
+     * @param trackIdx track索引
+     * @param ssrc 推流的ssrc
+     */
+    void updateSsrc(void *tag, int trackIdx, uint32_t ssrc);
+
+    /**
+     * 取消某会话的所有监听
+     */
+    void stopListen(void *tag);
+private:
+    RtspUdpMux();
+    void onRecv(bool rtcp, vector<UdpPacket> &burst);
+
+    class Target {
+    public:
+        typedef std::shared_ptr<Target> Ptr;
+        void *tag;
+        int trackIdx;
+        //已登记的ssrc，只在修改分发表时访问
+        uint32_t ssrc;
+        onRecvData cb;
+    };
+
+    class Table {
+    public:
+        //key为对端ip(网络字节序)<<16 | 端口
+        unordered_map<uint64_t, Target::Ptr> addr;
+        //推流的发送者ssrc
+        unordered_map<uint32_t, Target::Ptr> ssrc;
+        //播放器rtcp中的媒体ssrc，key为对端ip(网络字节序)<<32 | ssrc，同一key有多个会话时无法区分
+        unordered_multimap<uint64_t, Target::Ptr> peerSsrc;
+        //推流的rtp负载类型，key为对端ip(网络字节序)<<32 | pt，同一key有多个会话时无法区分
+        unordered_multimap<uint64_t, Target::Ptr> pushPt;
+    };
+
+    //修改分发表，在锁内复制后整体替换，收包时只原子的获取快照
+    void modifyTable(const function<void(Table &table)> &fun);
+private:
+    std::shared_ptr<const Table> _table = std::make_shared<Table>();
+    mutex _mtxTable;
+    //每个线程一对复用端口
+    unordered_map<EventPoller *, UdpBatchReceiver::Ptr> _socks[2];
+    mutex _mtxSock;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_RTSPUDPMUX_H
@@ -41,75 +41,105 @@ UDPServer::~UDPServer() {
 	InfoL;
 }
 
-Socket::Ptr UDPServer::getSock(const EventPoller::Ptr &poller,const char* strLocalIp, int intervaled,uint16_t iLocalPort) {
+UdpBatchReceiver::Ptr UDPServer::getSock(const EventPoller::Ptr &poller,const char* strLocalIp, int intervaled,uint16_t iLocalPort) {
 	lock_guard<mutex> lck(_mtxUpdSock);
 	string strKey = StrPrinter << strLocalIp << ":" << intervaled << endl;
 	auto it = _mapUpdSock.find(strKey);
 	if (it == _mapUpdSock.end()) {
-		Socket::Ptr pSock(new Socket(poller));
-		//InfoL<<localIp;
-		if (!pSock->bindUdpSock(iLocalPort, strLocalIp)) {
+		auto pSock = UdpBatchReceiver::create(poller, strLocalIp, iLocalPort);
+		if (!pSock) {
 			//分配失败
 			return nullptr;
 		}
 
-		pSock->setOnRead(bind(&UDPServer::onRcvData, this, intervaled, placeholders::_1,placeholders::_2));
+		pSock->setOnBurst(bind(&UDPServer::onRcvData, this, intervaled, placeholders::_1));
 		pSock->setOnErr(bind(&UDPServer::onErr, this, strKey, placeholders::_1));
 		_mapUpdSock[strKey] = pSock;
-		DebugL << strLocalIp << " " << pSock->get_local_port() << " " << intervaled;
+		DebugL << strLocalIp << " " << pSock->getLocalPort() << " " << intervaled;
 		return pSock;
 	}
 	return it->second;
 }
 
-void UDPServer::listenPeer(const char* strPeerIp, void* pSelf, const onRecvData& cb) {
-	lock_guard<mutex> lck(_mtxDataHandler);
-	auto &mapRef = _mapDataHandler[strPeerIp];
-	mapRef.emplace(pSelf, cb);
-}
-
-void UDPServer::stopListenPeer(const char* strPeerIp, void* pSelf) {
-	lock_guard<mutex> lck(_mtxDataHandler);
-	auto it0 = _mapDataHandler.find(strPeerIp);
-	if (it0 == _mapDataHandler.end()) {
-		return;
-	}
-	auto &mapRef = it0->second;
-	auto it1 = mapRef.find(pSelf);
-	if (it1 != mapRef.end()) {
-		mapRef.erase(it1);
-	}
-	if (mapRef.size() == 0) {
-		_mapDataHandler.erase(it0);
-	}
-
-}
 void UDPServer::onErr(const string& strKey, const SockException& err) {
 	WarnL << err.what();
 	lock_guard<mutex> lck(_mtxUpdSock);
 	_mapUpdSock.erase(strKey);
 }
-void UDPServer::onRcvData(int intervaled, const Buffer::Ptr &pBuf, struct sockaddr* pPeerAddr) {
-	//TraceL << trackIndex;
-	struct sockaddr_in *in = (struct sockaddr_in *) pPeerAddr;
-	string peerIp = inet_ntoa(in->sin_addr);
+
+void UDPServer::modifyHandler(const function<void(HandlerMap &handlers)> &fun) {
 	lock_guard<mutex> lck(_mtxDataHandler);
-	auto it0 = _mapDataHandler.find(peerIp);
-	if (it0 == _mapDataHandler.end()) {
+	auto handlers = std::make_shared<HandlerMap>(*_mapDataHandler);
+	fun(*handlers);
+	std::atomic_store(&_mapDataHandler, std::shared_ptr<const HandlerMap>(handlers));
+}
+
+void UDPServer::listenPeer(const char* strPeerIp, void* pSelf, const onRecvData& cb) {
+	uint32_t key = inet_addr(strPeerIp);
+	modifyHandler([&](HandlerMap &handlers) {
+		handlers[key][pSelf] = cb;
+	});
+}
+
+void UDPServer::stopListenPeer(const char* strPeerIp, void* pSelf) {
+	uint32_t key = inet_addr(strPeerIp);
+	modifyHandler([&](HandlerMap &handlers) {
+		auto it = handlers.find(key);
+		if (it == handlers.end()) {
+			return;
+		}
+		it->second.erase(pSelf);
+		if (it->second.empty()) {
+			handlers.erase(it);
+		}
+	});
+}
+
+void UDPServer::onRcvData(int intervaled, vector<UdpPacket> &burst) {
+	auto handlers = std::atomic_load(&_mapDataHandler);
+	if (handlers->empty()) {
 		return;
 	}
-	auto &mapRef = it0->second;
-	for (auto it1 = mapRef.begin(); it1 != mapRef.end(); ++it1) {
-		onRecvData &funRef = it1->second;
-		if (!funRef(intervaled, pBuf, pPeerAddr)) {
-			it1 = mapRef.erase(it1);
+	//按对端ip分组，同一对端的一批数据只回调一次；一次读事件中的对端通常很少，线性查找即可
+	vector<pair<uint32_t, std::shared_ptr<vector<UdpPacket> > > > groups;
+	for (auto &pkt : burst) {
+		uint32_t key = pkt.addr.sin_addr.s_addr;
+		auto it = groups.begin();
+		for (; it != groups.end() && it->first != key; ++it);
+		if (it == groups.end()) {
+			if (handlers->find(key) == handlers->end()) {
+				//没有会话监听该对端
+				continue;
+			}
+			groups.emplace_back(key, std::make_shared<vector<UdpPacket> >());
+			it = groups.end() - 1;
 		}
+		it->second->emplace_back(std::move(pkt));
 	}
-	if (mapRef.size() == 0) {
-		_mapDataHandler.erase(it0);
+
+	vector<pair<uint32_t, void *> > expired;
+	for (auto &group : groups) {
+		for (auto &pr : handlers->at(group.first)) {
+			if (!pr.second(intervaled, group.second)) {
+				expired.emplace_back(group.first, pr.first);
+			}
+		}
+	}
+	if (expired.empty()) {
+		return;
 	}
+	modifyHandler([&](HandlerMap &handlers) {
+		for (auto &pr : expired) {
+			auto it = handlers.find(pr.first);
+			if (it == handlers.end()) {
+				continue;
+			}
+			it->second.erase(pr.second);
+			if (it->second.empty()) {
+				handlers.erase(it);
+			}
+		}
+	});
 }
 
 } /* namespace mediakit */
-
-
@@ -35,28 +35,42 @@
 #include "Util/util.h"
 #include "Util/logger.h"
 #include "Network/Socket.h"
+#include "UdpBatchReceiver.h"
 
 using namespace std;
 using namespace toolkit;
 
 namespace mediakit {
 
+/**
+ * 共享udp端口，按对端ip把数据分发给各个会话
+ * 分发表采用写时复制，收包时只原子的获取快照，不加锁
+ */
 class UDPServer : public std::enable_shared_from_this<UDPServer> {
 public:
-	typedef function< bool(int intervaled, const Buffer::Ptr &buffer, struct sockaddr *peer_addr)> onRecvData;
+	/**
+	 * 收到某个对端的一批数据，返回false代表取消监听
+	 * @param intervaled 数据所在端口的interleaved
+	 * @param burst 该对端在一次读事件中的所有数据报
+	 */
+	typedef function< bool(int intervaled, const std::shared_ptr<vector<UdpPacket> > &burst)> onRecvData;
 	~UDPServer();
 	static UDPServer &Instance();
-	Socket::Ptr getSock(const EventPoller::Ptr &poller,const char *strLocalIp, int intervaled,uint16_t iLocalPort = 0);
+	UdpBatchReceiver::Ptr getSock(const EventPoller::Ptr &poller,const char *strLocalIp, int intervaled,uint16_t iLocalPort = 0);
 	void listenPeer(const char *strPeerIp, void *pSelf, const onRecvData &cb);
 	void stopListenPeer(const char *strPeerIp, void *pSelf);
 private:
 	UDPServer();
-	void onRcvData(int intervaled, const Buffer::Ptr &pBuf,struct sockaddr *pPeerAddr);
+	void onRcvData(int intervaled, vector<UdpPacket> &burst);
 	void onErr(const string &strKey,const SockException &err);
-	unordered_map<string, Socket::Ptr> _mapUpdSock;
+	//修改分发表，在锁内复制后整体替换
+	void modifyHandler(const function<void(unordered_map<uint32_t, unordered_map<void *, onRecvData> > &handlers)> &fun);
+	unordered_map<string, UdpBatchReceiver::Ptr> _mapUpdSock;
 	mutex _mtxUpdSock;
 
-	unordered_map<string, unordered_map<void *, onRecvData> > _mapDataHandler;
+	//key为网络字节序的对端ipv4地址
+	typedef unordered_map<uint32_t, unordered_map<void *, onRecvData> > HandlerMap;
+	std::shared_ptr<const HandlerMap> _mapDataHandler = std::make_shared<HandlerMap>();
 	mutex _mtxDataHandler;
 };
 
@@ -0,0 +1,248 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "UdpBatchReceiver.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+
+#if defined(__linux__)
+//单次recvmmsg最多读取的数据报个数
+#define UDP_RECV_BATCH 32
+#else
+//其他平台逐个recvfrom，只需要一个槽位
+#define UDP_RECV_BATCH 1
+#endif //defined(__linux__)
+//每个槽位的大小，与RtpReceiver接受的最大rtp包一致，超过的数据报会被截断并丢弃
+#define UDP_RECV_SLOT_SIZE (10 * 1024)
+//一次读事件最多读取的数据报个数，超过后让出线程，剩余数据在下一轮事件循环中继续读取，防止单个套接字一直占用线程
+#define UDP_BURST_MAX 256
+
+namespace mediakit {
+
+static void closeSock(int fd) {
+#if defined(_WIN32)
+    closesocket(fd);
+#else
+    close(fd);
+#endif //defined(_WIN32)
+}
+
+//接收缓存只在poller线程上同步使用，同一线程的所有套接字共用一份
+static char *getSlots() {
+    static thread_local vector<char> s_slots(UDP_RECV_BATCH * UDP_RECV_SLOT_SIZE);
+    return s_slots.data();
+}
+
+static int bindReusePort(uint16_t port, const char *localIp) {
+#if defined(SO_REUSEPORT)
+    int fd = (int) socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd == -1) {
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (char *) &on, sizeof(on));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (char *) &on, sizeof(on)) == -1) {
+        WarnL << "设置SO_REUSEPORT失败:" << get_uv_errmsg(true);
+    }
+    SockUtil::setNoBlocked(fd);
+    SockUtil::setCloExec(fd);
+    SockUtil::setRecvBuf(fd);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr(localIp);
+    if (::bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        WarnL << "绑定udp端口失败:" << localIp << ":" << port << " " << get_uv_errmsg(true);
+        closeSock(fd);
+        return -1;
+    }
+    return fd;
+#else
+    //不支持SO_REUSEPORT的平台只能绑定一次
+    return SockUtil::bindUdpSock(port, localIp);
+#endif
+}
+
+UdpBatchReceiver::Ptr UdpBatchReceiver::create(const EventPoller::Ptr &poller, const char *localIp, uint16_t port, bool reusePort) {
+    int fd = reusePort ? bindReusePort(port, localIp) : SockUtil::bindUdpSock(port, localIp);
+    if (fd == -1) {
+        return nullptr;
+    }
+    Ptr ret(new UdpBatchReceiver(poller, fd));
+    if (!ret->attachEvent()) {
+        return nullptr;
+    }
+    return ret;
+}
+
+UdpBatchReceiver::UdpBatchReceiver(const EventPoller::Ptr &poller, int fd) : _fd(fd), _poller(poller) {}
+
+UdpBatchReceiver::~UdpBatchReceiver() {
+    int fd = _fd;
+    //在poller线程移除监听后再关闭fd，防止fd被复用后误删监听
+    _poller->delEvent(fd, [fd](bool) {
+        closeSock(fd);
+    });
+}
+
+bool UdpBatchReceiver::attachEvent() {
+    weak_ptr<UdpBatchReceiver> weakSelf = shared_from_this();
+    int ret = _poller->addEvent(_fd, Event_Read | Event_Error, [weakSelf](int event) {
+        auto strongSelf = weakSelf.lock();
+        if (!strongSelf) {
+            return;
+        }
+        if (event & Event_Read) {
+            strongSelf->onRead();
+        }
+        if (event & Event_Error) {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            getsockopt(strongSelf->_fd, SOL_SOCKET, SO_ERROR, (char *) &error, &len);
+            if (strongSelf->_onErr) {
+                strongSelf->_onErr(SockException(Err_other, uv_strerror(uv_translate_posix_error(error))));
+            }
+        }
+    });
+    if (ret == -1) {
+        WarnL << "监听udp读事件失败:" << get_uv_errmsg(true);
+        return false;
+    }
+    return true;
+}
+
+void UdpBatchReceiver::setOnBurst(const onBurst &cb) {
+    _onBurst = cb;
+}
+
+void UdpBatchReceiver::setOnErr(const onErr &cb) {
+    _onErr = cb;
+}
+
+uint16_t UdpBatchReceiver::getLocalPort() const {
+    return SockUtil::get_local_port(_fd);
+}
+
+int UdpBatchReceiver::rawFD() const {
+    return _fd;
+}
+
+const EventPoller::Ptr &UdpBatchReceiver::getPoller() const {
+    return _poller;
+}
+
+void UdpBatchReceiver::onRead() {
+    //读事件为边沿触发，需要一直读到没有数据为止
+    vector<UdpPacket> burst;
+    burst.reserve(UDP_RECV_BATCH);
+    int count = 0;
+    bool drained = false;
+    while (count < UDP_BURST_MAX) {
+        auto ret = recvBatch(burst);
+        if (ret <= 0) {
+            drained = true;
+            break;
+        }
+        count += ret;
+    }
+    if (!burst.empty() && _onBurst) {
+        _onBurst(burst);
+    }
+    if (drained) {
+        return;
+    }
+    //本次读取达到上限，可能还有数据，让出线程后继续读取
+    weak_ptr<UdpBatchReceiver> weakSelf = shared_from_this();
+    _poller->async([weakSelf]() {
+        auto strongSelf = weakSelf.lock();
+        if (strongSelf) {
+            strongSelf->onRead();
+        }
+    }, false);
+}
+
+static inline void appendPacket(vector<UdpPacket> &burst, const char *data, int len, const struct sockaddr_in &addr) {
+    auto buffer = std::make_shared<BufferRaw>();
+    buffer->setCapacity(len + 1);
+    memcpy(buffer->data(), data, len);
+    buffer->setSize(len);
+    burst.emplace_back();
+    auto &pkt = burst.back();
+    pkt.buffer = std::move(buffer);
+    pkt.addr = addr;
+}
+
+#if defined(__linux__)
+
+int UdpBatchReceiver::recvBatch(vector<UdpPacket> &burst) {
+    struct mmsghdr msgs[UDP_RECV_BATCH];
+    struct iovec iov[UDP_RECV_BATCH];
+    struct sockaddr_in addrs[UDP_RECV_BATCH];
+    memset(msgs, 0, sizeof(msgs));
+    auto slots = getSlots();
+    for (int i = 0; i < UDP_RECV_BATCH; ++i) {
+        iov[i].iov_base = slots + i * UDP_RECV_SLOT_SIZE;
+        iov[i].iov_len = UDP_RECV_SLOT_SIZE;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+    int count = recvmmsg(_fd, msgs, UDP_RECV_BATCH, MSG_DONTWAIT, nullptr);
+    if (count <= 0) {
+        return 0;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            WarnL << "udp数据报过大,已丢弃";
+            continue;
+        }
+        appendPacket(burst, (char *) iov[i].iov_base, msgs[i].msg_len, addrs[i]);
+    }
+    return count;
+}
+
+#else
+
+int UdpBatchReceiver::recvBatch(vector<UdpPacket> &burst) {
+    auto slots = getSlots();
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int ret = recvfrom(_fd, slots, UDP_RECV_SLOT_SIZE, 0, (struct sockaddr *) &addr, &len);
+    if (ret <= 0) {
+        return 0;
+    }
+    appendPacket(burst, slots, ret, addr);
+    return 1;
+}
+
+#endif //defined(__linux__)
+
+}//namespace mediakit
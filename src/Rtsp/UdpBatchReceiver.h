@@ -0,0 +1,102 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ZLMEDIAKIT_UDPBATCHRECEIVER_H
+#define ZLMEDIAKIT_UDPBATCHRECEIVER_H
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include "Network/sockutil.h"
+#include "Network/Buffer.h"
+#include "Network/Socket.h"
+#include "Poller/EventPoller.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 收到的udp数据报
+ */
+class UdpPacket {
+public:
+    Buffer::Ptr buffer;
+    struct sockaddr_in addr;
+};
+
+/**
+ * udp批量接收
+ * linux下通过recvmmsg一次系统调用读取多个数据报，其他平台循环recvfrom；
+ * 一次读事件读到的数据报通过一次回调交给上层，上层可以按对端分组后整批投递到目标线程；
+ * 接收缓存按线程共享，同一poller上的所有套接字共用一份
+ */
+class UdpBatchReceiver : public std::enable_shared_from_this<UdpBatchReceiver> {
+public:
+    typedef std::shared_ptr<UdpBatchReceiver> Ptr;
+    typedef function<void(vector<UdpPacket> &burst)> onBurst;
+    typedef function<void(const SockException &err)> onErr;
+
+    /**
+     * 创建并绑定udp套接字，在poller线程上监听读事件
+     * @param poller 读事件所在线程
+     * @param localIp 绑定的本地ip
+     * @param port 绑定的本地端口，0代表随机端口
+     * @param reusePort 是否开启SO_REUSEPORT，开启后多个线程可以各自绑定同一端口，由内核按对端地址分流
+     * @return 绑定失败返回空
+     */
+    static Ptr create(const EventPoller::Ptr &poller, const char *localIp, uint16_t port = 0, bool reusePort = false);
+    ~UdpBatchReceiver();
+
+    /**
+     * 设置数据回调，在poller线程上触发
+     */
+    void setOnBurst(const onBurst &cb);
+    /**
+     * 设置套接字异常回调，在poller线程上触发
+     */
+    void setOnErr(const onErr &cb);
+
+    uint16_t getLocalPort() const;
+    int rawFD() const;
+    const EventPoller::Ptr &getPoller() const;
+private:
+    UdpBatchReceiver(const EventPoller::Ptr &poller, int fd);
+    bool attachEvent();
+    void onRead();
+    //读取一批数据报追加到burst，返回读到的个数，没有数据时返回0
+    int recvBatch(vector<UdpPacket> &burst);
+private:
+    int _fd;
+    EventPoller::Ptr _poller;
+    onBurst _onBurst;
+    onErr _onErr;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_UDPBATCHRECEIVER_H
@@ -0,0 +1,196 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <atomic>
+#include "UdpBatchSender.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+
+#if defined(__linux__)
+#include <errno.h>
+#include <netinet/udp.h>
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#endif //defined(__linux__)
+
+//单次系统调用最多发送的数据报个数，老版本内核GSO最多支持64个分片
+#define UDP_BATCH_MAX 64
+//GSO单次发送的最大字节数(udp数据报最大负载)
+#define UDP_GSO_MAX_BYTES 65000
+
+namespace mediakit {
+
+static atomic<bool> s_gso_enabled(true);
+static atomic<bool> s_mmsg_enabled(true);
+
+bool UdpBatchSender::isGsoEnabled() {
+    return s_gso_enabled.load();
+}
+
+void UdpBatchSender::setGsoEnabled(bool enabled) {
+    s_gso_enabled = enabled;
+}
+
+#if defined(__linux__)
+
+static inline bool isAgain(int err) {
+    return err == EAGAIN || err == EWOULDBLOCK || err == ENOBUFS || err == EINTR;
+}
+
+/**
+ * 从begin开始找出可以通过GSO一次发送的包个数：
+ * 除最后一个包外长度必须相同，最后一个包可以更短
+ */
+static size_t gsoRunLength(const vector<RtpPacket::Ptr> &pkts, size_t begin, uint32_t offset, uint16_t &segment) {
+    segment = pkts[begin]->size() - offset;
+    size_t total = 0;
+    size_t i = begin;
+    for (; i < pkts.size() && i - begin < UDP_BATCH_MAX; ++i) {
+        uint32_t len = pkts[i]->size() - offset;
+        if (len > segment || total + len > UDP_GSO_MAX_BYTES) {
+            break;
+        }
+        total += len;
+        if (len < segment) {
+            //较短的包只能作为最后一个分片
+            ++i;
+            break;
+        }
+    }
+    return i - begin;
+}
+
+//返回-1代表内核或网卡不支持GSO，返回0代表发送缓存已满或其他错误
+static int sendGso(int fd, const struct sockaddr *addr, int addr_len, const vector<RtpPacket::Ptr> &pkts,
+                   size_t begin, size_t count, uint32_t offset, uint16_t segment) {
+    struct iovec iov[UDP_BATCH_MAX];
+    for (size_t i = 0; i < count; ++i) {
+        auto &pkt = pkts[begin + i];
+        iov[i].iov_base = pkt->data() + offset;
+        iov[i].iov_len = pkt->size() - offset;
+    }
+
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = (void *) addr;
+    msg.msg_namelen = addr_len;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) >= 0) {
+        return count;
+    }
+    int err = errno;
+    if (isAgain(err)) {
+        return 0;
+    }
+    if (err == EINVAL || err == EIO || err == ENOPROTOOPT || err == EOPNOTSUPP) {
+        //内核不支持UDP_SEGMENT或网卡不支持校验和卸载，以后不再尝试GSO
+        WarnL << "udp gso不可用,改用sendmmsg:" << get_uv_errmsg(true);
+        s_gso_enabled = false;
+        return -1;
+    }
+    //其他错误交给调用者处理
+    return 0;
+}
+
+//返回-1代表不支持sendmmsg，返回0代表发送缓存已满或其他错误
+static int sendMulti(int fd, const struct sockaddr *addr, int addr_len, const vector<RtpPacket::Ptr> &pkts,
+                     size_t begin, uint32_t offset) {
+    struct mmsghdr msgs[UDP_BATCH_MAX];
+    struct iovec iov[UDP_BATCH_MAX];
+    size_t count = MIN(pkts.size() - begin, (size_t) UDP_BATCH_MAX);
+    memset(msgs, 0, sizeof(struct mmsghdr) * count);
+    for (size_t i = 0; i < count; ++i) {
+        auto &pkt = pkts[begin + i];
+        iov[i].iov_base = pkt->data() + offset;
+        iov[i].iov_len = pkt->size() - offset;
+        msgs[i].msg_hdr.msg_name = (void *) addr;
+        msgs[i].msg_hdr.msg_namelen = addr_len;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int ret = sendmmsg(fd, msgs, count, MSG_NOSIGNAL);
+    if (ret >= 0) {
+        return ret;
+    }
+    if (errno == ENOSYS) {
+        WarnL << "sendmmsg不可用:" << get_uv_errmsg(true);
+        s_mmsg_enabled = false;
+        return -1;
+    }
+    return 0;
+}
+
+size_t UdpBatchSender::send(int fd, const struct sockaddr *addr, int addr_len, const vector<RtpPacket::Ptr> &pkts, uint32_t offset) {
+    size_t sent = 0;
+    while (sent < pkts.size() && s_mmsg_enabled) {
+        int ret = -1;
+        if (s_gso_enabled) {
+            uint16_t segment;
+            auto count = gsoRunLength(pkts, sent, offset, segment);
+            if (count > 1) {
+                ret = sendGso(fd, addr, addr_len, pkts, sent, count, offset, segment);
+            }
+        }
+        if (ret < 0) {
+            //不满足GSO条件或者GSO不可用
+            ret = sendMulti(fd, addr, addr_len, pkts, sent, offset);
+        }
+        if (ret <= 0) {
+            break;
+        }
+        sent += ret;
+    }
+    return sent;
+}
+
+#else
+
+size_t UdpBatchSender::send(int fd, const struct sockaddr *addr, int addr_len, const vector<RtpPacket::Ptr> &pkts, uint32_t offset) {
+    //其他平台没有sendmmsg，由调用者逐个发送
+    return 0;
+}
+
+#endif //defined(__linux__)
+
+}//namespace mediakit
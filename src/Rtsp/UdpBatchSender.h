@@ -0,0 +1,71 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ZLMEDIAKIT_UDPBATCHSENDER_H
+#define ZLMEDIAKIT_UDPBATCHSENDER_H
+
+#include <vector>
+#include "Rtsp.h"
+#include "Network/sockutil.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * udp批量发送
+ * 一帧的多个rtp包优先通过UDP_SEGMENT(GSO)一次系统调用发出，由内核或网卡负责切分成多个数据报；
+ * 不满足GSO条件或内核不支持时使用sendmmsg一次发送多个数据报；
+ * 非linux平台或者发送缓存已满时由调用者逐个发送
+ */
+class UdpBatchSender {
+public:
+    /**
+     * 批量发送rtp包，每个包为一个数据报
+     * @param fd udp套接字
+     * @param addr 目标地址
+     * @param addr_len 目标地址长度
+     * @param pkts rtp包列表
+     * @param offset 每个包跳过的字节数，rtp包带有4个字节的interleaved头
+     * @return 从列表开头算起已经发送的包个数，剩余的包(发送缓存已满、发生错误等)需要调用者逐个发送
+     */
+    static size_t send(int fd, const struct sockaddr *addr, int addr_len, const vector<RtpPacket::Ptr> &pkts, uint32_t offset = 4);
+
+    /**
+     * 是否可以使用UDP_SEGMENT(GSO)，内核或网卡不支持时首次发送失败后自动关闭
+     */
+    static bool isGsoEnabled();
+
+    /**
+     * 开启或关闭GSO，主要用于测试
+     */
+    static void setGsoEnabled(bool enabled);
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_UDPBATCHSENDER_H
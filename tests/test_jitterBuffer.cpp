@@ -0,0 +1,265 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <memory>
+#include <string>
+#include <iostream>
+#include <functional>
+#include "Rtsp/RtpJitterBuffer.h"
+
+using namespace std;
+using namespace mediakit;
+
+/**
+ * 仅用于测试的rtp包
+ */
+class TestRtp {
+public:
+    typedef std::shared_ptr<TestRtp> Ptr;
+    uint16_t sequence;
+    uint32_t timeStamp;
+};
+
+/**
+ * 原先基于std::map的排序缓存，用于对比
+ */
+class MapSortCache {
+public:
+    typedef function<void(const TestRtp::Ptr &pkt)> onOutput;
+    MapSortCache(uint32_t maxCount, uint32_t clearCount) : _maxCount(maxCount), _clearCount(clearCount) {}
+
+    void input(const TestRtp::Ptr &rtp, const onOutput &cb) {
+        if (rtp->sequence != (uint16_t) (_lastSeq + 1) && _lastSeq != 0) {
+            //包乱序或丢包
+            _seqOkCount = 0;
+            _sortStarted = true;
+            if (_lastSeq > rtp->sequence && _lastSeq - rtp->sequence > 0xFF) {
+                //sequence回环，清空所有排序缓存
+                while (_cache.size()) {
+                    popHead(cb);
+                }
+            }
+        } else {
+            _seqOkCount++;
+        }
+        _lastSeq = rtp->sequence;
+
+        if (_sortStarted) {
+            _cache.emplace(rtp->sequence, rtp);
+            if (_seqOkCount >= _clearCount) {
+                //网络环境改善，需要清空排序缓存
+                _seqOkCount = 0;
+                _sortStarted = false;
+                while (_cache.size()) {
+                    popHead(cb);
+                }
+            } else if (_cache.size() >= _maxCount) {
+                //排序缓存溢出
+                popHead(cb);
+            }
+        } else {
+            cb(rtp);
+        }
+    }
+private:
+    void popHead(const onOutput &cb) {
+        auto it = _cache.begin();
+        cb(it->second);
+        _cache.erase(it);
+    }
+private:
+    uint32_t _maxCount;
+    uint32_t _clearCount;
+    uint16_t _lastSeq = 0;
+    uint32_t _seqOkCount = 0;
+    bool _sortStarted = false;
+    map<uint16_t, TestRtp::Ptr> _cache;
+};
+
+/**
+ * 生成模拟wifi摄像头的rtp到达顺序
+ * @param count 发送的包个数
+ * @param reorderRate 乱序概率
+ * @param maxDisplace 乱序包最多推迟的包个数
+ * @param lossRate 进入突发丢包状态的概率
+ * @param burstLen 突发丢包的平均长度
+ */
+static vector<TestRtp::Ptr> makeArrival(uint32_t count, double reorderRate, int maxDisplace, double lossRate, int burstLen) {
+    mt19937 engine(1234);
+    uniform_real_distribution<double> rand01(0, 1);
+    vector<TestRtp::Ptr> ret;
+    ret.reserve(count);
+    //从接近回环处开始，覆盖seq回环的情况
+    uint16_t seq = 0xFFFF - 1000;
+    int burstLeft = 0;
+    for (uint32_t i = 0; i < count; ++i, ++seq) {
+        if (burstLeft > 0) {
+            --burstLeft;
+            continue;
+        }
+        if (rand01(engine) < lossRate) {
+            //吉尔伯特模型的简化版，wifi丢包通常是连续的
+            burstLeft = 1 + engine() % (2 * burstLen);
+            continue;
+        }
+        auto rtp = std::make_shared<TestRtp>();
+        rtp->sequence = seq;
+        //90kHz视频，每帧约10个包
+        rtp->timeStamp = i / 10 * 40;
+        ret.emplace_back(rtp);
+    }
+    for (size_t i = 0; i + 1 < ret.size(); ++i) {
+        if (rand01(engine) < reorderRate) {
+            //把该包推迟若干个位置到达
+            size_t target = min(ret.size() - 1, i + 1 + engine() % maxDisplace);
+            std::rotate(ret.begin() + i, ret.begin() + i + 1, ret.begin() + target + 1);
+        }
+    }
+    return ret;
+}
+
+/**
+ * 统计输出结果
+ */
+class OutputChecker {
+public:
+    void onOutput(const TestRtp::Ptr &rtp) {
+        if (_count && (int16_t) (uint16_t) (rtp->sequence - _lastSeq) <= 0) {
+            ++_disorder;
+        }
+        _lastSeq = rtp->sequence;
+        ++_count;
+    }
+    uint64_t _count = 0;
+    uint64_t _disorder = 0;
+    uint16_t _lastSeq = 0;
+};
+
+static uint64_t nowNanoSecond() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void testCase(const string &name, const vector<TestRtp::Ptr> &arrival, int rounds) {
+    OutputChecker mapChecker, ringChecker;
+    uint64_t mapCost = 0, ringCost = 0;
+    for (int i = 0; i < rounds; ++i) {
+        MapSortCache mapCache(50, 10);
+        OutputChecker checker;
+        auto start = nowNanoSecond();
+        for (auto &rtp : arrival) {
+            mapCache.input(rtp, [&](const TestRtp::Ptr &pkt) { checker.onOutput(pkt); });
+        }
+        mapCost += nowNanoSecond() - start;
+        mapChecker = checker;
+    }
+
+    uint64_t lateDropped = 0;
+    for (int i = 0; i < rounds; ++i) {
+        RtpJitterBuffer<TestRtp::Ptr> ring(50, 0);
+        OutputChecker checker;
+        auto start = nowNanoSecond();
+        for (auto &rtp : arrival) {
+            ring.input(rtp->sequence, rtp->timeStamp, rtp, [&](const TestRtp::Ptr &pkt) { checker.onOutput(pkt); });
+        }
+        ring.flush([&](const TestRtp::Ptr &pkt) { checker.onOutput(pkt); });
+        ringCost += nowNanoSecond() - start;
+        ringChecker = checker;
+        lateDropped = ring.getLateDropped();
+    }
+
+    auto total = (double) arrival.size() * rounds;
+    cout << name << endl;
+    cout << "  map  : " << mapCost / total << " ns/包, 输出:" << mapChecker._count
+         << ", 乱序输出:" << mapChecker._disorder << endl;
+    cout << "  ring : " << ringCost / total << " ns/包, 输出:" << ringChecker._count
+         << ", 乱序输出:" << ringChecker._disorder << ", 迟到丢弃:" << lateDropped << endl;
+}
+
+/**
+ * 生成低包率流(比如20毫秒一个包的音频)的rtp到达顺序，每隔interval个包丢一个包
+ */
+static vector<TestRtp::Ptr> makeLowRateArrival(uint32_t count, uint32_t stampStep, uint32_t interval) {
+    vector<TestRtp::Ptr> ret;
+    ret.reserve(count);
+    uint16_t seq = 0;
+    for (uint32_t i = 0; i < count; ++i, ++seq) {
+        if (i % interval == interval / 2) {
+            continue;
+        }
+        auto rtp = std::make_shared<TestRtp>();
+        rtp->sequence = seq;
+        rtp->timeStamp = i * stampStep;
+        ret.emplace_back(rtp);
+    }
+    return ret;
+}
+
+/**
+ * 测试丢包时的输出延时，延时为包输出时已经收到的最大时间戳减去该包的时间戳
+ */
+static void latencyCase(const string &name, const vector<TestRtp::Ptr> &arrival, uint32_t maxDelayMS) {
+    RtpJitterBuffer<TestRtp::Ptr> ring(50, maxDelayMS);
+    uint32_t newestStamp = 0;
+    uint64_t totalDelay = 0, maxDelay = 0, outCount = 0;
+    auto onOutput = [&](const TestRtp::Ptr &pkt) {
+        uint64_t delay = newestStamp - pkt->timeStamp;
+        totalDelay += delay;
+        maxDelay = max(maxDelay, delay);
+        ++outCount;
+    };
+    for (auto &rtp : arrival) {
+        newestStamp = max(newestStamp, rtp->timeStamp);
+        ring.input(rtp->sequence, rtp->timeStamp, rtp, onOutput);
+    }
+    cout << name << "(maxJitterMS:" << maxDelayMS << ")" << endl;
+    cout << "  平均延时:" << (outCount ? totalDelay / (double) outCount : 0) << " ms, 最大延时:" << maxDelay
+         << " ms, 跳过丢包:" << ring.getSkipped() << endl;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t count = argc > 1 ? atoi(argv[1]) : 1000000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+    cout << "测试方法:./test_jitterBuffer [packet_count] [rounds]，当前包个数:" << count << ",轮数:" << rounds << endl;
+
+    testCase("无乱序无丢包", makeArrival(count, 0, 1, 0, 1), rounds);
+    testCase("轻微乱序(1%,相邻2个包内)", makeArrival(count, 0.01, 2, 0, 1), rounds);
+    testCase("wifi摄像头(乱序3%,8个包内;突发丢包0.5%,平均3个包)", makeArrival(count, 0.03, 8, 0.005, 3), rounds);
+    testCase("弱网(乱序10%,30个包内;突发丢包2%,平均5个包)", makeArrival(count, 0.10, 30, 0.02, 5), rounds);
+
+    //单个丢包时，不限制缓存时长会等到缓存满50个包才跳过该包
+    auto audio = makeLowRateArrival(10000, 20, 500);
+    latencyCase("音频(20毫秒一个包,每500个包丢1个)", audio, 0);
+    latencyCase("音频(20毫秒一个包,每500个包丢1个)", audio, 200);
+    auto wifi = makeArrival(min(count, 100000U), 0.03, 8, 0.005, 3);
+    latencyCase("wifi摄像头(乱序3%,8个包内;突发丢包0.5%,平均3个包)", wifi, 0);
+    latencyCase("wifi摄像头(乱序3%,8个包内;突发丢包0.5%,平均3个包)", wifi, 200);
+    return 0;
+}
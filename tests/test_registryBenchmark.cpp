@@ -0,0 +1,163 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/util.h"
+#include "Common/MediaSource.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+/**
+ * 仅用于测试注册表性能的媒体源
+ */
+class BenchmarkMediaSource : public MediaSource {
+public:
+    typedef std::shared_ptr<BenchmarkMediaSource> Ptr;
+    BenchmarkMediaSource(const string &stream) : MediaSource(RTSP_SCHEMA, DEFAULT_VHOST, "live", stream) {}
+    ~BenchmarkMediaSource() override {}
+
+    uint32_t getTimeStamp(TrackType trackType) override {
+        return 0;
+    }
+    int readerCount() override {
+        return 0;
+    }
+    void doRegist() {
+        regist();
+    }
+};
+
+static uint64_t nowNanoSecond() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char *argv[]) {
+    //注册与反注册非常频繁，屏蔽info级别日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    if (argc != 5) {
+        ErrorL << "\r\n测试方法:./test_registryBenchmark stream_count lookup_threads churn_threads seconds\r\n"
+               << "例如你想注册20000个流，8个线程查找、4个线程不停的注册反注册，测试10秒，可以输入以下命令:\r\n"
+               << "./test_registryBenchmark 20000 8 4 10\r\n"
+               << endl;
+        return 0;
+    }
+
+    int stream_count = atoi(argv[1]);
+    int lookup_threads = atoi(argv[2]);
+    int churn_threads = atoi(argv[3]);
+    int seconds = atoi(argv[4]);
+
+    //常驻的流
+    vector<BenchmarkMediaSource::Ptr> sources;
+    sources.reserve(stream_count);
+    for (int i = 0; i < stream_count; ++i) {
+        auto src = std::make_shared<BenchmarkMediaSource>(to_string(i));
+        src->doRegist();
+        sources.emplace_back(src);
+    }
+
+    atomic_bool exit_flag(false);
+    atomic<uint64_t> lookup_count(0);
+    atomic<uint64_t> churn_count(0);
+    vector<vector<uint32_t> > lookup_cost(lookup_threads);
+    vector<thread> threads;
+
+    for (int i = 0; i < lookup_threads; ++i) {
+        threads.emplace_back([&, i]() {
+            mt19937 rand_engine(i);
+            auto &cost = lookup_cost[i];
+            uint64_t count = 0;
+            while (!exit_flag) {
+                auto stream = to_string(rand_engine() % stream_count);
+                auto start = nowNanoSecond();
+                auto src = MediaSource::find(RTSP_SCHEMA, DEFAULT_VHOST, "live", stream, false);
+                auto elapsed = nowNanoSecond() - start;
+                if (!src) {
+                    ErrorL << "未找到流:" << stream;
+                }
+                //每16次采样一次耗时，防止统计数据太大
+                if ((++count & 0x0F) == 0) {
+                    cost.emplace_back(elapsed);
+                }
+            }
+            lookup_count += count;
+        });
+    }
+
+    for (int i = 0; i < churn_threads; ++i) {
+        threads.emplace_back([&, i]() {
+            uint64_t count = 0;
+            while (!exit_flag) {
+                //模拟频繁的推流、断流
+                auto src = std::make_shared<BenchmarkMediaSource>(StrPrinter << "churn_" << i << "_" << count);
+                src->doRegist();
+                src.reset();
+                ++count;
+            }
+            churn_count += count;
+        });
+    }
+
+    this_thread::sleep_for(chrono::seconds(seconds));
+    exit_flag = true;
+    for (auto &th : threads) {
+        th.join();
+    }
+
+    vector<uint32_t> all_cost;
+    for (auto &cost : lookup_cost) {
+        all_cost.insert(all_cost.end(), cost.begin(), cost.end());
+    }
+    sort(all_cost.begin(), all_cost.end());
+    auto percentile = [&](double p) -> uint32_t {
+        if (all_cost.empty()) {
+            return 0;
+        }
+        return all_cost[MIN(all_cost.size() - 1, (size_t) (all_cost.size() * p))];
+    };
+
+    cout << "流个数:" << stream_count
+         << ",查找线程数:" << lookup_threads
+         << ",注册线程数:" << churn_threads << endl;
+    cout << "查找次数/秒:" << lookup_count / seconds
+         << ",注册反注册次数/秒:" << churn_count / seconds << endl;
+    cout << "查找耗时(ns) p50:" << percentile(0.5)
+         << ",p99:" << percentile(0.99)
+         << ",p999:" << percentile(0.999) << endl;
+    return 0;
+}
@@ -0,0 +1,197 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <new>
+#include "Util/logger.h"
+#include "Util/util.h"
+#include "Rtmp/RtmpProtocol.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+//统计本进程的堆内存分配次数
+static atomic<uint64_t> s_allocCount(0);
+
+void *operator new(size_t size) {
+    ++s_allocCount;
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+/**
+ * 模拟一个rtmp播放器会话，发送的数据放入固定长度的发送队列，队列满后释放最早的数据，模拟socket发送
+ */
+class BenchSession : public RtmpProtocol {
+public:
+    BenchSession(size_t queueSize) : _queue(queueSize) {
+        sendChunkSize(60000);
+    }
+
+    void sendMedia(const RtmpPacket::Ptr &pkt, bool shareChunk) {
+        if (shareChunk) {
+            sendRtmp(pkt, STREAM_MEDIA, pkt->timeStamp);
+        } else {
+            sendRtmp(pkt->typeId, STREAM_MEDIA, pkt, pkt->timeStamp, pkt->chunkId);
+        }
+    }
+
+    void sendControl(uint32_t stamp) {
+        sendPingRequest(stamp);
+    }
+
+    //只从内存池获取一个rtmp头大小的buffer并放入发送队列
+    void sendPooled() {
+        auto buffer = obtainBuffer();
+        buffer->setCapacity(sizeof(RtmpHeader));
+        buffer->setSize(sizeof(RtmpHeader));
+        onSendRawData(buffer);
+    }
+
+    uint64_t sentBytes() const {
+        return _sentBytes;
+    }
+
+protected:
+    void onSendRawData(const Buffer::Ptr &buffer) override {
+        _sentBytes += buffer->size();
+        _queue[_pos] = buffer;
+        _pos = (_pos + 1) % _queue.size();
+    }
+
+    void onRtmpChunk(RtmpPacket &chunkData) override {}
+
+private:
+    vector<Buffer::Ptr> _queue;
+    size_t _pos = 0;
+    uint64_t _sentBytes = 0;
+};
+
+static RtmpPacket::Ptr makePacket(uint32_t size, uint32_t stamp) {
+    auto pkt = std::make_shared<RtmpPacket>();
+    pkt->strBuf.assign(size, 'a');
+    pkt->strBuf[0] = 0x17;
+    pkt->strBuf[1] = 1;
+    pkt->bodySize = size;
+    pkt->typeId = MSG_VIDEO;
+    pkt->chunkId = CHUNK_VIDEO;
+    pkt->streamId = STREAM_MEDIA;
+    pkt->timeStamp = stamp;
+    return pkt;
+}
+
+/**
+ * @return 平均每次操作分配内存的次数
+ */
+template<typename FUN>
+static double testCase(const char *name, vector<std::shared_ptr<BenchSession> > &sessions, int count, FUN &&fun) {
+    //先预热，使内存池填满
+    for (int i = 0; i < 16; ++i) {
+        for (auto &session : sessions) {
+            fun(*session, i);
+        }
+    }
+    uint64_t bytes = 0;
+    for (auto &session : sessions) {
+        bytes -= session->sentBytes();
+    }
+    auto allocStart = s_allocCount.load();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        for (auto &session : sessions) {
+            fun(*session, i);
+        }
+    }
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    auto allocs = s_allocCount.load() - allocStart;
+    for (auto &session : sessions) {
+        bytes += session->sentBytes();
+    }
+    uint64_t total = (uint64_t) count * sessions.size();
+    cout << name << ":" << total << "次,耗时" << ns / 1000000 << "ms,平均" << ns / total << "ns,"
+         << "每次分配内存" << (double) allocs / total << "次,输出" << bytes << "字节" << endl;
+    return (double) allocs / total;
+}
+
+int main(int argc, char *argv[]) {
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    int viewers = argc > 1 ? atoi(argv[1]) : 1000;
+    int count = argc > 2 ? atoi(argv[2]) : 200;
+    int pktSize = argc > 3 ? atoi(argv[3]) : 200 * 1024;
+    cout << "测试方法:./test_rtmpAlloc [viewers] [count] [pkt_size]，当前播放器数:" << viewers
+         << ",每个播放器包数:" << count << ",包大小:" << pktSize << endl;
+
+    vector<std::shared_ptr<BenchSession> > sessions;
+    sessions.reserve(viewers);
+    for (int i = 0; i < viewers; ++i) {
+        sessions.emplace_back(std::make_shared<BenchSession>(4));
+    }
+
+    //每个包所有播放器发送完毕后再换下一个包，与环形缓存分发顺序一致
+    vector<RtmpPacket::Ptr> pkts;
+    for (int i = 0; i < count + 16; ++i) {
+        pkts.emplace_back(makePacket(pktSize, i * 40));
+    }
+
+    testCase("每个播放器单独切片", sessions, count, [&](BenchSession &session, int i) {
+        session.sendMedia(pkts[i], false);
+    });
+    auto shared = testCase("所有播放器共用切片", sessions, count, [&](BenchSession &session, int i) {
+        session.sendMedia(pkts[i], true);
+    });
+    testCase("控制消息", sessions, count, [&](BenchSession &session, int i) {
+        session.sendControl(i);
+    });
+    auto pooled = testCase("内存池", sessions, count, [&](BenchSession &session, int i) {
+        session.sendPooled();
+    });
+
+    bool ok = true;
+    //共用切片时rtmp头来自内存池，切片在每个包的第一个播放器生成，平均每个转发的包几乎不分配内存
+    if (shared >= 0.1) {
+        cout << "共用切片时每个转发的包分配内存次数过多:" << shared << endl;
+        ok = false;
+    }
+    //发送中的buffer个数稳定后，内存池不再分配内存
+    if (pooled >= 0.01) {
+        cout << "内存池预热后仍在分配内存:" << pooled << endl;
+        ok = false;
+    }
+    cout << (ok ? "测试通过" : "测试失败") << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,402 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <signal.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/util.h"
+#include "Util/TimeTicker.h"
+#include "Poller/Timer.h"
+#include "Poller/EventPoller.h"
+#include "Thread/semaphore.h"
+#include "Network/TcpClient.h"
+#include "Rtsp/Rtsp.h"
+#include "Rtsp/RtspSplitter.h"
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+/**
+ * 全局统计，握手客户端分布在所有线程上
+ */
+class HandshakeStats {
+public:
+    void onResult(bool success, uint64_t usec, const string &err) {
+        lock_guard<mutex> lck(_mtx);
+        if (success) {
+            _latency.emplace_back(usec);
+        } else {
+            ++_failed[err];
+        }
+    }
+
+    /**
+     * 获取并清空本统计周期的结果
+     */
+    void take(vector<uint64_t> &latency, map<string, uint64_t> &failed) {
+        lock_guard<mutex> lck(_mtx);
+        latency.insert(latency.end(), _latency.begin(), _latency.end());
+        for (auto &pr : _failed) {
+            failed[pr.first] += pr.second;
+        }
+        _latency.clear();
+        _failed.clear();
+    }
+public:
+    atomic<uint64_t> started{0};
+    atomic<uint64_t> finished{0};
+private:
+    mutex _mtx;
+    vector<uint64_t> _latency;
+    map<string, uint64_t> _failed;
+};
+
+static HandshakeStats s_stats;
+
+/**
+ * 依次发送OPTIONS/DESCRIBE/SETUP/PLAY/TEARDOWN的rtsp客户端，不解码也不统计rtp
+ */
+class HandshakeClient : public TcpClient, public RtspSplitter {
+public:
+    typedef std::shared_ptr<HandshakeClient> Ptr;
+
+    HandshakeClient(const EventPoller::Ptr &poller) : TcpClient(poller) {
+        //PLAY之后服务器会立即发送gop缓存
+        enableRecvRtp(true);
+    }
+    ~HandshakeClient() override {}
+
+    void start(const string &url, const string &host, uint16_t port, float timeoutSec) {
+        _self = static_pointer_cast<HandshakeClient>(shared_from_this());
+        _url = url;
+        _startUS = getCurrentMicrosecond();
+        ++s_stats.started;
+        weak_ptr<HandshakeClient> weakSelf = _self;
+        _timer = std::make_shared<Timer>(timeoutSec, [weakSelf]() {
+            auto strongSelf = weakSelf.lock();
+            if (strongSelf) {
+                strongSelf->finish("timeout");
+            }
+            return false;
+        }, getPoller());
+        startConnect(host, port, timeoutSec);
+    }
+protected:
+    void onConnect(const SockException &ex) override {
+        if (ex.getErrCode() != Err_success) {
+            finish(string("connect:") + ex.what());
+            return;
+        }
+        _step = kOptions;
+        sendRequest("OPTIONS", _url);
+    }
+
+    void onRecv(const Buffer::Ptr &buf) override {
+        input(buf->data(), buf->size());
+    }
+
+    void onErr(const SockException &ex) override {
+        finish(string("shutdown:") + ex.what());
+    }
+
+    void onRtpPacket(const char *data, uint64_t len) override {}
+
+    void onWholeRtspPacket(Parser &parser) override {
+        if (_step == kDone) {
+            return;
+        }
+        if (parser.Url() != "200") {
+            finish(StrPrinter << kStepName[_step] << ":" << parser.Url());
+            return;
+        }
+        switch (_step) {
+            case kOptions: {
+                _step = kDescribe;
+                sendRequest("DESCRIBE", _url, "Accept: application/sdp\r\n");
+                break;
+            }
+            case kDescribe: {
+                _contentBase = parser["Content-Base"];
+                if (_contentBase.empty()) {
+                    _contentBase = _url;
+                }
+                if (_contentBase.back() == '/') {
+                    _contentBase.pop_back();
+                }
+                _tracks = SdpParser(parser.Content()).getAvailableTrack();
+                if (_tracks.empty()) {
+                    finish("DESCRIBE:no track");
+                    return;
+                }
+                _step = kSetup;
+                sendSetup();
+                break;
+            }
+            case kSetup: {
+                _session = FindField(parser["Session"].data(), NULL, ";");
+                if (_session.empty()) {
+                    _session = parser["Session"];
+                }
+                if (++_trackIndex < _tracks.size()) {
+                    sendSetup();
+                    break;
+                }
+                _step = kPlay;
+                sendRequest("PLAY", _contentBase, "Range: npt=0.000-\r\n");
+                break;
+            }
+            case kPlay: {
+                _step = kTeardown;
+                sendRequest("TEARDOWN", _contentBase);
+                break;
+            }
+            case kTeardown: {
+                finish("");
+                break;
+            }
+            default:
+                break;
+        }
+    }
+private:
+    void sendSetup() {
+        auto &track = _tracks[_trackIndex];
+        auto url = track->_control.find("://") != string::npos ? track->_control : _contentBase + "/" + track->_control_surffix;
+        int interleaved = 2 * track->_type;
+        sendRequest("SETUP", url, StrPrinter << "Transport: RTP/AVP/TCP;unicast;interleaved="
+                                             << interleaved << "-" << interleaved + 1 << "\r\n");
+    }
+
+    void sendRequest(const string &method, const string &url, const string &extra = "") {
+        _StrPrinter printer;
+        printer << method << " " << url << " RTSP/1.0\r\n"
+                << "CSeq: " << ++_cseq << "\r\n"
+                << "User-Agent: test_rtspHandshake\r\n";
+        if (!_session.empty()) {
+            printer << "Session: " << _session << "\r\n";
+        }
+        printer << extra << "\r\n";
+        send(printer);
+    }
+
+    void finish(const string &err) {
+        if (_step == kDone) {
+            return;
+        }
+        _step = kDone;
+        s_stats.onResult(err.empty(), getCurrentMicrosecond() - _startUS, err);
+        ++s_stats.finished;
+        _timer.reset();
+        //在后续任务中释放自己，防止在回调中析构
+        auto self = std::move(_self);
+        getPoller()->async([self]() {
+            self->shutdown(SockException(Err_shutdown, "handshake finished"));
+        }, false);
+    }
+private:
+    typedef enum { kConnect = 0, kOptions, kDescribe, kSetup, kPlay, kTeardown, kDone } Step;
+    static const char *kStepName[];
+    Step _step = kConnect;
+    string _url;
+    string _contentBase;
+    string _session;
+    int _cseq = 0;
+    unsigned int _trackIndex = 0;
+    vector<SdpTrack::Ptr> _tracks;
+    uint64_t _startUS = 0;
+    Timer::Ptr _timer;
+    Ptr _self;
+};
+
+const char *HandshakeClient::kStepName[] = {"CONNECT", "OPTIONS", "DESCRIBE", "SETUP", "PLAY", "TEARDOWN", "DONE"};
+
+/**
+ * 获取进程累计占用的cpu时间，单位微秒
+ * @param pid 进程id，0为本进程
+ * @return 无法获取时返回-1
+ */
+static int64_t getProcessCpuUS(int pid) {
+#if defined(__linux__)
+    if (pid == 0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    }
+    string path = StrPrinter << "/proc/" << pid << "/stat";
+    auto fp = fopen(path.data(), "r");
+    if (!fp) {
+        return -1;
+    }
+    char buf[1024] = {0};
+    auto size = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    string stat(buf, size);
+    //第2个字段为括号中的进程名，可能包含空格
+    auto pos = stat.rfind(')');
+    if (pos == string::npos) {
+        return -1;
+    }
+    auto fields = split(stat.substr(pos + 2), " ");
+    //utime、stime分别为第14、15个字段
+    if (fields.size() < 13) {
+        return -1;
+    }
+    static auto ticks = sysconf(_SC_CLK_TCK);
+    return (atoll(fields[11].data()) + atoll(fields[12].data())) * 1000000LL / ticks;
+#else
+    return -1;
+#endif
+}
+
+static uint64_t percentile(const vector<uint64_t> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[MIN((size_t) (sorted.size() * p), sorted.size() - 1)];
+}
+
+int main(int argc, char *argv[]) {
+    //设置退出信号处理函数
+    static semaphore sem;
+    signal(SIGINT, [](int) { sem.post(); });// 设置退出信号
+
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    if (argc < 4) {
+        ErrorL << "\r\n测试方法:./test_rtspHandshake rtsp_url total rate [server_pid] [timeout_sec]\r\n"
+               << "以每秒rate个的速度共发起total次rtsp握手(OPTIONS/DESCRIBE/SETUP/PLAY/TEARDOWN)，\r\n"
+               << "统计握手耗时分位数、失败原因，指定server_pid时统计服务器每次握手消耗的cpu时间(仅linux)。\r\n"
+               << "例如先运行test_server，再以每秒2000次的速度共发起20000次握手:\r\n"
+               << "./test_rtspHandshake rtsp://127.0.0.1/live/0 20000 2000 `pidof test_server`\r\n"
+               << endl;
+        return 0;
+    }
+
+    string url = argv[1];
+    int64_t total = atoll(argv[2]);
+    int rate = MAX(atoi(argv[3]), 1);
+    int serverPid = argc > 4 ? atoi(argv[4]) : -1;
+    float timeoutSec = argc > 5 ? atof(argv[5]) : 10;
+
+    auto host = FindField(url.data(), "://", "/");
+    if (host.empty()) {
+        host = FindField(url.data(), "://", NULL);
+    }
+    uint16_t port = 554;
+    if (host.find(':') != string::npos) {
+        port = atoi(FindField(host.data(), ":", NULL).data());
+        host = FindField(host.data(), NULL, ":");
+    }
+
+    auto clientCpuStart = getProcessCpuUS(0);
+    auto serverCpuStart = serverPid > 0 ? getProcessCpuUS(serverPid) : -1;
+    auto startUS = getCurrentMicrosecond();
+
+    //每10毫秒发起一批握手，所有客户端均匀分布在各个线程上
+    int64_t launched = 0;
+    double credit = 0;
+    Timer launchTimer(0.01f, [&]() {
+        credit += rate / 100.0;
+        while (credit >= 1 && launched < total) {
+            credit -= 1;
+            ++launched;
+            auto poller = EventPollerPool::Instance().getPoller();
+            poller->async([poller, url, host, port, timeoutSec]() {
+                HandshakeClient::Ptr client(new HandshakeClient(poller));
+                client->start(url, host, port, timeoutSec);
+            });
+        }
+        return launched < total;
+    }, nullptr);
+
+    //汇总结果在定时器线程与主线程(收到SIGINT提前退出时定时器仍在运行)中访问
+    mutex mtxReport;
+    vector<uint64_t> latency;
+    map<string, uint64_t> failed;
+    uint64_t lastFinished = 0;
+    uint64_t lastSucceeded = 0;
+    Timer reportTimer(1, [&]() {
+        lock_guard<mutex> lck(mtxReport);
+        auto finished = s_stats.finished.load();
+        s_stats.take(latency, failed);
+        uint64_t failedCount = 0;
+        for (auto &pr : failed) {
+            failedCount += pr.second;
+        }
+        InfoL << "已发起:" << s_stats.started.load()
+              << ",已完成:" << finished
+              << ",本秒完成:" << finished - lastFinished
+              << ",本秒成功:" << latency.size() - lastSucceeded
+              << ",累计成功:" << latency.size()
+              << ",累计失败:" << failedCount;
+        lastFinished = finished;
+        lastSucceeded = latency.size();
+        if (finished >= (uint64_t) total) {
+            sem.post();
+            return false;
+        }
+        return true;
+    }, nullptr);
+
+    sem.wait();
+    auto elapsedUS = getCurrentMicrosecond() - startUS;
+    auto clientCpu = getProcessCpuUS(0) - clientCpuStart;
+    auto serverCpu = serverCpuStart >= 0 ? getProcessCpuUS(serverPid) - serverCpuStart : -1;
+    lock_guard<mutex> lck(mtxReport);
+    s_stats.take(latency, failed);
+    sort(latency.begin(), latency.end());
+
+    auto finished = s_stats.finished.load();
+    cout << "\r\n握手完成:" << finished << "次,成功:" << latency.size() << "次,耗时:" << elapsedUS / 1000 << "ms,"
+         << "平均每秒完成:" << (uint64_t) (finished * 1e6 / elapsedUS) << "次" << endl;
+    cout << "握手耗时(ms) p50:" << percentile(latency, 0.5) / 1000.0
+         << " p90:" << percentile(latency, 0.9) / 1000.0
+         << " p99:" << percentile(latency, 0.99) / 1000.0
+         << " max:" << (latency.empty() ? 0 : latency.back()) / 1000.0 << endl;
+    for (auto &pr : failed) {
+        cout << "失败[" << pr.first << "]:" << pr.second << "次" << endl;
+    }
+    if (finished) {
+        cout << "客户端每次握手cpu时间:" << clientCpu / finished << "us" << endl;
+        if (serverCpu >= 0) {
+            cout << "服务器每次握手cpu时间:" << serverCpu / finished << "us" << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <chrono>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/util.h"
+#include "Util/mini.h"
+#include "Util/NoticeCenter.h"
+#include "Common/config.h"
+#include "Common/Parser.h"
+#include "Rtsp/RtspSdpCache.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+static const char s_sdp[] =
+        "v=0\r\n"
+        "o=- 1383190487994921 1 IN IP4 0.0.0.0\r\n"
+        "s=RTSP Session, streamed by the ZLMediaKit\r\n"
+        "i=ZLMediaKit Live Stream\r\n"
+        "c=IN IP4 0.0.0.0\r\n"
+        "t=0 0\r\n"
+        "a=range:npt=0-\r\n"
+        "m=video 0 RTP/AVP 96\r\n"
+        "b=AS:2048\r\n"
+        "a=rtpmap:96 H264/90000\r\n"
+        "a=fmtp:96 packetization-mode=1;profile-level-id=42C01F;sprop-parameter-sets=Z0LAH9oBQBbsBEAAAAMAQAAADyPGDKg=,aM4yyA==\r\n"
+        "a=control:trackID=0\r\n"
+        "m=audio 0 RTP/AVP 98\r\n"
+        "b=AS:128\r\n"
+        "a=rtpmap:98 MPEG4-GENERIC/44100/2\r\n"
+        "a=fmtp:98 streamtype=5;profile-level-id=1;mode=AAC-hbr;sizelength=13;indexlength=3;indexdeltalength=3;config=1210\r\n"
+        "a=control:trackID=1\r\n";
+
+static const string s_contentBase = "rtsp://127.0.0.1:554/live/benchmark";
+
+static const string s_session = "ABCDEFGHIJKL";
+
+/**
+ * 优化前的DESCRIBE处理：每次解析sdp、追加NACK属性并通过StrCaseMap渲染响应
+ * Server、Date头随编译时间与当前时间变化，由调用者传入
+ */
+static string renderLegacy(const string &sdp, int cseq, const string &server, const string &date) {
+    auto body = RtspSdpCache::addNackFeedback(sdp);
+    StrCaseMap header;
+    header.emplace("Content-Base", s_contentBase + "/");
+    header.emplace("x-Accept-Retransmit", "our-retransmit");
+    header.emplace("x-Accept-Dynamic-Rate", "1");
+    header.emplace("CSeq", StrPrinter << cseq);
+    header.emplace("Session", s_session);
+    header.emplace("Server", server);
+    header.emplace("Date", date);
+    header.emplace("Content-Length", StrPrinter << body.size());
+    header.emplace("Content-Type", "application/sdp");
+    _StrPrinter printer;
+    printer << "RTSP/1.0 200 OK\r\n";
+    for (auto &pr : header) {
+        printer << pr.first << ": " << pr.second << "\r\n";
+    }
+    printer << "\r\n" << body;
+    return printer;
+}
+
+/**
+ * 使用媒体源预先渲染的模板处理DESCRIBE，与RtspSession::sendDescribeResponse调用同一个渲染函数
+ */
+static string renderCached(const RtspSdpCache::Ptr &cache, int cseq) {
+    string res;
+    cache->renderDescribeResponse(res, cseq, s_session, s_contentBase);
+    return res;
+}
+
+/**
+ * 校验两种方式生成的响应内容一致，头的顺序不同(旧方式按StrCaseMap排序)，所以逐个比较状态行、头以及sdp
+ */
+static bool checkSame(const char *name, const string &sdp, const RtspSdpCache::Ptr &cache) {
+    auto cached = renderCached(cache, 1);
+    Parser legacyParser, cachedParser;
+    cachedParser.Parse(cached.data());
+    auto legacy = renderLegacy(sdp, 1, cachedParser["Server"], cachedParser["Date"]);
+    legacyParser.Parse(legacy.data());
+    bool same = legacyParser.Method() == cachedParser.Method() &&
+                legacyParser.FullUrl() == cachedParser.FullUrl() &&
+                legacyParser.Tail() == cachedParser.Tail() &&
+                legacyParser.Content() == cachedParser.Content() &&
+                legacyParser.getValues().size() == cachedParser.getValues().size();
+    for (auto &pr : legacyParser.getValues()) {
+        same = same && cachedParser[pr.first.data()] == pr.second;
+    }
+    cout << name << ":" << (same ? "与旧方式输出一致" : "与旧方式输出不一致") << endl;
+    if (!same) {
+        cout << "旧方式:\n" << legacy << "\n模板方式:\n" << cached << endl;
+    }
+    return same;
+}
+
+static void setNackCacheMS(uint32_t ms) {
+    mINI::Instance()[Rtp::kNackCacheMS] = ms;
+    NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastReloadConfig);
+}
+
+template<typename FUN>
+static void testCase(const char *name, int count, FUN &&fun) {
+    size_t bytes = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        bytes += fun(i);
+    }
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    cout << name << ":" << count << "次,耗时" << ns / 1000000 << "ms,"
+         << (uint64_t) (count * 1e9 / ns) << "次/秒,平均" << ns / count << "ns,输出" << bytes << "字节" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    int count = argc > 1 ? atoi(argv[1]) : 200000;
+    cout << "测试方法:./test_sdpCache [count]，当前次数:" << count << endl;
+
+    string sdp = s_sdp;
+    setNackCacheMS(1000);
+    RtspSdpCache::Ptr cache = std::make_shared<RtspSdpCache>(sdp);
+    bool same = checkSame("开启NACK", sdp, cache);
+    testCase("每次解析sdp并渲染DESCRIBE响应", count, [&](int i) {
+        return SdpParser(sdp).getAvailableTrack().size() + renderLegacy(sdp, i, SERVER_NAME, "Thu, Jan 01 2020 00:00:00 GMT").size();
+    });
+    testCase("使用预先渲染的DESCRIBE模板", count, [&](int i) {
+        return cache->cloneTracks().size() + renderCached(cache, i).size();
+    });
+
+    //模板生成后关闭NACK，模板失效后重新渲染
+    setNackCacheMS(0);
+    same = checkSame("模板生成后关闭NACK", sdp, cache) && same;
+    same = checkSame("关闭NACK后重新生成模板", sdp, std::make_shared<RtspSdpCache>(sdp)) && same;
+    return same ? 0 : 1;
+}
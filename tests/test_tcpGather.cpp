@@ -0,0 +1,114 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include "Common/TcpGatherSender.h"
+#include "Network/sockutil.h"
+#include "Util/logger.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+
+/**
+ * 测试tcp聚集写：发送缓存写满后，剩余数据(包括只发送了一部分的缓存)以引用方式返回，
+ * 按顺序拼接已发送与剩余数据后应与原始数据一致
+ */
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        cout << "socketpair失败" << endl;
+        return 1;
+    }
+    SockUtil::setNoBlocked(fds[0]);
+    SockUtil::setSendBuf(fds[0], 64 * 1024);
+
+    //模拟一个gop缓存：大小不一的帧，总量远大于发送缓存
+    vector<Buffer::Ptr> buffers;
+    string expected;
+    for (int i = 0; i < 2000; ++i) {
+        auto buffer = std::make_shared<BufferRaw>();
+        int size = 100 + (i * 37) % 1400;
+        buffer->setCapacity(size);
+        buffer->setSize(size);
+        memset(buffer->data(), 'a' + i % 26, size);
+        expected.append(buffer->data(), size);
+        buffers.emplace_back(buffer);
+    }
+    auto origin = buffers;
+
+    auto sent = TcpGatherSender::send(fds[0], 0, buffers);
+    size_t left = 0;
+    for (auto &buffer : buffers) {
+        left += buffer->size();
+    }
+    cout << "总字节数:" << expected.size() << ",已发送:" << sent << ",剩余缓存个数:" << buffers.size() << ",剩余字节数:" << left << endl;
+
+    bool ok = sent > 0 && sent + left == expected.size() && !buffers.empty();
+    //剩余数据应该引用原始缓存，而不是拷贝
+    if (ok && buffers.back() != origin.back()) {
+        cout << "剩余数据未引用原始缓存" << endl;
+        ok = false;
+    }
+
+    string received;
+    received.resize(sent);
+    size_t offset = 0;
+    while (offset < sent) {
+        auto ret = recv(fds[1], &received[offset], sent - offset, 0);
+        if (ret <= 0) {
+            break;
+        }
+        offset += ret;
+    }
+    for (auto &buffer : buffers) {
+        received.append(buffer->data(), buffer->size());
+    }
+    if (received != expected) {
+        cout << "数据不一致" << endl;
+        ok = false;
+    }
+    close(fds[0]);
+    close(fds[1]);
+    cout << (ok ? "测试通过" : "测试失败") << endl;
+    return ok ? 0 : 1;
+}
+
+#else
+
+int main(int argc, char *argv[]) {
+    cout << "sendmsg聚集写仅支持linux/unix" << endl;
+    return 0;
+}
+
+#endif //!defined(_WIN32)
@@ -0,0 +1,156 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <string>
+#include <iostream>
+#include "Rtsp/UdpBatchSender.h"
+#include "Network/sockutil.h"
+#include "Util/logger.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+#if defined(__linux__)
+
+/**
+ * 生成一帧rtp包(带4个字节interleaved头)，除最后一个包外都是mtu大小
+ */
+static vector<RtpPacket::Ptr> makeFrame(int count, int mtu, int lastSize) {
+    vector<RtpPacket::Ptr> ret;
+    for (int i = 0; i < count; ++i) {
+        auto pkt = std::make_shared<RtpPacket>();
+        int size = (i == count - 1 ? lastSize : mtu) + 4;
+        pkt->setCapacity(size);
+        pkt->setSize(size);
+        memset(pkt->data(), i, size);
+        ret.emplace_back(pkt);
+    }
+    return ret;
+}
+
+static int makeUdpSock(uint16_t port, bool recv) {
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    int size = 8 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, recv ? SO_RCVBUF : SO_SNDBUF, &size, sizeof(size));
+    if (recv) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        ::bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+        struct timeval tv = {0, 200 * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+    return fd;
+}
+
+/**
+ * 测试某种发送方式，返回每秒发送的包个数
+ * @param mode 0:逐个sendto，1:sendmmsg，2:GSO
+ */
+static void testCase(const string &name, int mode, const vector<RtpPacket::Ptr> &frame, int frames, uint16_t port) {
+    int recvFd = makeUdpSock(port, true);
+    int sendFd = makeUdpSock(0, false);
+    struct sockaddr_in peer;
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(port);
+    peer.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    //接收线程，统计收到的数据报个数(GSO发送的数据报在接收端已经被切分)
+    atomic<bool> exit(false);
+    atomic<uint64_t> recvCount(0);
+    thread recvThread([&]() {
+        char buf[2048];
+        while (!exit) {
+            if (recv(recvFd, buf, sizeof(buf), 0) > 0) {
+                ++recvCount;
+            }
+        }
+    });
+
+    UdpBatchSender::setGsoEnabled(mode == 2);
+    uint64_t syscalls = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        size_t sent = 0;
+        if (mode != 0) {
+            sent = UdpBatchSender::send(sendFd, (struct sockaddr *) &peer, sizeof(peer), frame);
+            ++syscalls;
+        }
+        for (; sent < frame.size(); ++sent) {
+            auto &pkt = frame[sent];
+            sendto(sendFd, pkt->data() + 4, pkt->size() - 4, 0, (struct sockaddr *) &peer, sizeof(peer));
+            ++syscalls;
+        }
+    }
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    this_thread::sleep_for(chrono::milliseconds(300));
+    exit = true;
+    recvThread.join();
+    close(sendFd);
+    close(recvFd);
+
+    uint64_t total = (uint64_t) frames * frame.size();
+    cout << name << ":发送" << total << "个包,耗时" << ns / 1000000 << "ms,"
+         << (uint64_t) (total * 1e9 / ns) << " pps,系统调用约" << syscalls << "次,"
+         << "接收端收到" << recvCount << "个包" << endl;
+    if (mode == 2 && !UdpBatchSender::isGsoEnabled()) {
+        cout << "  (本机不支持UDP_SEGMENT,已回退到sendmmsg)" << endl;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    int frames = argc > 1 ? atoi(argv[1]) : 20000;
+    int perFrame = argc > 2 ? atoi(argv[2]) : 16;
+    cout << "测试方法:./test_udpBatchSend [frames] [packets_per_frame]，当前帧数:" << frames << ",每帧包数:" << perFrame << endl;
+
+    auto frame = makeFrame(perFrame, 1400, 600);
+    testCase("逐个sendto", 0, frame, frames, 30000);
+    testCase("sendmmsg", 1, frame, frames, 30002);
+    testCase("UDP_SEGMENT(GSO)", 2, frame, frames, 30004);
+    return 0;
+}
+
+#else
+
+int main(int argc, char *argv[]) {
+    cout << "sendmmsg/GSO仅支持linux" << endl;
+    return 0;
+}
+
+#endif //defined(__linux__)
@@ -0,0 +1,133 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include "Rtsp/RtspUdpMux.h"
+#include "Common/config.h"
+#include "Util/mini.h"
+#include "Util/logger.h"
+#include "Util/NoticeCenter.h"
+#include "Network/sockutil.h"
+#include "Rtmp/utils.h"
+#include "Poller/EventPoller.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+/**
+ * 模拟nat后的推流：SETUP时声明的client_port与实际发送数据的端口不同，
+ * 复用端口应按对端ip+负载类型分发第一个rtp包，登记ssrc后再按ssrc分发rtcp
+ */
+
+static const uint16_t kMuxPort = 30554;
+static const uint8_t kPayloadType = 96;
+static const uint32_t kSsrc = 0x12345678;
+
+static void sendPacket(int fd, uint16_t port, const char *data, int len) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    ::sendto(fd, data, len, 0, (struct sockaddr *) &addr, sizeof(addr));
+}
+
+//等待收到指定个数的数据
+static bool waitCount(const atomic<int> &count, int expected) {
+    for (int i = 0; i < 100 && count.load() < expected; ++i) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    return count.load() >= expected;
+}
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    mINI::Instance()[Rtsp::kUdpMuxPort] = kMuxPort;
+    NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastReloadConfig);
+
+    auto poller = EventPollerPool::Instance().getPoller();
+    auto rtpSock = RtspUdpMux::Instance().getSock(poller, false);
+    auto rtcpSock = RtspUdpMux::Instance().getSock(poller, true);
+    if (!rtpSock || !rtcpSock) {
+        cout << "绑定复用端口失败:" << kMuxPort << endl;
+        return 1;
+    }
+
+    atomic<int> rtpCount{0}, rtcpCount{0};
+    int tag = 0;
+    //声明的client_port为40000-40001，实际从随机端口发送
+    RtspUdpMux::Instance().listen(&tag, 0, inet_addr("127.0.0.1"), 40000, 40001, 0, true, kPayloadType,
+                                  [&](int intervaled, const std::shared_ptr<vector<UdpPacket> > &burst) {
+        (intervaled % 2 ? rtcpCount : rtpCount) += burst->size();
+        return true;
+    });
+
+    int rtpFd = SockUtil::bindUdpSock(0, "127.0.0.1");
+    int rtcpFd = SockUtil::bindUdpSock(0, "127.0.0.1");
+    bool ok = true;
+
+    char rtp[20] = {0};
+    rtp[0] = (char) 0x80;
+    rtp[1] = kPayloadType;
+    set_be32(rtp + 8, kSsrc);
+    sendPacket(rtpFd, kMuxPort, rtp, sizeof(rtp));
+    if (!waitCount(rtpCount, 1)) {
+        cout << "nat后的推流rtp未按负载类型分发" << endl;
+        ok = false;
+    }
+
+    //已经记住了实际的对端端口，负载类型不同的包也能分发
+    rtp[1] = kPayloadType + 1;
+    sendPacket(rtpFd, kMuxPort, rtp, sizeof(rtp));
+    if (!waitCount(rtpCount, 2)) {
+        cout << "nat后的推流rtp未按学习到的对端地址分发" << endl;
+        ok = false;
+    }
+
+    //会话收到rtp包后登记ssrc，之后rtcp(SR)按发送者ssrc分发
+    RtspUdpMux::Instance().updateSsrc(&tag, 0, kSsrc);
+    char sr[28] = {0};
+    sr[0] = (char) 0x80;
+    sr[1] = (char) 200;
+    sr[3] = sizeof(sr) / 4 - 1;
+    set_be32(sr + 4, kSsrc);
+    sendPacket(rtcpFd, kMuxPort + 1, sr, sizeof(sr));
+    if (!waitCount(rtcpCount, 1)) {
+        cout << "nat后的推流rtcp未按ssrc分发" << endl;
+        ok = false;
+    }
+
+    RtspUdpMux::Instance().stopListen(&tag);
+    close(rtpFd);
+    close(rtcpFd);
+    cout << (ok ? "测试通过" : "测试失败") << endl;
+    return ok ? 0 : 1;
+}